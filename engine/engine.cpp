@@ -115,7 +115,10 @@ Engine::Engine( Screenport* port, const gamedb::Reader* database )
 		iMap( 0 )
 {
 	spaceTree = new SpaceTree( -0.1f, 3.0f );
+	spaceTree->SetDeferUpdates( true );
 	renderQueue = new RenderQueue();
+	memset( &cullStats, 0, sizeof( cullStats ) );
+	memset( &queueStats, 0, sizeof( queueStats ) );
 
 	lightDirection.Set( EL_LIGHT_X, EL_LIGHT_Y, EL_LIGHT_Z );
 	lightDirection.Normalize();
@@ -305,7 +308,14 @@ void Engine::Draw()
 	Plane planes[6];
 	CalcFrustumPlanes( planes );
 
+	// Everything that moved since the last frame is relinked here, at once.
+	spaceTree->FlushUpdates();
+	// Map items that changed are re-merged into their chunks.
+	if ( map )
+		map->BakeChunks();
 	Model* modelRoot = spaceTree->Query( planes, 6, 0, Model::MODEL_INVISIBLE, false );
+	spaceTree->QueryStats( &cullStats );
+	spaceTree->ResetUpdateStats();
 	
 	Color4F ambient, diffuse;
 	Vector4F dir;
@@ -325,11 +335,14 @@ void Engine::Draw()
 	// ------------ Process the models into the render queue -----------
 	{
 		GLASSERT( renderQueue->Empty() );
+		renderQueue->SetEye( camera.PosWC() );
 		const grinliz::BitArray<Map::SIZE, Map::SIZE, 1>* fogOfWar = (map) ? &map->GetFogOfWar() : 0;
 
 		for( Model* model=modelRoot; model; model=model->next ) {
 			if ( model->IsFlagSet( Model::MODEL_METADATA ) && !enableMeta )
 				continue;
+			if ( model->IsFlagSet( Model::MODEL_BAKED ) )
+				continue;
 
 			if ( model->IsFlagSet(  Model::MODEL_OWNED_BY_MAP ) ) {
 				model->Queue(	renderQueue, 
@@ -396,6 +409,7 @@ void Engine::Draw()
 									RenderQueue::MODE_PLANAR_SHADOW,
 									0,
 									Model::MODEL_NO_SHADOW );
+			map->Chunks()->Draw( planes, 6, &shadowShader, 0, RenderQueue::MODE_PLANAR_SHADOW );
 
 			shadowShader.PopMatrix( GPUShader::MODELVIEW_MATRIX );
 			shadowShader.PopTextureMatrix( 3 );
@@ -428,6 +442,8 @@ void Engine::Draw()
 			PushLightSwizzleMatrix( &mapItemShader );
 
 			renderQueue->Submit( 0, 0, Model::MODEL_OWNED_BY_MAP, 0 );
+			if ( map )
+				map->Chunks()->Draw( planes, 6, &mapItemShader, &mapBlendItemShader, 0 );
 			lightShader.PopTextureMatrix( 2 );
 		}
 		// Render everything NOT in the map.
@@ -437,6 +453,7 @@ void Engine::Draw()
 
 	if ( map )
 		map->DrawOverlay( Map::LAYER_OVER );
+	renderQueue->QueryStats( &queueStats );
 	renderQueue->Clear();
 }
 
@@ -555,6 +572,22 @@ Model* Engine::IntersectModel( const grinliz::Ray& ray, HitTestMethod method, in
 }
 
 
+int Engine::IntersectModels( const grinliz::Ray* rays, int nRays, HitTestMethod method, int required, int exclude, const Model* ignore[], RayHit* hits )
+{
+	GRINLIZ_PERFTRACK
+
+	Vector3F origin[EL_MAX_RAY_BATCH];
+	Vector3F direction[EL_MAX_RAY_BATCH];
+
+	GLASSERT( nRays > 0 && nRays <= EL_MAX_RAY_BATCH );
+	for( int i=0; i<nRays; ++i ) {
+		origin[i] = rays[i].origin;
+		direction[i] = rays[i].direction;
+	}
+	return spaceTree->QueryRays( origin, direction, nRays, required, exclude, ignore, method, hits );
+}
+
+
 void Engine::RestrictCamera()
 {
 	const Vector3F* eyeDir = camera.EyeDir3();
@@ -28,8 +28,7 @@
 #include "enginelimits.h"
 #include "model.h"
 #include "screenport.h"
-
-class RenderQueue;
+#include "renderqueue.h"
 
 /*
 	Standard state:
@@ -55,6 +54,8 @@ public:
 	void Draw();
 
 	SpaceTree* GetSpaceTree()	{ return spaceTree; }
+	// Drops the GL objects of the current map.
+	void DeviceLoss()			{ if ( map ) map->DeviceLoss(); }
 
 	void MoveCameraHome();
 	void CameraIso(  bool normal, bool sizeToWidth, float width, float height );
@@ -77,6 +78,10 @@ public:
 	Map* GetMap()						{ return map; }
 
 	const RenderQueue* GetRenderQueue()	{ return renderQueue; }
+	// Culling work from the last Draw().
+	const SpaceTreeStats& CullStats() const	{ return cullStats; }
+	// Render queue sizes and sorting from the last Draw().
+	const RenderQueueStats& QueueStats() const	{ return queueStats; }
 
 	// Only matters for MapMaker. Game never renders the metadata.
 	void EnableMetadata( bool enable )	{ enableMeta = enable; }
@@ -92,6 +97,13 @@ public:
 							int required, int exclude, const Model* ignore[],
 							grinliz::Vector3F* intersection );
 
+	// Batched IntersectModel for a fan of rays (up to EL_MAX_RAY_BATCH).
+	// 'hits' is an array of nRays. Returns the number of rays that hit.
+	int IntersectModels(	const grinliz::Ray* rays, int nRays,
+							HitTestMethod testMethod,
+							int required, int exclude, const Model* ignore[],
+							RayHit* hits );
+
 	enum {
 		NEAR,
 		FAR,
@@ -139,6 +151,8 @@ private:
 
 	SpaceTree* spaceTree;
 	RenderQueue* renderQueue;
+	SpaceTreeStats cullStats;
+	RenderQueueStats queueStats;
 
 	grinliz::Vector3F lightDirection;
 	grinliz::Matrix4  shadowMatrix;
@@ -40,7 +40,10 @@ enum {
 	EL_NIGHT_BLUE_U8		= 255,
 	EL_MAP_SIZE				= 64,		// maximum size.
 	EL_MAP_MAX_PATH			= 12,		// longest path anything can travel in one turn. Used to limit display memory.
-	EL_MAP_TEXTURE_SIZE		= 512
+	EL_MAP_TEXTURE_SIZE		= 512,
+	EL_MAX_RAY_BATCH		= 8,		// most rays in one batched ray query
+	EL_MAX_POINT_PARTICLES	= 8192,		// particle budgets; emission is throttled as they fill
+	EL_MAX_QUAD_PARTICLES	= 4096
 };
 
 static const float EL_NIGHT_RED		= ( (float)EL_NIGHT_RED_U8/255.f );
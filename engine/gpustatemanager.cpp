@@ -20,10 +20,9 @@ int GPUShader::matrixDepth[3];
 	if ( GPUShader::SupportsVBOs() ) {
 		U32 dataSize  = sizeof(Vertex)*nVertex;
 		glGenBuffersX( 1, (GLuint*) &buffer.id );
-		glBindBufferX( GL_ARRAY_BUFFER, buffer.id );
+		GPUShader::BindVertexBuffer( buffer.id );
 		// if vertex is null this will just allocate
 		glBufferDataX( GL_ARRAY_BUFFER, dataSize, vertex, vertex ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW );
-		glBindBufferX( GL_ARRAY_BUFFER, 0 );
 		CHECK_GL_ERROR;
 	}
 	return buffer;
@@ -33,11 +32,29 @@ int GPUShader::matrixDepth[3];
 void GPUVertexBuffer::Upload( const Vertex* data, int count, int start )
 {
 	GLASSERT( GPUShader::SupportsVBOs() );
-	glBindBufferX( GL_ARRAY_BUFFER, id );
+	GPUShader::BindVertexBuffer( id );
 	// target, offset, size, data
 	glBufferSubDataX( GL_ARRAY_BUFFER, start*sizeof(Vertex), count*sizeof(Vertex), data );
 	CHECK_GL_ERROR;
-	glBindBufferX( GL_ARRAY_BUFFER, 0 );
+}
+
+
+void GPUVertexBuffer::Stream( const void* data, int bytes )
+{
+	GLASSERT( GPUShader::SupportsVBOs() );
+	GPUShader::BindVertexBuffer( id );
+	// Orphan, then fill the new storage. (ES 1.1 has no GL_STREAM_DRAW.)
+	glBufferDataX( GL_ARRAY_BUFFER, bytes, 0, GL_DYNAMIC_DRAW );
+	glBufferSubDataX( GL_ARRAY_BUFFER, 0, bytes, data );
+	CHECK_GL_ERROR;
+}
+
+
+void GPUVertexBuffer::UploadBytes( const void* data, int bytes, int offset )
+{
+	GLASSERT( GPUShader::SupportsVBOs() );
+	GPUShader::BindVertexBuffer( id );
+	glBufferSubDataX( GL_ARRAY_BUFFER, offset, bytes, data );
 	CHECK_GL_ERROR;
 }
 
@@ -45,7 +62,7 @@ void GPUVertexBuffer::Upload( const Vertex* data, int count, int start )
 void GPUVertexBuffer::Destroy() 
 {
 	if ( id ) {
-		glDeleteBuffersX( 1, (GLuint*) &id );
+		GPUShader::DeleteBuffer( id );
 		id = 0;
 	}
 }
@@ -58,9 +75,8 @@ void GPUVertexBuffer::Destroy()
 	if ( GPUShader::SupportsVBOs() ) {
 		U32 dataSize  = sizeof(U16)*nIndex;
 		glGenBuffersX( 1, (GLuint*) &buffer.id );
-		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, buffer.id );
+		GPUShader::BindIndexBuffer( buffer.id );
 		glBufferDataX( GL_ELEMENT_ARRAY_BUFFER, dataSize, index, GL_STATIC_DRAW );
-		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, 0 );
 		CHECK_GL_ERROR;
 	}
 	return buffer;
@@ -69,20 +85,28 @@ void GPUVertexBuffer::Destroy()
 void GPUIndexBuffer::Upload( const uint16_t* data, int count, int start )
 {
 	GLASSERT( GPUShader::SupportsVBOs() );
-	glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, id );
+	GPUShader::BindIndexBuffer( id );
 	// target, offset, size, data
 	glBufferSubDataX( GL_ELEMENT_ARRAY_BUFFER, start*sizeof(uint16_t), count*sizeof(uint16_t), data );
 	CHECK_GL_ERROR;
-	glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, 0 );
-	CHECK_GL_ERROR;
 }
 
 
 
+void GPUIndexBuffer::Stream( const uint16_t* data, int nIndex )
+{
+	GLASSERT( GPUShader::SupportsVBOs() );
+	GPUShader::BindIndexBuffer( id );
+	glBufferDataX( GL_ELEMENT_ARRAY_BUFFER, nIndex*sizeof(uint16_t), 0, GL_DYNAMIC_DRAW );
+	glBufferSubDataX( GL_ELEMENT_ARRAY_BUFFER, 0, nIndex*sizeof(uint16_t), data );
+	CHECK_GL_ERROR;
+}
+
+
 void GPUIndexBuffer::Destroy() 
 {
 	if ( id ) {
-		glDeleteBuffersX( 1, (GLuint*) &id );
+		GPUShader::DeleteBuffer( id );
 		id = 0;
 	}
 }
@@ -129,6 +153,15 @@ void MatrixStack::Multiply( const grinliz::Matrix4& m )
 /*static*/ GPUShader GPUShader::current;
 /*static*/ int GPUShader::trianglesDrawn = 0;
 /*static*/ int GPUShader::drawCalls = 0;
+/*static*/ int GPUShader::stateCalls = 0;
+/*static*/ int GPUShader::stateCallsFiltered = 0;
+/*static*/ U32 GPUShader::boundVertexBuffer = 0;
+/*static*/ U32 GPUShader::boundIndexBuffer = 0;
+/*static*/ int GPUShader::activeUnit = 0;
+/*static*/ const Texture* GPUShader::boundTexture[2] = { 0, 0 };
+/*static*/ bool GPUShader::loadedXFormValid[2] = { false, false };
+/*static*/ Matrix4 GPUShader::loadedXForm[2];
+/*static*/ bool GPUShader::streamValid = false;
 /*static*/ uint32_t GPUShader::uid = 0;
 /*static*/ GPUShader::MatrixType GPUShader::matrixMode = MODELVIEW_MATRIX;
 /*static*/ MatrixStack GPUShader::textureStack[2];
@@ -159,6 +192,18 @@ void MatrixStack::Multiply( const grinliz::Matrix4& m )
 	GPUShader state;
 	current = state;
 
+	// Forget the shadow state; everything below is set explicitly.
+	streamValid = false;
+	activeUnit = 0;
+	boundTexture[0] = boundTexture[1] = 0;
+	loadedXFormValid[0] = loadedXFormValid[1] = false;
+	if ( SupportsVBOs() ) {
+		glBindBufferX( GL_ARRAY_BUFFER, 0 );
+		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	}
+	boundVertexBuffer = 0;
+	boundIndexBuffer = 0;
+
 	// Texture unit 1
 	glActiveTexture( GL_TEXTURE1 );
 	glClientActiveTexture( GL_TEXTURE1 );
@@ -208,19 +253,85 @@ void MatrixStack::Multiply( const grinliz::Matrix4& m )
 
 void GPUShader::SetTextureXForm( int unit )
 {
-	if ( textureStack[unit].NumMatrix()>1 || textureXFormInUse[unit] ) 
-	{
 #if XENOENGINE_OPENGL == 1
+	// The texture unit must be active.
+	GLASSERT( activeUnit == unit );
+	if ( TextureXFormChanged( unit ) ) {
 		glMatrixMode( GL_TEXTURE );
 		glLoadMatrixf( textureStack[unit].Top().x );
 		glMatrixMode( matrixMode == MODELVIEW_MATRIX ? GL_MODELVIEW : GL_PROJECTION );
-#endif
-		textureXFormInUse[unit] = textureStack[unit].NumMatrix()>1;
+		loadedXForm[unit] = textureStack[unit].Top();
+		loadedXFormValid[unit] = true;
+		++stateCalls;
 	}
+	else {
+		++stateCallsFiltered;
+	}
+#endif
+	textureXFormInUse[unit] = textureStack[unit].NumMatrix()>1;
 	CHECK_GL_ERROR;
 }
 
 
+bool GPUShader::TextureXFormChanged( int unit )
+{
+	return !loadedXFormValid[unit] || !( loadedXForm[unit] == textureStack[unit].Top() );
+}
+
+
+void GPUShader::BindVertexBuffer( U32 id )
+{
+	if ( id != boundVertexBuffer ) {
+		glBindBufferX( GL_ARRAY_BUFFER, id );
+		boundVertexBuffer = id;
+		++stateCalls;
+	}
+	else {
+		++stateCallsFiltered;
+	}
+}
+
+
+void GPUShader::BindIndexBuffer( U32 id )
+{
+	if ( id != boundIndexBuffer ) {
+		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, id );
+		boundIndexBuffer = id;
+		++stateCalls;
+	}
+	else {
+		++stateCallsFiltered;
+	}
+}
+
+
+void GPUShader::DeleteBuffer( U32 id )
+{
+	// Deleting a bound buffer unbinds it.
+	if ( id == boundVertexBuffer ) {
+		boundVertexBuffer = 0;
+		streamValid = false;
+	}
+	if ( id == boundIndexBuffer )
+		boundIndexBuffer = 0;
+	glDeleteBuffersX( 1, (GLuint*) &id );
+}
+
+
+void GPUShader::ActiveTextureUnit( int unit )
+{
+	if ( unit != activeUnit ) {
+		glActiveTexture( unit ? GL_TEXTURE1 : GL_TEXTURE0 );
+		glClientActiveTexture( unit ? GL_TEXTURE1 : GL_TEXTURE0 );
+		activeUnit = unit;
+		stateCalls += 2;
+	}
+	else {
+		stateCallsFiltered += 2;
+	}
+}
+
+
 //static 
 void GPUShader::SetState( const GPUShader& ns )
 {
@@ -229,44 +340,66 @@ void GPUShader::SetState( const GPUShader& ns )
 	GLASSERT( ns.stream.stride > 0 );
 
 #if XENOENGINE_OPENGL == 1
+	// The array pointers are relative to the bound vertex buffer, so they
+	// only carry over from the last draw if the buffer is the same too.
+	const bool samePointers =    streamValid
+							  && ns.streamPtr == current.streamPtr
+							  && ns.vertexBuffer == current.vertexBuffer
+							  && memcmp( &ns.stream, &current.stream, sizeof( GPUStream ) ) == 0;
+
 	// Texture1
 	if ( ns.stream.HasTexture1() || current.stream.HasTexture1() ) {
+		const bool enable1  = ns.texture1 && !current.texture1;
+		const bool disable1 = !ns.stream.HasTexture1() && current.stream.HasTexture1();
+		const bool use1     = ns.stream.HasTexture1();
 
-		glActiveTexture( GL_TEXTURE1 );
-		glClientActiveTexture( GL_TEXTURE1 );
-
-		if ( ns.texture1 && !current.texture1 ) {
-			GLASSERT( ns.texture0 );
-			GLASSERT( ns.stream.nTexture1 );
+		// Switching units costs 4 calls; only do it if unit 1 changes.
+		if (    enable1 || disable1
+			 || ( use1 && ( !samePointers || ns.texture1 != boundTexture[1] || TextureXFormChanged( 1 ) ) ) )
+		{
+			ActiveTextureUnit( 1 );
 
-			glEnable( GL_TEXTURE_2D );
-			glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+			if ( enable1 ) {
+				GLASSERT( ns.texture0 );
+				GLASSERT( ns.stream.nTexture1 );
 
-			// Craziness: code - by chance - is completely ES1.1 compliant (except for 
-			// auto mip-maps? not sure) except for this call, which just needed
-			// to be switched to [f] form.
-			//glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-			glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-		}
-		else if ( !ns.stream.HasTexture1() && current.stream.HasTexture1() ) {
-			glDisable( GL_TEXTURE_2D );
-			glDisableClientState( GL_TEXTURE_COORD_ARRAY );
-		}
-		
-		if (  ns.stream.HasTexture1() ) {
-			GLASSERT( ns.texture1 );
-			glTexCoordPointer(	ns.stream.nTexture1, 
-								GL_FLOAT, 
-								ns.stream.stride, 
-								PTR( ns.streamPtr, ns.stream.texture1Offset ) );
+				glEnable( GL_TEXTURE_2D );
+				glEnableClientState( GL_TEXTURE_COORD_ARRAY );
 
-			if ( ns.texture1 != current.texture1 ) {
-				glBindTexture( GL_TEXTURE_2D, ns.texture1->GLID() );
+				// Craziness: code - by chance - is completely ES1.1 compliant (except for 
+				// auto mip-maps? not sure) except for this call, which just needed
+				// to be switched to [f] form.
+				//glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+				glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+				stateCalls += 3;
+			}
+			else if ( disable1 ) {
+				glDisable( GL_TEXTURE_2D );
+				glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+				stateCalls += 2;
 			}
-			SetTextureXForm( 1 );
+			
+			if ( use1 ) {
+				GLASSERT( ns.texture1 );
+				if ( !samePointers ) {
+					glTexCoordPointer(	ns.stream.nTexture1, 
+										GL_FLOAT, 
+										ns.stream.stride, 
+										PTR( ns.streamPtr, ns.stream.texture1Offset ) );
+					++stateCalls;
+				}
+				if ( ns.texture1 != boundTexture[1] ) {
+					glBindTexture( GL_TEXTURE_2D, ns.texture1->GLID() );
+					boundTexture[1] = ns.texture1;
+					++stateCalls;
+				}
+				SetTextureXForm( 1 );
+			}
+			ActiveTextureUnit( 0 );
+		}
+		else {
+			++stateCallsFiltered;
 		}
-		glActiveTexture( GL_TEXTURE0 );
-		glClientActiveTexture( GL_TEXTURE0 );
 	}
 
 	CHECK_GL_ERROR;
@@ -278,22 +411,35 @@ void GPUShader::SetState( const GPUShader& ns )
 
 		glEnable( GL_TEXTURE_2D );
 		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+		stateCalls += 2;
 	}
 	else if ( !ns.stream.HasTexture0() && current.stream.HasTexture0() ) {
 		glDisable( GL_TEXTURE_2D );
 		glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+		stateCalls += 2;
 	}
 	
 	if (  ns.stream.HasTexture0() ) {
 		GLASSERT( ns.texture0 );
-		glTexCoordPointer(	ns.stream.nTexture0, 
-							GL_FLOAT, 
-							ns.stream.stride, 
-							PTR( ns.streamPtr, ns.stream.texture0Offset ) );	
+		if ( !samePointers ) {
+			glTexCoordPointer(	ns.stream.nTexture0, 
+								GL_FLOAT, 
+								ns.stream.stride, 
+								PTR( ns.streamPtr, ns.stream.texture0Offset ) );	
+			++stateCalls;
+		}
+		else {
+			++stateCallsFiltered;
+		}
 
-		if ( ns.texture0 != current.texture0 )
+		if ( ns.texture0 != boundTexture[0] )
 		{
 			glBindTexture( GL_TEXTURE_2D, ns.texture0->GLID() );
+			boundTexture[0] = ns.texture0;
+			++stateCalls;
+		}
+		else {
+			++stateCallsFiltered;
 		}
 		SetTextureXForm( 0 );
 	}
@@ -302,62 +448,93 @@ void GPUShader::SetState( const GPUShader& ns )
 	// Vertex
 	if ( ns.stream.HasPos() && !current.stream.HasPos() ) {
 		glEnableClientState( GL_VERTEX_ARRAY );
+		++stateCalls;
 	}
 	else if ( !ns.stream.HasPos() && current.stream.HasPos() ) {
 		glDisableClientState( GL_VERTEX_ARRAY );
+		++stateCalls;
 	}
 	if ( ns.stream.HasPos() ) {
-		glVertexPointer(	ns.stream.nPos, 
-							GL_FLOAT, 
-							ns.stream.stride, 
-							PTR( ns.streamPtr, ns.stream.posOffset ) );
+		if ( !samePointers ) {
+			glVertexPointer(	ns.stream.nPos, 
+								GL_FLOAT, 
+								ns.stream.stride, 
+								PTR( ns.streamPtr, ns.stream.posOffset ) );
+			++stateCalls;
+		}
+		else {
+			++stateCallsFiltered;
+		}
 	}
 
 	// Normal
 	if ( ns.stream.HasNormal() && !current.stream.HasNormal() ) {
 		glEnableClientState( GL_NORMAL_ARRAY );
+		++stateCalls;
 	}
 	else if ( !ns.stream.HasNormal() && current.stream.HasNormal() ) {
 		glDisableClientState( GL_NORMAL_ARRAY );
+		++stateCalls;
 	}
 	if ( ns.stream.HasNormal() ) {
 		GLASSERT( ns.stream.nNormal == 3 );
-		glNormalPointer(	GL_FLOAT, 
-							ns.stream.stride, 
-							PTR( ns.streamPtr, ns.stream.normalOffset ) );
+		if ( !samePointers ) {
+			glNormalPointer(	GL_FLOAT, 
+								ns.stream.stride, 
+								PTR( ns.streamPtr, ns.stream.normalOffset ) );
+			++stateCalls;
+		}
+		else {
+			++stateCallsFiltered;
+		}
 	}
 
 	// Color
 	if ( ns.stream.HasColor() && !current.stream.HasColor() ) {
 		glEnableClientState( GL_COLOR_ARRAY );
+		++stateCalls;
 	}
 	else if ( !ns.stream.HasColor() && current.stream.HasColor() ) {
 		glDisableClientState( GL_COLOR_ARRAY );
+		++stateCalls;
 	}
 	if ( ns.stream.HasColor() ) {
-		glColorPointer(	ns.stream.nColor, 
-						GL_FLOAT, 
-						ns.stream.stride,
-						PTR( ns.streamPtr, ns.stream.colorOffset ) );
+		if ( !samePointers ) {
+			glColorPointer(	ns.stream.nColor, 
+							GL_FLOAT, 
+							ns.stream.stride,
+							PTR( ns.streamPtr, ns.stream.colorOffset ) );
+			++stateCalls;
+		}
+		else {
+			++stateCallsFiltered;
+		}
 	}
+	streamValid = true;
 	CHECK_GL_ERROR;
 
 	// Lighting
 	if ( ns.HasLighting(0,0,0) && !current.HasLighting(0,0,0) ) {
 		glEnable( GL_LIGHTING );
 		glEnable ( GL_COLOR_MATERIAL );
+		stateCalls += 2;
 		// The call below isn't supported on all the mobile chipsets:
 		//glColorMaterial ( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE ) 
 		//GLOUTPUT(( "Lighting on.\n" ));
 	}
 	else if ( !ns.HasLighting(0,0,0) && current.HasLighting(0,0,0) ) {
 		glDisable( GL_LIGHTING );
+		++stateCalls;
 		//GLOUTPUT(( "Lighting off.\n" ));
 	}
 
 	// color
 	if ( ns.color != current.color ) {
 		glColor4f( ns.color.r, ns.color.g, ns.color.b, ns.color.a );
+		++stateCalls;
+	}
+	else {
+		++stateCallsFiltered;
 	}
 
 #elif XENOENGINE_OPENGL == 2
@@ -457,27 +634,36 @@ void GPUShader::SetState( const GPUShader& ns )
 */
 
 	// Blend
-	if ( ns.blend && !current.blend ) {
-		glEnable( GL_BLEND );
+	if ( ns.blend != current.blend ) {
+		if ( ns.blend )
+			glEnable( GL_BLEND );
+		else
+			glDisable( GL_BLEND );
+		++stateCalls;
 	}
-	else if ( !ns.blend && current.blend ) {
-		glDisable( GL_BLEND );
+	else {
+		++stateCallsFiltered;
 	}
 
 	// Depth Write
-	if ( ns.depthWrite && !current.depthWrite ) {
-		glDepthMask( GL_TRUE );
+	if ( ns.depthWrite != current.depthWrite ) {
+		glDepthMask( ns.depthWrite ? GL_TRUE : GL_FALSE );
+		++stateCalls;
 	}
-	else if ( !ns.depthWrite && current.depthWrite ) {
-		glDepthMask( GL_FALSE );
+	else {
+		++stateCallsFiltered;
 	}
 
 	// Depth test
-	if ( ns.depthTest && !current.depthTest ) {
-		glEnable( GL_DEPTH_TEST );
+	if ( ns.depthTest != current.depthTest ) {
+		if ( ns.depthTest )
+			glEnable( GL_DEPTH_TEST );
+		else
+			glDisable( GL_DEPTH_TEST );
+		++stateCalls;
 	}
-	else if ( !ns.depthTest && current.depthTest ) {
-		glDisable( GL_DEPTH_TEST );
+	else {
+		++stateCallsFiltered;
 	}
 
 	current = ns;
@@ -676,43 +862,35 @@ void GPUShader::Draw()
 	trianglesDrawn += nIndex / 3;
 	++drawCalls;
 
-	if ( indexPtr ) {
-	
-		if ( vertexBuffer ) {
-			glBindBufferX( GL_ARRAY_BUFFER, vertexBuffer );
+	// The buffers stay bound after the draw; the next draw only 
+	// rebinds if it uses different ones. Client memory needs 0 bound.
+	if ( !indexBuffer ) {
+		GLRELASSERT( indexPtr );
+		if ( SupportsVBOs() ) {
+			BindVertexBuffer( vertexBuffer );
+			BindIndexBuffer( 0 );
 		}
 		SetState( *this );
-
-		GLRELASSERT( !indexBuffer );
 		glDrawElements( GL_TRIANGLES, nIndex, GL_UNSIGNED_SHORT, indexPtr );
-
-		if ( vertexBuffer ) {
-			glBindBufferX( GL_ARRAY_BUFFER, 0 );
-		}
 	}
 	else {
 		GLRELASSERT( vertexBuffer );
 		GLRELASSERT( indexBuffer );
-		GLRELASSERT( stream.stride == sizeof(Vertex) );	// Just a current limitation that only Vertex structs go in a VBO. Could be fixed.
 
 		// This took a long time to figure. OpenGL is a state machine, except, apparently, when it isn't.
 		// The VBOs impact how the SetxxxPointers work. If they aren't set, then the wrong thing gets
 		// bound. What a PITA. And ugly design problem with OpenGL.
 		//
-		glBindBufferX( GL_ARRAY_BUFFER, vertexBuffer );
-		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+		BindVertexBuffer( vertexBuffer );
+		BindIndexBuffer( indexBuffer );
 		SetState( *this );
 
 #if defined( _MSC_VER ) && (XENOENGINE_OPENGL == 1)
 		GLASSERT( glIsEnabled( GL_VERTEX_ARRAY ) );
-		GLASSERT( !glIsEnabled( GL_COLOR_ARRAY ) );
 		GLASSERT( !glIsEnabled( GL_INDEX_ARRAY ) );
-		GLASSERT( glIsEnabled( GL_TEXTURE_COORD_ARRAY ) );
 #endif
-		glDrawElements( GL_TRIANGLES, nIndex, GL_UNSIGNED_SHORT, 0 );
-
-		glBindBufferX( GL_ARRAY_BUFFER, 0 );
-		glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, 0 );
+		// With an index buffer bound, indexPtr is the offset into it.
+		glDrawElements( GL_TRIANGLES, nIndex, GL_UNSIGNED_SHORT, indexPtr );
 	}
 	CHECK_GL_ERROR;
 }
@@ -813,8 +991,11 @@ void GPUShader::PushMatrix( MatrixType type )
 void GPUShader::MultMatrix( MatrixType type, const grinliz::Matrix4& m )
 {
 	// A lot of identities seem to get through...
-	if ( m.IsIdentity() )
+	if ( m.IsIdentity() ) {
+		++stateCallsFiltered;
 		return;
+	}
+	++stateCalls;
 
 	SwitchMatrixMode( type );
 
@@ -1072,6 +1253,8 @@ void PointParticleShader::DrawPoints( Texture* texture, float pointSize, int sta
 	GLASSERT( texture1 == 0 );
 	
 	// Will disable the texture units:
+	if ( SupportsVBOs() )
+		BindVertexBuffer( vertexBuffer );
 	SetState( *this );
 
 	// Which is a big cheat because we need to bind a texture without texture coordinates.
@@ -1093,6 +1276,7 @@ void PointParticleShader::DrawPoints( Texture* texture, float pointSize, int sta
 	// Clear the texture thing back up.
 	glDisable( GL_TEXTURE_2D );
 	glBindTexture( GL_TEXTURE_2D, 0 );
+	boundTexture[0] = 0;
 		
 	drawCalls++;
 	trianglesDrawn += count;
@@ -60,6 +60,11 @@ public:
 	// a null value for vertex will create an empty buffer
 	static GPUVertexBuffer Create( const Vertex* vertex, int nVertex );
 	void Upload( const Vertex* data, int size, int start );
+	// Replaces the contents with 'bytes' of vertex data in any format. The
+	// old storage is orphaned, so a draw still reading it doesn't stall.
+	void Stream( const void* data, int bytes );
+	// Upload for vertex data in any format; 'offset' is in bytes.
+	void UploadBytes( const void* data, int bytes, int offset );
 
 	GPUVertexBuffer() : GPUBuffer() {}
 	void Destroy();
@@ -72,6 +77,8 @@ class GPUIndexBuffer : public GPUBuffer
 public:
 	static GPUIndexBuffer Create( const uint16_t* index, int nIndex );
 	void Upload( const uint16_t* data, int size, int start );
+	// Replaces the contents, orphaning the old storage.
+	void Stream( const uint16_t* data, int nIndex );
 
 	GPUIndexBuffer() : GPUBuffer() {}
 	void Destroy();
@@ -159,7 +166,8 @@ public:
 	}
 
 
-	void SetStream( const GPUStream& stream, const GPUVertexBuffer& vertex, int nIndex, const GPUIndexBuffer& index ) 
+	// 'indexStart' is the first index drawn from the index buffer.
+	void SetStream( const GPUStream& stream, const GPUVertexBuffer& vertex, int nIndex, const GPUIndexBuffer& index, int indexStart=0 ) 
 	{
 		GLASSERT( stream.stride > 0 );
 		GLASSERT( nIndex % 3 == 0 );
@@ -168,7 +176,7 @@ public:
 
 		this->stream = stream;
 		this->streamPtr = 0;
-		this->indexPtr = 0;
+		this->indexPtr = (const uint16_t*)( sizeof(uint16_t) * indexStart );	// offset into the index buffer
 		this->nIndex = nIndex;
 		this->vertexBuffer = vertex.ID();
 		this->indexBuffer = index.ID();
@@ -191,6 +199,21 @@ public:
 	}
 
 
+	// Vertices only, for PointParticleShader::DrawPoints().
+	void SetStream( const GPUStream& stream, const GPUVertexBuffer& vertex ) 
+	{
+		GLASSERT( stream.stride > 0 );
+		GLASSERT( vertex.IsValid() );
+
+		this->stream = stream;
+		this->streamPtr = 0;
+		this->indexPtr = 0;
+		this->nIndex = 0;
+		this->vertexBuffer = vertex.ID();
+		this->indexBuffer = 0;
+	}
+
+
 	void SetTexture0( Texture* tex ) { texture0 = tex; }
 	bool HasTexture0() const { return texture0 != 0; }
 	bool HasLighting( grinliz::Vector4F* dir, grinliz::Vector4F* ambient, grinliz::Vector4F* diffuse ) const { 
@@ -240,9 +263,17 @@ public:
 		return 0;
 	}
 
-	static void ResetTriCount()	{ trianglesDrawn = 0; drawCalls = 0; }
+	static void ResetTriCount()	{ trianglesDrawn = 0; drawCalls = 0; stateCalls = 0; stateCallsFiltered = 0; }
 	static int TrianglesDrawn() { return trianglesDrawn; }
 	static int DrawCalls()		{ return drawCalls; }
+	// GL state calls (binds, pointers, enables, texture matrices) issued, and
+	// the ones skipped because the GL already had that state.
+	static int StateCalls()				{ return stateCalls; }
+	static int StateCallsFiltered()		{ return stateCallsFiltered; }
+
+	// Call after binding a texture outside of the shader, so the
+	// bound texture isn't assumed.
+	static void InvalidateTextureBinding()	{ boundTexture[0] = boundTexture[1] = 0; }
 
 	static bool SupportsVBOs();
 
@@ -263,6 +294,8 @@ protected:
 	static void SetState( const GPUShader& );
 
 private:
+	friend class GPUVertexBuffer;
+	friend class GPUIndexBuffer;
 
 	static void SwitchMatrixMode( MatrixType type );	
 	static GPUShader		current;
@@ -280,9 +313,28 @@ private:
 
 	static void SetTextureXForm( int unit );
 
+protected:
+	// Shadow of the GL state that isn't captured by 'current'. The 
+	// Set/Bind calls only go to the GL if the state changes.
+	static void BindVertexBuffer( U32 id );
+	static void BindIndexBuffer( U32 id );
+	static void DeleteBuffer( U32 id );
+	static void ActiveTextureUnit( int unit );
+	static bool TextureXFormChanged( int unit );
+
+	static U32				boundVertexBuffer;
+	static U32				boundIndexBuffer;
+	static int				activeUnit;
+	static const Texture*	boundTexture[2];
+	static bool				loadedXFormValid[2];
+	static grinliz::Matrix4	loadedXForm[2];	// texture matrix in the GL, per unit
+	static bool				streamValid;	// the GL pointers match 'current'
+
 protected:
 	static int trianglesDrawn;
 	static int drawCalls;
+	static int stateCalls;
+	static int stateCallsFiltered;
 	static uint32_t uid;
 
 	static const void* PTR( const void* base, int offset ) {
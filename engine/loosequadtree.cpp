@@ -17,6 +17,15 @@
 #include "map.h"
 #include "../grinliz/glperformance.h"
 #include "gpustatemanager.h"
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#	define SPACETREE_SSE
+#	include <xmmintrin.h>
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+#	define SPACETREE_NEON
+#	include <arm_neon.h>
+#endif
+
 using namespace grinliz;
 
 /*
@@ -32,6 +41,10 @@ SpaceTree::SpaceTree( float yMin, float yMax )
 	this->yMin = yMin;
 	this->yMax = yMax;
 	queryID = 0;
+	deferUpdates = false;
+	nUpdates = 0;
+	nRelinks = 0;
+	nodesVisited = planesComputed = spheresComputed = modelsFound = 0;
 
 	InitNode();
 	memset( &shelf, 0, sizeof(Node) );
@@ -110,6 +123,22 @@ void SpaceTree::InitNode()
 		++depth;
 		nodeSize >>= 1;
 	}
+
+	for( int i=0; i<NUM_NODES; ++i ) {
+		Node* node = &nodeArr[i];
+		memset( &node->childAABB, 0, sizeof( node->childAABB ) );
+		if ( node->child[0] ) {
+			for( int k=0; k<4; ++k )
+				node->childAABB.Set( k, node->child[k]->looseAABB );
+		}
+	}
+}
+
+
+void SpaceTree::AABB4::Set( int i, const Rectangle3F& aabb )
+{
+	minX[i] = aabb.min.x;	minY[i] = aabb.min.y;	minZ[i] = aabb.min.z;
+	maxX[i] = aabb.max.x;	maxY[i] = aabb.max.y;	maxZ[i] = aabb.max.z;
 }
 
 
@@ -121,6 +150,7 @@ Model* SpaceTree::AllocModel( const ModelResource* resource )
 	item->node = 0;
 	item->next = 0;	// very important to clear pointers before Init() - which will cause Link to occur.
 	item->prev = 0;
+	item->pending = false;
 	item->model.Init( resource, this );
 
 	return &item->model;
@@ -134,8 +164,18 @@ void SpaceTree::FreeModel( Model* model )
 
 	Item* item = (Item*)model;	// cast depends on model being first in the structure.
 
-	GLASSERT( item->node );
-	item->node->Remove( item );
+	if ( item->pending ) {
+		for( int i=0; i<pending.Size(); ++i ) {
+			if ( pending[i] == item ) {
+				pending.SwapRemove( i );
+				break;
+			}
+		}
+		item->pending = false;
+	}
+	// A model that was never flushed isn't in a node yet.
+	if ( item->node )
+		item->node->Remove( item );
 	item->model.Free();
 	modelPool.Free( item );
 }
@@ -143,6 +183,7 @@ void SpaceTree::FreeModel( Model* model )
 
 void SpaceTree::ShelveModel( bool shelve, Model* model )
 {
+	FlushUpdates();
 	Item* item = (Item*)model;	// cast depends on model being first in the structure.
 	GLASSERT( item->node );
 	item->node->Remove( item );
@@ -210,22 +251,57 @@ void SpaceTree::ShelveAll( bool shelve )
 
 void SpaceTree::Update( Model* model )
 {
-	// Unlink if currently in tree.
 	Item* item = (Item*)model;	// cast depends on model being first in the structure.
 
 	if ( item->node == &shelf )
 		return;	// no effect when items are on the shelf.
 
-	if ( item->node ) 
-		item->node->Remove( item );
-	item->node = 0;
+	++nUpdates;
+	if ( deferUpdates ) {
+		if ( !item->pending ) {
+			item->pending = true;
+			pending.Push( item );
+		}
+		return;
+	}
+	Relink( item );
+}
 
-	// Since the tree is somewhat modified from the ideal, start with the 
-	// most idea node and work up. Note that everything fits at the top node.
-	int depth = DEPTH-1;
-	Node* node = 0;
-	
-	Rectangle3F bounds = model->AABB();
+
+void SpaceTree::SetDeferUpdates( bool defer )
+{
+	if ( !defer )
+		FlushUpdates();
+	deferUpdates = defer;
+}
+
+
+void SpaceTree::FlushUpdates()
+{
+	// Update all the transforms together before they are used for the placement.
+	const Model* models[64];
+	for( int base=0; base<pending.Size(); base+=64 ) {
+		const int n = Min( pending.Size()-base, 64 );
+		for( int i=0; i<n; ++i )
+			models[i] = &pending[base+i]->model;
+		Model::UpdateXForms( models, n );
+	}
+
+	for( int i=0; i<pending.Size(); ++i ) {
+		Item* item = pending[i];
+		item->pending = false;
+		Relink( item );
+	}
+	pending.Clear();
+}
+
+
+void SpaceTree::Relink( Item* item )
+{
+	if ( item->node == &shelf )
+		return;	// shelved while the update was pending
+
+	Rectangle3F bounds = item->model.AABB();
 
 	// Clamp to tree range.
 	if (bounds.min.y < yMin ) 
@@ -236,6 +312,28 @@ void SpaceTree::Update( Model* model )
 	int x = (int)bounds.min.x;
 	int z = (int)bounds.min.z;
 
+	if ( item->node ) {
+		// Most moves (a unit walking, a turn) stay in the node. The model can
+		// stay if it still fits, and wouldn't fit the node one level down. (A
+		// deeper node is inside the loose bounds of the one above it, so if
+		// that one doesn't fit, nothing deeper will.)
+		const Node* node = item->node;
+		if (    node->looseAABB.Contains( bounds )
+			 && ( node->depth == DEPTH-1 || !GetNode( node->depth+1, x, z )->looseAABB.Contains( bounds ) ) )
+		{
+			return;
+		}
+		// Unlink if currently in tree.
+		item->node->Remove( item );
+	}
+	item->node = 0;
+	++nRelinks;
+
+	// Since the tree is somewhat modified from the ideal, start with the 
+	// most idea node and work up. Note that everything fits at the top node.
+	int depth = DEPTH-1;
+	Node* node = 0;
+
 	while( depth > 0 ) {
 		node = GetNode( depth, x, z );
 		if ( node->looseAABB.Contains( bounds ) ) {
@@ -276,6 +374,8 @@ Model* SpaceTree::Query( const Plane* planes, int nPlanes, int required, int exc
 {
 	GRINLIZ_PERFTRACK
 	
+	FlushUpdates();
+
 	modelRoot = 0;
 	nodesVisited = 0;
 	planesComputed = 0;
@@ -291,7 +391,19 @@ Model* SpaceTree::Query( const Plane* planes, int nPlanes, int required, int exc
 	}
 #endif
 
-	QueryPlanesRec( planes, nPlanes, grinliz::INTERSECT, &nodeArr[0], 0 );
+	if ( nPlanes == 0 ) {
+		QueryPlanesRec( planes, 0, grinliz::POSITIVE, &nodeArr[0], 0 );
+	}
+	else {
+		AABB4 root;
+		for( int i=0; i<4; ++i )
+			root.Set( i, nodeArr[0].looseAABB );
+		int result;
+		U32 positive;
+		ComparePlanesAABB4( planes, nPlanes, 0, root, 1, &result, &positive, &planesComputed );
+		if ( result != grinliz::NEGATIVE )
+			QueryPlanesRec( planes, nPlanes, result, &nodeArr[0], positive );
+	}
 
 	/*
 	if ( debug ) {
@@ -311,6 +423,17 @@ Model* SpaceTree::Query( const Plane* planes, int nPlanes, int required, int exc
 	return modelRoot;
 }
 
+
+void SpaceTree::QueryStats( SpaceTreeStats* stats ) const
+{
+	stats->nodesVisited = nodesVisited;
+	stats->planesComputed = planesComputed;
+	stats->spheresComputed = spheresComputed;
+	stats->modelsFound = modelsFound;
+	stats->updates = nUpdates;
+	stats->relinks = nRelinks;
+}
+
 void SpaceTree::Node::Add( Item* item ) 
 {
 	GLASSERT( item->next == 0 );
@@ -370,121 +493,225 @@ void SpaceTree::Dump( Node* node )
 
 
 
-void SpaceTree::QueryPlanesRec(	const Plane* planes, int nPlanes, int intersection, const Node* node, U32 positive )
+void SpaceTree::ComparePlanesAABB4(	const Plane* planes, int nPlanes, U32 positive,
+										const AABB4& b, int n, int* result, U32* mask, int* counter )
 {
-	#define IS_POSITIVE( pos, i ) ( pos & (1<<i) )
+	// Same test as ComparePlaneAABB: the plane normal picks the most negative
+	// and most positive corner, and that choice is the same for all 4 boxes.
+	// A box is NEGATIVE if its most positive corner is behind any plane, and
+	// POSITIVE if its most negative corner is in front of all of them.
+	U32 negative = 0;
+	const U32 all = ( 1<<n ) - 1;
+	for( int i=0; i<n; ++i )
+		mask[i] = positive;
+
+	for( int k=0; k<nPlanes && negative != all; ++k ) {
+		if ( positive & (1<<k) )
+			continue;
 
-	if ( intersection == grinliz::POSITIVE ) 
-	{
-		// we are fully inside, and don't need to check.
-		++nodesVisited;
+		const Plane& p = planes[k];
+		const float* negX = ( p.n.x > 0.0f ) ? b.minX : b.maxX;
+		const float* posX = ( p.n.x > 0.0f ) ? b.maxX : b.minX;
+		const float* negY = ( p.n.y > 0.0f ) ? b.minY : b.maxY;
+		const float* posY = ( p.n.y > 0.0f ) ? b.maxY : b.minY;
+		const float* negZ = ( p.n.z > 0.0f ) ? b.minZ : b.maxZ;
+		const float* posZ = ( p.n.z > 0.0f ) ? b.maxZ : b.minZ;
+
+		U32 posBits = 0, negBits = 0;
+#if defined( SPACETREE_SSE )
+		const __m128 nx = _mm_set1_ps( p.n.x );
+		const __m128 ny = _mm_set1_ps( p.n.y );
+		const __m128 nz = _mm_set1_ps( p.n.z );
+		const __m128 d  = _mm_set1_ps( p.d );
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 fNeg = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, _mm_loadu_ps( negX ) ), _mm_mul_ps( ny, _mm_loadu_ps( negY ) ) ),
+								  _mm_add_ps( _mm_mul_ps( nz, _mm_loadu_ps( negZ ) ), d ) );
+		__m128 fPos = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, _mm_loadu_ps( posX ) ), _mm_mul_ps( ny, _mm_loadu_ps( posY ) ) ),
+								  _mm_add_ps( _mm_mul_ps( nz, _mm_loadu_ps( posZ ) ), d ) );
+		posBits = (U32)_mm_movemask_ps( _mm_cmpgt_ps( fNeg, zero ) );
+		negBits = (U32)_mm_movemask_ps( _mm_cmplt_ps( fPos, zero ) );
+#elif defined( SPACETREE_NEON )
+		const float32x4_t d = vdupq_n_f32( p.d );
+		const float32x4_t zero = vdupq_n_f32( 0.0f );
+		static const uint32_t laneBit[4] = { 1, 2, 4, 8 };
+		const uint32x4_t bits = vld1q_u32( laneBit );
+
+		float32x4_t fNeg = vmlaq_n_f32( vmlaq_n_f32( vmlaq_n_f32( d, vld1q_f32( negX ), p.n.x ), vld1q_f32( negY ), p.n.y ), vld1q_f32( negZ ), p.n.z );
+		float32x4_t fPos = vmlaq_n_f32( vmlaq_n_f32( vmlaq_n_f32( d, vld1q_f32( posX ), p.n.x ), vld1q_f32( posY ), p.n.y ), vld1q_f32( posZ ), p.n.z );
+		uint32x4_t pb = vandq_u32( vcgtq_f32( fNeg, zero ), bits );
+		uint32x4_t nb = vandq_u32( vcltq_f32( fPos, zero ), bits );
+		uint32x2_t pb2 = vorr_u32( vget_low_u32( pb ), vget_high_u32( pb ) );
+		uint32x2_t nb2 = vorr_u32( vget_low_u32( nb ), vget_high_u32( nb ) );
+		posBits = vget_lane_u32( pb2, 0 ) | vget_lane_u32( pb2, 1 );
+		negBits = vget_lane_u32( nb2, 0 ) | vget_lane_u32( nb2, 1 );
+#else
+		for( int i=0; i<4; ++i ) {
+			float fNeg = p.n.x*negX[i] + p.n.y*negY[i] + p.n.z*negZ[i] + p.d;
+			float fPos = p.n.x*posX[i] + p.n.y*posY[i] + p.n.z*posZ[i] + p.d;
+			if ( fNeg > 0.0f ) posBits |= (1<<i);
+			if ( fPos < 0.0f ) negBits |= (1<<i);
+		}
+#endif
+		posBits &= all;
+		negBits &= all;
+		*counter += n;
+		negative |= negBits;
+		for( int i=0; i<n; ++i ) {
+			if ( posBits & (1<<i) )
+				mask[i] |= (1<<k);
+		}
 	}
-	else if ( intersection == grinliz::INTERSECT ) 
-	{
-		const Rectangle3F& aabb = node->looseAABB;
-		
-		int nPositive = 0;
-
-		for( int i=0; i<nPlanes; ++i ) {
-			// Assume positive bit is set, check if not. Once we go POSITIVE, we don't need 
-			// to check the sub-nodes. They will still be POSITIVE. Saves about 1/2 the Plane
-			// and Sphere checks.
-			//
-			int comp = grinliz::POSITIVE;
-			if ( IS_POSITIVE( positive, i ) == 0 ) {
-				comp = ComparePlaneAABB( planes[i], aabb );
-				++planesComputed;
-			}
 
-			// If the aabb is negative of any plane, it is culled.
-			if ( comp == grinliz::NEGATIVE ) {
-				intersection = grinliz::NEGATIVE;
-				break;
-			}
-			else if ( comp == grinliz::POSITIVE ) {
-				// If the aabb intersects the plane, the result is subtle:
-				// intersecting a plane doesn't meen it is in the frustrum. 
-				// The intersection of the aabb and the plane is often 
-				// completely outside the frustum.
-
-				// If the aabb is positive of ALL the planes then we are in good shape.
-				positive |= (1<<i);
-				++nPositive;
-			}
+	const U32 allPlanes = ( 1<<nPlanes ) - 1;
+	for( int i=0; i<n; ++i ) {
+		if ( negative & (1<<i) )
+			result[i] = grinliz::NEGATIVE;
+		else if ( mask[i] == allPlanes )
+			result[i] = grinliz::POSITIVE;
+		else
+			result[i] = grinliz::INTERSECT;
+	}
+}
+
+
+void SpaceTree::AddModels( const Plane* planes, int nPlanes, U32 positive, Model** models, const AABB4& boxes, int n )
+{
+	int result[4];
+	U32 mask[4];
+	ComparePlanesAABB4( planes, nPlanes, positive, boxes, n, result, mask, &spheresComputed );
+
+	for( int i=0; i<n; ++i ) {
+		if ( debug ) {
+			GLOUTPUT(( "Testing: 0x%lx %s...%s\n", (intptr_t)models[i], models[i]->GetResource()->header.name.c_str(),
+					   result[i] == grinliz::NEGATIVE ? "NEGATIVE" : "yes" ));
 		}
-		if ( nPositive == nPlanes ) {
-			// All positive is quick:
-			intersection = grinliz::POSITIVE;
+		if ( result[i] != grinliz::NEGATIVE ) {
+			models[i]->next = modelRoot;
+			modelRoot = models[i];
+			++modelsFound;
 		}
-		++nodesVisited;
 	}
-	if ( intersection != grinliz::NEGATIVE ) 
-	{
+}
+
+
+// 'node' has already been compared to the planes: 'intersection' is POSITIVE or INTERSECT,
+// and 'positive' is the mask of planes the node is fully in front of.
+void SpaceTree::QueryPlanesRec(	const Plane* planes, int nPlanes, int intersection, const Node* node, U32 positive )
+{
+	GLASSERT( intersection != grinliz::NEGATIVE );
+	++nodesVisited;
+
 #ifdef DEBUG
-		if ( intersection == grinliz::INTERSECT )
-			node->hit = 1;
-		else if ( intersection == grinliz::POSITIVE )
-			node->hit = 2;
+	if ( intersection == grinliz::INTERSECT )
+		node->hit = 1;
+	else if ( intersection == grinliz::POSITIVE )
+		node->hit = 2;
 #endif
-		const int _requiredFlags = requiredFlags;
-		const int _excludedFlags = excludedFlags;
+	const int _requiredFlags = requiredFlags;
+	const int _excludedFlags = excludedFlags;
 
-		for( Item* item=node->root; item; item=item->next ) 
-		{
-			Model* m = &item->model;
-			const int flags = m->Flags();
-
-			if (    ( (_requiredFlags & flags) == _requiredFlags)
-				 && ( (_excludedFlags & flags) == 0 ) )
-			{	
-				if ( debug ) {
-					GLOUTPUT(( "%*s[%d] Testing: 0x%lx %s", node->depth, " ", node->depth, (intptr_t)m, m->GetResource()->header.name.c_str() ));
-				}
-				if ( intersection == grinliz::INTERSECT ) {
-					const Rectangle3F& aabb = m->AABB();
-					int compare = grinliz::INTERSECT;
-
-					for( int k=0; k<nPlanes; ++k ) {
-						// Since the bounding sphere is in the AABB, we
-						// can check for the positive plane again.
-						if ( IS_POSITIVE( positive, k ) == 0 ) {
-							compare = ComparePlaneAABB( planes[k], aabb );
-							++spheresComputed;
-							if ( compare == grinliz::NEGATIVE ) {
-								break;
-							}
-						}
-					}
-					if ( compare == grinliz::NEGATIVE ) {
-						if ( debug ) {
-							GLOUTPUT(( "...NEGATIVE\n" ));
-						}
-						continue;
-					}
-				}
-				if ( debug ) {
-					GLOUTPUT(( "...yes\n" ));
-				}
-				
+	// Models are gathered 4 at a time and compared to the planes together.
+	// Once the node is POSITIVE, all the models are in.
+	Model* batch[4];
+	AABB4 batchAABB;
+	int nBatch = 0;
+
+	for( Item* item=node->root; item; item=item->next ) 
+	{
+		Model* m = &item->model;
+		const int flags = m->Flags();
+
+		if (    ( (_requiredFlags & flags) == _requiredFlags)
+			 && ( (_excludedFlags & flags) == 0 ) )
+		{	
+			if ( intersection == grinliz::POSITIVE ) {
 				m->next = modelRoot;
 				modelRoot = m;
 				++modelsFound;
+				continue;
+			}
+			batch[nBatch] = m;
+			batchAABB.Set( nBatch, m->AABB() );
+			++nBatch;
+			if ( nBatch == 4 ) {
+				AddModels( planes, nPlanes, positive, batch, batchAABB, nBatch );
+				nBatch = 0;
 			}
 		}
-		
-		if ( node->child[0] )  {
+	}
+	if ( nBatch ) {
+		// Keep the unused lanes finite.
+		for( int i=nBatch; i<4; ++i )
+			batchAABB.Set( i, batch[0]->AABB() );
+		AddModels( planes, nPlanes, positive, batch, batchAABB, nBatch );
+	}
+
+	if ( node->child[0] ) {
+		const Node* const* child = node->child;
+		if ( ( child[0]->nModels | child[1]->nModels | child[2]->nModels | child[3]->nModels ) == 0 )
+			return;
+
+		if ( intersection == grinliz::POSITIVE ) {
+			// We are fully inside, and don't need to check.
+			for( int i=0; i<4; ++i ) {
+				if ( child[i]->nModels )
+					QueryPlanesRec( planes, nPlanes, grinliz::POSITIVE, child[i], positive );
+			}
+		}
+		else {
+			// Planes the parent is positive of stay positive for the children,
+			// so only the rest get computed.
+			int result[4];
+			U32 mask[4];
+			ComparePlanesAABB4( planes, nPlanes, positive, node->childAABB, 4, result, mask, &planesComputed );
 			for( int i=0; i<4; ++i ) {
-				if ( node->child[i]->nModels )
-					QueryPlanesRec( planes, nPlanes, intersection, node->child[i], positive );
+				if ( child[i]->nModels && result[i] != grinliz::NEGATIVE )
+					QueryPlanesRec( planes, nPlanes, result[i], child[i], mask[i] );
 			}
 		}
 	}
-	#undef IS_POSITIVE
 }
 
 
+// Slab test of a ray against a box, limited to [0,tMax]. 'invDir' is 1/dir, with
+// 0 standing in for the components where the ray is parallel to the slab.
+static bool RayEnterAABB( const Vector3F& origin, const Vector3F& invDir, const Rectangle3F& aabb, float tMax, float* tEnter )
+{
+	float t0 = 0.0f;
+	float t1 = tMax;
+
+	for( int i=0; i<3; ++i ) {
+		const float o = origin.X(i);
+		const float inv = invDir.X(i);
+
+		if ( inv == 0.0f ) {
+			if ( o < aabb.min.X(i) || o > aabb.max.X(i) )
+				return false;
+			continue;
+		}
+		float tNear = ( aabb.min.X(i) - o ) * inv;
+		float tFar  = ( aabb.max.X(i) - o ) * inv;
+		if ( tNear > tFar )
+			Swap( &tNear, &tFar );
+		t0 = Max( t0, tNear );
+		t1 = Min( t1, tFar );
+		if ( t0 > t1 )
+			return false;
+	}
+	*tEnter = t0;
+	return true;
+}
 
 
+/*
+	Walks the nodes front to back: a node is opened in order of where the ray
+	enters its loose bounds, and skipped once that entry is further than the
+	closest confirmed hit. Every model in a node is inside the node's loose
+	bounds, so nothing behind the cut can be closer. (The hit AABB isn't bounded
+	by the model bounds, so TEST_HIT_AABB still visits every node along the ray;
+	it just skips the triangles.)
+*/
 Model* SpaceTree::QueryRay( const Vector3F& _origin, 
 							const Vector3F& _direction, 
 							int required, int excluded, const Model** ignore,
@@ -492,6 +719,7 @@ Model* SpaceTree::QueryRay( const Vector3F& _origin,
 							Vector3F* intersection ) 
 {
 	//GLOUTPUT(( "query ray\n" ));
+	FlushUpdates();
 	modelRoot = 0;
 	nodesVisited = 0;
 	modelsFound = 0;
@@ -520,59 +748,278 @@ Model* SpaceTree::QueryRay( const Vector3F& _origin,
 		// Can click outside of AABB pretty commonly, actually.
 		return 0;
 	}
-	Plane planes[6];
-	Rectangle3F rect;
-	rect.FromPair( p0, p1 );
-	Plane::CreatePlanes( rect, planes );
-
-	Model* modelRoot = Query( planes, 6, required, excluded );
 
-	// We now have a batch of models. Are any of them a hit??
 	GLASSERT( testType == TEST_HIT_AABB || testType == TEST_TRI );
 
+	Vector3F invDir;
+	for( int i=0; i<3; ++i ) {
+		float d = dir.X(i);
+		invDir.X(i) = ( d > EPSILON || d < -EPSILON ) ? 1.0f / d : 0.0f;
+	}
+	const bool prune = ( testType == TEST_TRI );
+
 	float close = FLT_MAX;
 	Model* closeModel = 0;
 	Vector3F testInt;
 	float t;
 
-	for( Model* root=modelRoot; root; root=root->next ) {
-		if ( Ignore( root, ignore ) )
+	struct StackEntry {
+		const Node* node;
+		float t;
+	};
+	StackEntry stack[DEPTH*4];
+	int nStack = 1;
+	stack[0].node = &nodeArr[0];
+	stack[0].t = 0.0f;
+
+	while( nStack ) {
+		--nStack;
+		const Node* node = stack[nStack].node;
+		if ( prune && stack[nStack].t > close )
 			continue;
+		++nodesVisited;
 
-		//GLOUTPUT(( "Consider: %s\n", root->GetResource()->header.name ));
-		int result = grinliz::REJECT;
+		for( Item* item=node->root; item; item=item->next ) {
+			Model* root = &item->model;
+			const int flags = root->Flags();
+			if (    ( (requiredFlags & flags) != requiredFlags)
+				 || ( (excludedFlags & flags) != 0 ) )
+			{
+				continue;
+			}
+			if ( Ignore( root, ignore ) )
+				continue;
 
-		if ( testType == TEST_HIT_AABB ) {
-			Rectangle3F modelAABB;
+			//GLOUTPUT(( "Consider: %s\n", root->GetResource()->header.name ));
+			int result = grinliz::REJECT;
+			++modelsFound;
 
-			root->CalcHitAABB( &modelAABB );
-			result = IntersectRayAABB( p0, dir, modelAABB, &testInt, &t );
-		}
-		else if ( testType == TEST_TRI ) {
-			t = FLT_MAX;
-			result = root->IntersectRay( p0, dir, &testInt );
+			if ( testType == TEST_HIT_AABB ) {
+				Rectangle3F modelAABB;
+
+				root->CalcHitAABB( &modelAABB );
+				result = IntersectRayAABB( p0, dir, modelAABB, &testInt, &t );
+			}
+			else if ( testType == TEST_TRI ) {
+				// Cheap reject on the model bounds before the triangles.
+				float tBounds;
+				if ( !RayEnterAABB( p0, invDir, root->AABB(), close, &tBounds ) )
+					continue;
+
+				t = FLT_MAX;
+				result = root->IntersectRay( p0, dir, &testInt );
+
+				if ( result == grinliz::INTERSECT ) {
+					Vector3F delta = p0 - testInt;
+					t = delta.Length();
+					//GLOUTPUT(( "Hit: %s t=%.2f\n", root->GetResource()->header.name, t ));
+				}	
+			}
 
 			if ( result == grinliz::INTERSECT ) {
-				Vector3F delta = p0 - testInt;
-				t = delta.LengthSquared();
-				//GLOUTPUT(( "Hit: %s t=%.2f\n", root->GetResource()->header.name, t ));
-			}	
+				// Ugly little bug: check for t>=0, else could collide with objects
+				// that touch the bounding box but are before the ray starts.
+				if ( t >= 0.0f && t < close ) {
+					closeModel = root;
+					*intersection = testInt;
+					close = t;
+				}
+			}
 		}
 
-		if ( result == grinliz::INTERSECT ) {
-			// Ugly little bug: check for t>=0, else could collide with objects
-			// that touch the bounding box but are before the ray starts.
-			if ( t >= 0.0f && t < close ) {
-				closeModel = root;
-				*intersection = testInt;
-				close = t;
+		if ( node->child[0] ) {
+			// Push the children far to near, so the nearest is opened next.
+			StackEntry child[4];
+			int nChild = 0;
+			for( int i=0; i<4; ++i ) {
+				float tEnter;
+				if (    node->child[i]->nModels
+					 && RayEnterAABB( p0, invDir, node->child[i]->looseAABB, prune ? close : FLT_MAX, &tEnter ) )
+				{
+					int k = nChild++;
+					for( ; k>0 && child[k-1].t < tEnter; --k )
+						child[k] = child[k-1];
+					child[k].node = node->child[i];
+					child[k].t = tEnter;
+				}
+			}
+			GLASSERT( nStack + nChild <= DEPTH*4 );
+			for( int i=0; i<nChild; ++i ) {
+				stack[nStack++] = child[i];
 			}
 		}
 	}
-	if ( closeModel ) {
-		return closeModel;
+	return closeModel;
+}
+
+
+int SpaceTree::QueryRays(	const Vector3F* _origin,
+							const Vector3F* _direction,
+							int nRays,
+							int required, int excluded, const Model** ignore,
+							HitTestMethod testType,
+							RayHit* hits )
+{
+	GLASSERT( nRays > 0 && nRays <= EL_MAX_RAY_BATCH );
+	GLASSERT( testType == TEST_HIT_AABB || testType == TEST_TRI );
+	FlushUpdates();
+	nodesVisited = 0;
+	modelsFound = 0;
+	requiredFlags = required;
+	excludedFlags = excluded | Model::MODEL_HIDDEN_FROM_TREE;
+
+	Rectangle3F aabb;
+	aabb.min.Set( 0, yMin, 0 );
+	aabb.max.Set( Map::SIZE, yMax, Map::SIZE );
+
+	// Clip every ray to the tree.
+	Vector3F p0[EL_MAX_RAY_BATCH];
+	Vector3F dir[EL_MAX_RAY_BATCH];
+	Vector3F invDir[EL_MAX_RAY_BATCH];
+	float close[EL_MAX_RAY_BATCH];
+	int map[EL_MAX_RAY_BATCH];
+	int nActive = 0;
+
+	for( int i=0; i<nRays; ++i ) {
+		hits[i].model = 0;
+		hits[i].intersection.Zero();
+		hits[i].distance = FLT_MAX;
+
+		Vector3F d = _direction[i];
+		d.Normalize();
+
+		int p0Test, p1Test;
+		Vector3F in, out;
+		int test = IntersectRayAllAABB( _origin[i], d, aabb, &p0Test, &in, &p1Test, &out );
+		if ( test != grinliz::INTERSECT )
+			continue;
+
+		p0[nActive] = in;
+		dir[nActive] = d;
+		for( int k=0; k<3; ++k ) {
+			float c = d.X(k);
+			invDir[nActive].X(k) = ( c > EPSILON || c < -EPSILON ) ? 1.0f / c : 0.0f;
+		}
+		close[nActive] = FLT_MAX;
+		map[nActive] = i;
+		++nActive;
+	}
+	if ( nActive == 0 )
+		return 0;
+
+	// One walk of the tree for the whole fan: each node carries the mask of the
+	// rays that pass through its loose bounds, and a child is only opened for
+	// the rays that pass through it too. The models of a node are then tested
+	// against just those rays.
+	const bool prune = ( testType == TEST_TRI );
+	struct StackEntry {
+		const Node* node;
+		U32 rays;
+	};
+	StackEntry stack[DEPTH*4];
+	int nStack = 1;
+	stack[0].node = &nodeArr[0];
+	stack[0].rays = ( 1<<nActive ) - 1;
+
+	Vector3F nodeP0[EL_MAX_RAY_BATCH];
+	Vector3F nodeDir[EL_MAX_RAY_BATCH];
+	int nodeMap[EL_MAX_RAY_BATCH];
+	Vector3F testInt[EL_MAX_RAY_BATCH];
+	int result[EL_MAX_RAY_BATCH];
+
+	while( nStack ) {
+		--nStack;
+		const Node* node = stack[nStack].node;
+		const U32 rays = stack[nStack].rays;
+		++nodesVisited;
+
+		int nNode = 0;
+		for( int n=0; n<nActive; ++n ) {
+			if ( rays & (1<<n) ) {
+				nodeP0[nNode] = p0[n];
+				nodeDir[nNode] = dir[n];
+				nodeMap[nNode] = n;
+				++nNode;
+			}
+		}
+
+		for( Item* item=node->root; item; item=item->next ) {
+			Model* root = &item->model;
+			const int flags = root->Flags();
+			if (    ( (requiredFlags & flags) != requiredFlags)
+				 || ( (excludedFlags & flags) != 0 ) )
+			{
+				continue;
+			}
+			if ( Ignore( root, ignore ) )
+				continue;
+			++modelsFound;
+
+			if ( testType == TEST_HIT_AABB ) {
+				Rectangle3F modelAABB;
+				root->CalcHitAABB( &modelAABB );
+
+				for( int k=0; k<nNode; ++k ) {
+					const int n = nodeMap[k];
+					float t;
+					result[k] = IntersectRayAABB( p0[n], dir[n], modelAABB, &testInt[k], &t );
+					if ( result[k] == grinliz::INTERSECT && t >= 0.0f && t < close[n] ) {
+						hits[map[n]].model = root;
+						hits[map[n]].intersection = testInt[k];
+						close[n] = t;
+					}
+				}
+			}
+			else {
+				root->IntersectRays( nodeP0, nodeDir, nNode, testInt, result );
+
+				for( int k=0; k<nNode; ++k ) {
+					const int n = nodeMap[k];
+					if ( result[k] == grinliz::INTERSECT ) {
+						float t = ( p0[n] - testInt[k] ).Length();
+						if ( t < close[n] ) {
+							hits[map[n]].model = root;
+							hits[map[n]].intersection = testInt[k];
+							close[n] = t;
+						}
+					}
+				}
+			}
+		}
+
+		if ( node->child[0] ) {
+			for( int i=0; i<4; ++i ) {
+				const Node* child = node->child[i];
+				if ( !child->nModels )
+					continue;
+
+				U32 childRays = 0;
+				for( int n=0; n<nActive; ++n ) {
+					float tEnter;
+					if (    ( rays & (1<<n) )
+						 && RayEnterAABB( p0[n], invDir[n], child->looseAABB, prune ? close[n] : FLT_MAX, &tEnter ) )
+					{
+						childRays |= (1<<n);
+					}
+				}
+				if ( childRays ) {
+					GLASSERT( nStack < DEPTH*4 );
+					stack[nStack].node = child;
+					stack[nStack].rays = childRays;
+					++nStack;
+				}
+			}
+		}
+	}
+
+	int nHits = 0;
+	for( int i=0; i<nRays; ++i ) {
+		if ( hits[i].model ) {
+			hits[i].distance = ( hits[i].intersection - _origin[i] ).Length();
+			++nHits;
+		}
 	}
-	return 0;
+	return nHits;
 }
 
 
@@ -47,8 +47,17 @@ public:
 	// Called whenever a model moves. (Usually called automatically be the model.)
 	void   Update( Model* );
 
+	// When deferred, Update() only marks the model, and FlushUpdates() relinks
+	// all the marked models at once; a model that moves and turns in the same
+	// frame is relinked once. Queries flush first, so they never see a stale tree.
+	void SetDeferUpdates( bool defer );
+	void FlushUpdates();
+
 	// Returns all the models in the planes.
 	Model* Query( const grinliz::Plane* planes, int nPlanes, int requiredFlags, int excludedFlags, bool debug=false );
+	// Counters from the last Query().
+	void QueryStats( SpaceTreeStats* stats ) const;
+	void ResetUpdateStats()		{ nUpdates = 0; nRelinks = 0; }
 
 	// Returns the FIRST model impacted.
 	Model* QueryRay( const grinliz::Vector3F& origin, const grinliz::Vector3F& direction, 
@@ -56,6 +65,14 @@ public:
 					 HitTestMethod method,
 					 grinliz::Vector3F* intersection );
 
+	// Batched QueryRay, for a fan of rays that are close together. The tree is walked
+	// once, each node slab tested against every ray, and each model is tested against
+	// the rays that reach its node. Fills in a RayHit per ray; returns the number of rays that hit.
+	int QueryRays( const grinliz::Vector3F* origin, const grinliz::Vector3F* direction, int nRays,
+				   int required, int excluded, const Model** ignore,
+				   HitTestMethod method,
+				   RayHit* hits );
+
 #ifdef DEBUG
 	// Draws debugging info about the spacetree.
 	void Draw();
@@ -68,11 +85,25 @@ private:
 	void Dump( Node* node );
 #endif
 
+	// 4 boxes, stored by component so the plane tests run 4 boxes at a time.
+	struct AABB4 {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+
+		void Set( int i, const grinliz::Rectangle3F& aabb );
+	};
+	// Compares the first 'n' boxes against the planes that aren't already
+	// set in 'positive'. Fills in the result (POSITIVE, NEGATIVE, INTERSECT)
+	// and the positive plane mask for each box.
+	void ComparePlanesAABB4( const grinliz::Plane* planes, int nPlanes, U32 positive,
+							 const AABB4& boxes, int n, int* result, U32* mask, int* counter );
+
 	struct Item {
 		Model model;	// Must be first! Gets cast back to Item in destructor.
 		Node* node;
 		Item* next;		// used in the node list.
 		Item* prev;
+		bool pending;	// in the deferred update list
 	};
 
 	struct Node
@@ -85,6 +116,7 @@ private:
 		Item* root;
 		Node* parent;
 		Node* child[4];
+		AABB4 childAABB;	// looseAABB of the children
 
 #ifdef DEBUG
 		mutable int hit;
@@ -109,7 +141,9 @@ private:
 	}
 
 	void InitNode();
-	void QueryPlanesRec( const grinliz::Plane* planes, int nPlanes, int intersection, const Node* node, U32  );
+	void Relink( Item* item );
+	void QueryPlanesRec( const grinliz::Plane* planes, int nPlanes, int intersection, const Node* node, U32 positive );
+	void AddModels( const grinliz::Plane* planes, int nPlanes, U32 positive, Model** models, const AABB4& boxes, int n );
 
 	Model* modelRoot;
 	float yMin, yMax;
@@ -124,6 +158,11 @@ private:
 	int queryID;
 	bool debug;
 
+	bool deferUpdates;
+	int nUpdates;
+	int nRelinks;
+	CDynArray< Item* > pending;
+
 	grinliz::MemoryPool modelPool;
 
 	enum {
@@ -76,6 +76,7 @@ Map::Map( SpaceTree* tree )
 	: itemPool( "mapItemPool", sizeof( MapItem ), sizeof( MapItem ) * 200, false )
 {
 	memset( pyro, 0, SIZE*SIZE*sizeof(U8) );
+	nPyro = 0;
 	memset( obscured, 0, SIZE*SIZE*sizeof(U8) );
 	memset( visMap, 0, SIZE*SIZE );
 	memset( pathMap, 0, SIZE*SIZE );
@@ -147,6 +148,8 @@ Map::~Map()
 	texman->DeleteTexture( lightMapTex );
 	texman->DeleteTexture( lightFogMapTex );
 
+	chunks.Free();
+
 	Rectangle2I b( 0, 0, SIZE-1, SIZE-1 );
 	MapItem* pItem = quadTree.FindItems( b, 0, 0 );
 
@@ -170,6 +173,30 @@ void Map::SetSize( int w, int h )
 }
 
 
+void Map::BakeChunks()
+{
+	CDynArray< Model* > models;
+
+	for( int r=0; r<MapChunks::NUM_REGIONS; ++r ) {
+		if ( !chunks.IsDirty( r ) )
+			continue;
+
+		// Items are anchored by their model position, which can be a
+		// little outside of the map bounds of a rotated item.
+		Rectangle2I b = MapChunks::RegionBounds( r );
+		b.Outset( 2 );
+		b.DoIntersection( Rectangle2I( 0, 0, SIZE-1, SIZE-1 ) );
+
+		models.Clear();
+		for( MapItem* item = quadTree.FindItems( b, 0, 0 ); item; item=item->next ) {
+			if ( item->model )
+				models.Push( item->model );
+		}
+		chunks.Build( r, models.Mem(), models.Size() );
+	}
+}
+
+
 void Map::DrawSeen()
 {
 	GenerateLightMap();
@@ -608,42 +635,40 @@ void Map::DoDamage( Model* m, const MapDamageDesc& damageDesc, Rectangle2I* dBou
 
 void Map::DoSubTurn( Rectangle2I* change, float fireDamagePerSubTurn )
 {
-	for( int i=0; i<SIZE*SIZE; ++i ) {
-		if ( pyro[i] ) {
-			int y = i/SIZE;
-			int x = i-y*SIZE;
+	for( int i=NextPyro( 0 ); i >= 0; i=NextPyro( i+1 ) ) {
+		int y = i/SIZE;
+		int x = i-y*SIZE;
 
-			if ( PyroSmoke( x, y ) || PyroFlare( x, y ) ) {
-				int duration = PyroDuration( x, y );
-				if ( duration > 0 )
-					duration--;
-				SetPyro( x, y, duration, false, PyroFlare( x, y ) != 0 );
+		if ( PyroSmoke( x, y ) || PyroFlare( x, y ) ) {
+			int duration = PyroDuration( x, y );
+			if ( duration > 0 )
+				duration--;
+			SetPyro( x, y, duration, false, PyroFlare( x, y ) != 0 );
+		}
+		else if ( PyroFire( x, y ) ) {
+			// Spread? Reduce to smoke?
+			// If there is nothing left, then fire ends. (ouchie.)
+			MapItem* root = quadTree.FindItems( x, y, 0, 0 );
+			while ( root && ( root->Destroyed() || !root->def->flammable ) )	// skip things that are destroyed or inflammable
+				root = root->next;
+
+			if ( !root ) {
+				// a few sub-turns of smoke
+				SetPyro( x, y, 3+random.Rand(2), false, false );
 			}
-			else if ( PyroFire( x, y ) ) {
-				// Spread? Reduce to smoke?
-				// If there is nothing left, then fire ends. (ouchie.)
-				MapItem* root = quadTree.FindItems( x, y, 0, 0 );
-				while ( root && ( root->Destroyed() || !root->def->flammable ) )	// skip things that are destroyed or inflammable
-					root = root->next;
-
-				if ( !root ) {
-					// a few sub-turns of smoke
-					SetPyro( x, y, 3+random.Rand(2), false, false );
-				}
-				else {
-					// Will torch a building in no time. (Adjacent fires do multiple damage.)
-					MapDamageDesc d = { fireDamagePerSubTurn, 0 };
-					Vector2I explodes = { -1, -1 };
-					DoDamage( x, y, d, change, &explodes );	// FIXME BUG Burning objects don't blow up. Just needs code, and
-															// points out that the damage code probably shouldn't be in the 
-															// map class.
-
-					MapDamageDesc f = { 0, fireDamagePerSubTurn };
-					if ( x > 0 ) DoDamage( x-1, y, f, change, &explodes );
-					if ( x < SIZE-1 ) DoDamage( x+1, y, f, change, &explodes );
-					if ( y > 0 ) DoDamage( x, y-1, f, change, &explodes );
-					if ( y < SIZE-1 ) DoDamage( x, y+1, f, change, &explodes );
-				}
+			else {
+				// Will torch a building in no time. (Adjacent fires do multiple damage.)
+				MapDamageDesc d = { fireDamagePerSubTurn, 0 };
+				Vector2I explodes = { -1, -1 };
+				DoDamage( x, y, d, change, &explodes );	// FIXME BUG Burning objects don't blow up. Just needs code, and
+														// points out that the damage code probably shouldn't be in the 
+														// map class.
+
+				MapDamageDesc f = { 0, fireDamagePerSubTurn };
+				if ( x > 0 ) DoDamage( x-1, y, f, change, &explodes );
+				if ( x < SIZE-1 ) DoDamage( x+1, y, f, change, &explodes );
+				if ( y > 0 ) DoDamage( x, y-1, f, change, &explodes );
+				if ( y < SIZE-1 ) DoDamage( x, y+1, f, change, &explodes );
 			}
 		}
 	}
@@ -653,32 +678,31 @@ void Map::DoSubTurn( Rectangle2I* change, float fireDamagePerSubTurn )
 void Map::EmitParticles( U32 delta )
 {
 	ParticleSystem* system = ParticleSystem::Instance();
-	for( int i=0; i<SIZE*SIZE; ++i ) {
-		if ( pyro[i] ) {
-			int y = i/SIZE;
-			int x = i-y*SIZE;
-			Vector3F pos = { (float)x+0.5f, 0.0f, (float)y+0.5f };
-			if ( PyroFire( x, y ) ) {
-				system->EmitFlame( delta, pos );
-			}
-			else if ( PyroSmoke( x, y ) ) {
-				system->EmitSmoke( delta, pos );
-			}
-			else if ( PyroFlare( x, y ) ) {
-				if ( random.Rand( 1000 ) < delta ) {
-					static const Color4F color		= { 1, 0, 0, 1 };
-					static const Color4F colorVec	= { 0, 0, 0, -1.f };
-					static const Vector3F velocity	= { 0.0f, 0.5f, 0.0f };
-
-					system->EmitPoint(	5,
-										ParticleSystem::PARTICLE_RAY,
-										color,
-										colorVec,
-										pos,
-										0.01f,
-										velocity,
-										0.3f );
-				}
+	for( int i=NextPyro( 0 ); i >= 0; i=NextPyro( i+1 ) ) {
+		int y = i/SIZE;
+		int x = i-y*SIZE;
+		Vector3F pos = { (float)x+0.5f, 0.0f, (float)y+0.5f };
+		if ( PyroFire( x, y ) ) {
+			system->EmitFlame( delta, pos );
+		}
+		else if ( PyroSmoke( x, y ) ) {
+			system->EmitSmoke( delta, pos );
+		}
+		else if ( PyroFlare( x, y ) ) {
+			if ( random.Rand( 1000 ) < delta ) {
+				static const Color4F color		= { 1, 0, 0, 1 };
+				static const Color4F colorVec	= { 0, 0, 0, -1.f };
+				static const Vector3F velocity	= { 0.0f, 0.5f, 0.0f };
+
+				system->EmitPoint(	5,
+									ParticleSystem::PARTICLE_RAY,
+									color,
+									colorVec,
+									pos,
+									0.01f,
+									velocity,
+									0.3f,
+									ParticleSystem::PRIORITY_LOW );
 			}
 		}
 	}
@@ -720,7 +744,54 @@ void Map::SetPyro( int x, int y, int duration, bool fire, bool flare )
 		p |= 0x40;
 	}
 	p += Clamp( duration, 0, 0x3f );
-	pyro[y*SIZE+x] = p;
+
+	const int i = y*SIZE+x;
+	if ( p && !pyro[i] ) {
+		pyroActive.Set( x, y );
+		++nPyro;
+	}
+	else if ( !p && pyro[i] ) {
+		pyroActive.Clear( x, y );
+		--nPyro;
+	}
+	pyro[i] = p;
+}
+
+
+int Map::NextPyro( int i )
+{
+	// The bits are in row order, 32 cells to a word, so a word can
+	// be skipped at a time.
+	while ( i < SIZE*SIZE ) {
+		int y = i / SIZE;
+		int x = i - y*SIZE;
+		U32 word = pyroActive.Access32( x, y, 0 ) >> ( x & 31 );
+		if ( word ) {
+			while ( !(word & 1) ) {
+				word >>= 1;
+				++i;
+			}
+			GLASSERT( pyro[i] );
+			return i;
+		}
+		i = ( i | 31 ) + 1;
+	}
+	return -1;
+}
+
+
+U64 Map::StateHash( U64 h ) const
+{
+	for( int node=0; node<QuadTree::NUM_QUAD_NODES; ++node ) {
+		for( const MapItem* item = quadTree.NodeItems( node ); item; item=item->nextQuad ) {
+			if ( item->flags & MapItem::MI_NOT_IN_DATABASE )
+				continue;
+			U16 state[2] = { item->hp, item->open };
+			h = Random::Hash64( state, sizeof(state), h );
+		}
+	}
+	h = Random::Hash64( pyro, sizeof(pyro), h );
+	return h;
 }
 
 
@@ -923,7 +994,9 @@ Map::MapItem* Map::AddItem( int x, int y, int rotation, const MapItemDef* def, i
 			model->SetFlag( Model::MODEL_METADATA );
 		model->SetPos( modelPos );
 		model->SetRotation( item->ModelRot() );
+		model->SetUserData( item );
 		item->model = model;
+		chunks.Invalidate( mapBounds );
 	}
 
 	// Patch the world states:
@@ -944,8 +1017,10 @@ void Map::DeleteItem( MapItem* item )
 	if ( item->amountObscuring ) {
 		ChangeObscured( mapBounds, -((int)item->amountObscuring) );
 	}
-	if ( item->model )
+	if ( item->model ) {
 		tree->FreeModel( item->model );
+		chunks.Invalidate( mapBounds );
+	}
 
 	itemPool.Free( item );
 	ResetPath();
@@ -990,19 +1065,17 @@ void Map::Save( XMLPrinter* printer )
 	printer->CloseElement();	// Images
 
 	printer->OpenElement( "PyroGroup" );
-	for( int i=0; i<SIZE*SIZE; ++i ) {
-		if ( pyro[i] ) {
-			int y = i / SIZE;
-			int x = i - SIZE*y;
-
-			printer->OpenElement( "Pyro" );
-			printer->PushAttribute( "x", x );
-			printer->PushAttribute( "y", y );
-			printer->PushAttribute( "fire", PyroFire( x, y ) ? 1 : 0 );
-			printer->PushAttribute( "flare", PyroFlare( x, y ) ? 1 : 0 );
-			printer->PushAttribute( "duration", PyroDuration( x, y ) );
-			printer->CloseElement();	// Pyro
-		}
+	for( int i=NextPyro( 0 ); i >= 0; i=NextPyro( i+1 ) ) {
+		int y = i / SIZE;
+		int x = i - SIZE*y;
+
+		printer->OpenElement( "Pyro" );
+		printer->PushAttribute( "x", x );
+		printer->PushAttribute( "y", y );
+		printer->PushAttribute( "fire", PyroFire( x, y ) ? 1 : 0 );
+		printer->PushAttribute( "flare", PyroFlare( x, y ) ? 1 : 0 );
+		printer->PushAttribute( "duration", PyroDuration( x, y ) );
+		printer->CloseElement();	// Pyro
 	}
 	printer->CloseElement();	// PyroGroup
 	printer->CloseElement();	// Map
@@ -1093,17 +1166,17 @@ void Map::Load( const XMLElement* mapElement )
 	}
 
 	// Remove things that can't burn. (We don't want to generate unnecessary particles.)
-	for( int y=0; y<SIZE; ++y ) {
-		for( int x=0; x<SIZE; ++x ) {
-			if ( PyroFire( x, y ) ) {
-				MapItem* root = quadTree.FindItems( x, y, 0, 0 );
-				while ( root && ( root->Destroyed() || !root->def->flammable ) )	// skip things that are destroyed or inflammable
-					root = root->next;
-
-				if ( !root ) {
-					// a few sub-turns of smoke
-					SetPyro( x, y, 0, false, false );
-				}
+	for( int i=NextPyro( 0 ); i >= 0; i=NextPyro( i+1 ) ) {
+		int y = i / SIZE;
+		int x = i - SIZE*y;
+		if ( PyroFire( x, y ) ) {
+			MapItem* root = quadTree.FindItems( x, y, 0, 0 );
+			while ( root && ( root->Destroyed() || !root->def->flammable ) )	// skip things that are destroyed or inflammable
+				root = root->next;
+
+			if ( !root ) {
+				// a few sub-turns of smoke
+				SetPyro( x, y, 0, false, false );
 			}
 		}
 	}
@@ -1201,9 +1274,11 @@ bool Map::ProcessDoors( const grinliz::Vector2I* openers, int nOpeners )
 					model->SetFlag( Model::MODEL_OWNED_BY_MAP );
 					model->SetPos( pos );
 					model->SetRotation( rot );
+					model->SetUserData( item );
 					item->model = model;
 
 					Rectangle2I mapBounds = item->MapBounds();
+					chunks.Invalidate( mapBounds );
 
 					ResetPath();
 					ClearVisPathMap( mapBounds );
@@ -1758,7 +1833,6 @@ void Map::SetLanderFlight( float normal )
 Map::QuadTree::QuadTree()
 {
 	Clear();
-	filterModel = 0;
 
 	int base = 0;
 	for( int i=0; i<QUAD_DEPTH+1; ++i ) {
@@ -1841,26 +1915,15 @@ Map::MapItem* Map::QuadTree::FindItems( const Rectangle2I& bounds, int required,
 			for( int i=x0; i<=x1; ++i ) {
 				MapItem* pItem = *(tree + depthBase[depth] + NodeOffset( i, j, depth ) );
 
-				if ( filterModel ) {
-					while( pItem ) {
-						if ( pItem->model == filterModel ) {
-							pItem->next = 0;
-							return pItem;
-						}
-						pItem = pItem->nextQuad;
-					}
-				}
-				else {
-					while( pItem ) { 
-						if (    ( ( pItem->flags & required) == required )
-							 && ( ( pItem->flags & excluded ) == 0 )
-							 && pItem->mapBounds8.Intersect( bounds8 ) )
-						{
-							pItem->next = root;
-							root = pItem;
-						}
-						pItem = pItem->nextQuad;
+				while( pItem ) { 
+					if (    ( ( pItem->flags & required) == required )
+						 && ( ( pItem->flags & excluded ) == 0 )
+						 && pItem->mapBounds8.Intersect( bounds8 ) )
+					{
+						pItem->next = root;
+						root = pItem;
 					}
+					pItem = pItem->nextQuad;
 				}
 			}
 		}
@@ -1872,25 +1935,12 @@ Map::MapItem* Map::QuadTree::FindItems( const Rectangle2I& bounds, int required,
 Map::MapItem* Map::QuadTree::FindItem( const Model* model )
 {
 	GLRELASSERT( model->IsFlagSet( Model::MODEL_OWNED_BY_MAP ) );
-	Rectangle2I b;
 
-	// May or may not have 'mapBoundsCache' when called.
-//	if ( model->mapBoundsCache.min.x >= 0 ) {
-//		b = model->mapBoundsCache;
-//	}
-//	else {
-		// Need a little space around the coordinates to account
-		// for object rotation.
-		b.min.x = Clamp( (int)model->X()-2, 0, SIZE-1 );
-		b.min.y = Clamp( (int)model->Z()-2, 0, SIZE-1 );
-		b.max.x = Clamp( (int)model->X()+2, 0, SIZE-1 );
-		b.max.y = Clamp( (int)model->Z()+2, 0, SIZE-1 );
-//	}
-	filterModel = model;
-	MapItem* root = FindItems( b, 0, 0 );
-	filterModel = 0;
-	GLRELASSERT( root && root->next == 0 );
-	return root;
+	// The model points back to its item, set when the model was allocated.
+	MapItem* item = (MapItem*) model->UserData();
+	GLRELASSERT( item && item->model == model );
+	item->next = 0;
+	return item;
 }
 
 
@@ -39,6 +39,8 @@
 #include "surface.h"
 #include "texture.h"
 #include "gpustatemanager.h"
+#include "uirendering.h"
+#include "mapchunks.h"
 
 class Model;
 class ModelResource;
@@ -259,6 +261,11 @@ public:
 	void DrawPath( int mode );		//< debugging
 	void DrawOverlay( int layer );		//< draw the "where can I walk" alpha overlay. Set up by ShowNearPath().
 
+	// Rebuilds the dirty regions of the baked map items. Call once/frame before drawing.
+	void BakeChunks();
+	MapChunks* Chunks()				{ return &chunks; }
+	void DeviceLoss()				{ chunks.DeviceLoss(); }
+
 	// Do damage to a singe map object.
 	void DoDamage( Model* m, const MapDamageDesc& damage, grinliz::Rectangle2I* destroyedBounds, grinliz::Vector2I* explosion  );
 	// Do damage to an entire map tile.
@@ -275,6 +282,8 @@ public:
 	bool Obscured( int x, int y ) const		{ return ( obscured[y*SIZE+x] || PyroSmoke( x, y ) ); }
 	int  Flared( int x, int y ) const		{ return PyroFlare( x, y ); }
 	void EmitParticles( U32 deltaTime );
+	// Number of cells with fire, smoke, or a flare.
+	int NumPyro() const						{ return nPyro; }
 
 	// Set the path block (does nothing if they are equal.)
 	// Generally called by MakePathBlockCurrent
@@ -337,6 +346,14 @@ public:
 	virtual void BeginRenderState( const void* renderState );
 	virtual void BeginTexture( const void* textureHandle );
 	virtual void Render( const void* renderState, const void* textureHandle, int nIndex, const uint16_t* index, int nVertex, const gamui::Gamui::Vertex* vertex );
+	virtual void* CreateBuffers()					{ return UIBuffers::Create(); }
+	virtual void DestroyBuffers( void* buffers )	{ UIBuffers::Destroy( buffers ); }
+	virtual void UploadBuffers( void* buffers, const gamui::Gamui::Dirty& dirty, const uint16_t* index, int nIndex, const gamui::Gamui::Vertex* vertex, int nVertex ) {
+		((UIBuffers*)buffers)->Upload( dirty, index, nIndex, vertex, nVertex );
+	}
+	virtual void RenderBuffers( void* buffers, const void* renderState, const void* textureHandle, int indexStart, int nIndex ) {
+		((UIBuffers*)buffers)->Draw( &gamuiShader, indexStart, nIndex );
+	}
 
 	Texture* BackgroundTexture()	{ return backgroundTexture; }
 	Texture* LightMapTexture()		{ return lightMapTex; }
@@ -354,6 +371,8 @@ public:
 
 	bool ProcessDoors( const grinliz::Vector2I* openers, int nOpeners );
 	void SetPyro( int x, int y, int duration, bool fire, bool flare );
+	// Hash of the state that changes in a battle: item damage, doors, fire and smoke.
+	U64 StateHash( U64 h ) const;
 
 	void Save( tinyxml2::XMLPrinter* );
 	void Load( const tinyxml2::XMLElement* mapNode );
@@ -404,6 +423,9 @@ protected:
 			return FindItems( b, required, excluded ); 
 		}
 		MapItem* FindItem( const Model* model );
+		// The items stored at a node, linked by 'nextQuad'. Read only;
+		// unlike FindItems() it doesn't write the 'next' links.
+		const MapItem* NodeItems( int node ) const			{ GLASSERT( node >= 0 && node < NUM_QUAD_NODES ); return tree[node]; }
 
 		void UnlinkItem( MapItem* item );
 
@@ -433,11 +455,11 @@ protected:
 		int			depthUse[QUAD_DEPTH];
 		int			depthBase[QUAD_DEPTH+1];
 		MapItem*	tree[NUM_QUAD_NODES];
-		const Model* filterModel;
 	};
 
 	SpaceTree*	tree;
 	QuadTree	quadTree;
+	MapChunks	chunks;
 
 	CDynArray< grinliz::Vector2I >				guardPos;
 	CDynArray< grinliz::Vector2I >				scoutPos;
@@ -525,6 +547,8 @@ private:
 	int PyroFlare( int x, int y ) const		{ return pyro[y*SIZE+x] & 0x40; }
 	bool PyroSmoke( int x, int y ) const	{ int p = pyro[y*SIZE+x]; return ((p & 0xC0) == 0) && (p>0); }
 	int PyroDuration( int x, int y ) const	{ return pyro[y*SIZE+x] & 0x3F; }
+	// First cell (y*SIZE+x) at or after 'i' with pyro set, or -1.
+	int NextPyro( int i );
 
 	void ChangeObscured( const grinliz::Rectangle2I& bounds, int delta );
 
@@ -548,6 +572,10 @@ private:
 	// bits 0-6:	sub-turns remaining (0-127)		(0x7F)
 	// bit    7:	set: fire, clear: smoke			(0x80)
 	U8 pyro[SIZE*SIZE];
+	// Set where pyro is non-zero, so fire, smoke, and flares cost time
+	// per burning cell rather than per map cell.
+	grinliz::BitArray<SIZE, SIZE, 1>			pyroActive;
+	int											nPyro;
 	// This is a count. As an object (that obscures) is added, this gets added too.
 	// Subtracted back out when the object is removed.
 	U8 obscured[SIZE*SIZE];
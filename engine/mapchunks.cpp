@@ -0,0 +1,309 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapchunks.h"
+#include "model.h"
+#include "texture.h"
+#include "renderqueue.h"
+#include "../grinliz/glperformance.h"
+
+using namespace grinliz;
+
+
+MapChunks::MapChunks()
+{
+	for( int i=0; i<NUM_REGIONS; ++i )
+		dirty[i] = true;
+}
+
+
+void MapChunks::Free()
+{
+	for( int i=0; i<NUM_REGIONS; ++i ) {
+		FreeRegion( i );
+		dirty[i] = true;
+	}
+}
+
+
+void MapChunks::DeviceLoss()
+{
+	for( int r=0; r<NUM_REGIONS; ++r ) {
+		CDynArray<Chunk*>& arr = chunks[r];
+		for( int i=0; i<arr.Size(); ++i ) {
+			arr[i]->vertexBuffer.Clear();
+			arr[i]->indexBuffer.Clear();
+		}
+	}
+	InvalidateAll();
+}
+
+
+void MapChunks::FreeRegion( int region )
+{
+	CDynArray<Chunk*>& arr = chunks[region];
+	for( int i=0; i<arr.Size(); ++i ) {
+		arr[i]->vertexBuffer.Destroy();
+		arr[i]->indexBuffer.Destroy();
+		delete arr[i];
+	}
+	arr.Clear();
+}
+
+
+int MapChunks::NumChunks() const
+{
+	int n = 0;
+	for( int i=0; i<NUM_REGIONS; ++i )
+		n += chunks[i].Size();
+	return n;
+}
+
+
+void MapChunks::Invalidate( const Rectangle2I& _bounds )
+{
+	// A model is anchored at its position, which can sit on the edge of its
+	// item's bounds; pad by a tile.
+	Rectangle2I bounds = _bounds;
+	bounds.Outset( 1 );
+
+	int x0 = Clamp( bounds.min.x / REGION_SIZE, 0, REGIONS-1 );
+	int y0 = Clamp( bounds.min.y / REGION_SIZE, 0, REGIONS-1 );
+	int x1 = Clamp( bounds.max.x / REGION_SIZE, 0, REGIONS-1 );
+	int y1 = Clamp( bounds.max.y / REGION_SIZE, 0, REGIONS-1 );
+
+	for( int j=y0; j<=y1; ++j ) {
+		for( int i=x0; i<=x1; ++i ) {
+			dirty[j*REGIONS+i] = true;
+		}
+	}
+}
+
+
+void MapChunks::InvalidateAll()
+{
+	for( int i=0; i<NUM_REGIONS; ++i )
+		dirty[i] = true;
+}
+
+
+/*static*/ Rectangle2I MapChunks::RegionBounds( int region )
+{
+	GLASSERT( region >= 0 && region < NUM_REGIONS );
+	int x = ( region % REGIONS ) * REGION_SIZE;
+	int y = ( region / REGIONS ) * REGION_SIZE;
+	Rectangle2I b( x, y, x+REGION_SIZE-1, y+REGION_SIZE-1 );
+	return b;
+}
+
+
+/*static*/ int MapChunks::RegionOf( const Model* model )
+{
+	int x = Clamp( (int)model->X() / REGION_SIZE, 0, REGIONS-1 );
+	int y = Clamp( (int)model->Z() / REGION_SIZE, 0, REGIONS-1 );
+	return y*REGIONS + x;
+}
+
+
+MapChunks::Chunk* MapChunks::FindChunk( int region, Texture* texture, bool shadow, int nVertex )
+{
+	CDynArray<Chunk*>& arr = chunks[region];
+	for( int i=0; i<arr.Size(); ++i ) {
+		Chunk* c = arr[i];
+		if (    c->texture == texture 
+			 && c->shadow == shadow 
+			 && c->vertex.Size() + nVertex <= MAX_VERTEX ) 
+		{
+			return c;
+		}
+	}
+	Chunk* c = new Chunk();
+	c->texture = texture;
+	c->shadow = shadow;
+	c->bounds.Set( 0, 0, 0, 0, 0, 0 );
+	arr.Push( c );
+	return c;
+}
+
+
+void MapChunks::Build( int region, Model* const* models, int nModels )
+{
+	GRINLIZ_PERFTRACK
+	GLASSERT( region >= 0 && region < NUM_REGIONS );
+
+	FreeRegion( region );
+	dirty[region] = false;
+
+	for( int m=0; m<nModels; ++m ) {
+		Model* model = models[m];
+		if ( RegionOf( model ) != region )
+			continue;
+		if ( !model->Cacheable() ) {
+			model->ClearFlag( Model::MODEL_BAKED );
+			continue;
+		}
+		model->SetFlag( Model::MODEL_BAKED );
+
+		const ModelResource* res = model->GetResource();
+		const Matrix4& xform = model->XForm();
+		// Rotation only, for the normals.
+		Matrix4 rot = xform;
+		rot.SetTranslation( 0, 0, 0 );
+		const bool shadow = !model->IsFlagSet( Model::MODEL_NO_SHADOW );
+
+		for( U32 a=0; a<res->header.nGroups; ++a ) {
+			const ModelAtom& atom = res->atom[a];
+			Chunk* c = FindChunk( region, atom.texture, shadow, atom.nVertex );
+
+			const int base = c->vertex.Size();
+			Vertex* v = c->vertex.PushArr( atom.nVertex );
+			for( U32 i=0; i<atom.nVertex; ++i ) {
+				v[i].pos = xform * atom.vertex[i].pos;
+				v[i].normal = rot * atom.vertex[i].normal;
+				v[i].tex = atom.vertex[i].tex;
+			}
+
+			Range* r = c->range.Push();
+			r->model = model;
+			r->start = c->index.Size();
+			r->count = atom.nIndex;
+
+			U16* index = c->index.PushArr( atom.nIndex );
+			for( U32 i=0; i<atom.nIndex; ++i ) {
+				index[i] = (U16)( base + atom.index[i] );
+			}
+
+			if ( c->range.Size() == 1 )
+				c->bounds = model->AABB();
+			else
+				c->bounds.DoUnion( model->AABB() );
+		}
+	}
+
+	if ( GPUShader::SupportsVBOs() ) {
+		CDynArray<Chunk*>& arr = chunks[region];
+		for( int i=0; i<arr.Size(); ++i ) {
+			Chunk* c = arr[i];
+			c->vertexBuffer = GPUVertexBuffer::Create( c->vertex.Mem(), c->vertex.Size() );
+			c->indexBuffer  = GPUIndexBuffer::Create( c->index.Mem(), c->index.Size() );
+		}
+	}
+}
+
+
+void MapChunks::Draw( const Plane* planes, int nPlanes, GPUShader* opaque, GPUShader* transparent, int mode )
+{
+	GRINLIZ_PERFTRACK
+
+	const bool planar = ( mode & RenderQueue::MODE_PLANAR_SHADOW ) != 0;
+	const int nPass = planar ? 1 : 2;
+
+	// The opaque textures first, then the ones that blend.
+	for( int pass=0; pass<nPass; ++pass ) {
+		for( int r=0; r<NUM_REGIONS; ++r ) {
+			GLASSERT( !dirty[r] );
+			CDynArray<Chunk*>& arr = chunks[r];
+
+			for( int i=0; i<arr.Size(); ++i ) {
+				Chunk* c = arr[i];
+				GPUShader* shader = opaque;
+
+				if ( planar ) {
+					if ( !c->shadow )
+						continue;
+				}
+				else {
+					const bool alpha = c->texture->Alpha();
+					if ( alpha != ( pass == 1 ) )
+						continue;
+					if ( alpha )
+						shader = transparent;
+				}
+
+				bool culled = false;
+				for( int k=0; k<nPlanes; ++k ) {
+					if ( ComparePlaneAABB( planes[k], c->bounds ) == grinliz::NEGATIVE ) {
+						culled = true;
+						break;
+					}
+				}
+				if ( !culled ) {
+					DrawChunk( c, shader, mode );
+				}
+			}
+		}
+	}
+}
+
+
+void MapChunks::DrawChunk( Chunk* c, GPUShader* shader, int mode )
+{
+	// Hidden items are left out of the index list; usually either all
+	// or none of a chunk is hidden.
+	int nVisible = 0;
+	for( int i=0; i<c->range.Size(); ++i ) {
+		if ( !c->range[i].model->IsFlagSet( Model::MODEL_INVISIBLE ) )
+			++nVisible;
+	}
+	if ( nVisible == 0 )
+		return;
+
+	const U16* index = 0;
+	int nIndex = c->index.Size();
+
+	if ( nVisible < c->range.Size() ) {
+		visibleIndex.Clear();
+		for( int i=0; i<c->range.Size(); ++i ) {
+			const Range& r = c->range[i];
+			if ( !r.model->IsFlagSet( Model::MODEL_INVISIBLE ) ) {
+				memcpy( visibleIndex.PushArr( r.count ), &c->index[r.start], r.count*sizeof(U16) );
+			}
+		}
+		index = visibleIndex.Mem();
+		nIndex = visibleIndex.Size();
+	}
+
+	// The vertices are already in world space: the model matrix, and the
+	// texture matrices that the render queue multiplies by it, are identity.
+	GPUStream stream( c->vertex.Mem() );
+	if ( mode & RenderQueue::MODE_PLANAR_SHADOW ) {
+		stream.Clear();
+		stream.stride = sizeof( Vertex );
+		stream.nPos = 3;
+		stream.posOffset = Vertex::POS_OFFSET;
+		stream.nTexture0 = 3;
+		stream.texture0Offset = Vertex::POS_OFFSET;
+		stream.nTexture1 = 3;
+		stream.texture1Offset = Vertex::POS_OFFSET;
+	}
+	else {
+		shader->SetTexture0( c->texture );
+		if ( shader->HasTexture1() ) {
+			stream.texture1Offset = Vertex::POS_OFFSET;
+			stream.nTexture1 = 3;
+		}
+	}
+
+	if ( c->vertexBuffer.IsValid() && c->indexBuffer.IsValid() ) {
+		if ( index )
+			shader->SetStream( stream, c->vertexBuffer, nIndex, index );
+		else
+			shader->SetStream( stream, c->vertexBuffer, nIndex, c->indexBuffer );
+	}
+	else {
+		shader->SetStream( stream, c->vertex.Mem(), nIndex, index ? index : c->index.Mem() );
+	}
+	shader->Draw();
+}
@@ -0,0 +1,112 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFOATTACK_MAP_CHUNKS_INCLUDED
+#define UFOATTACK_MAP_CHUNKS_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glrectangle.h"
+#include "../grinliz/glgeometry.h"
+#include "enginelimits.h"
+#include "vertex.h"
+#include "gpustatemanager.h"
+#include "ufoutil.h"
+
+class Model;
+class Texture;
+
+
+/*
+	Baked map geometry. The map items (walls, floors, furniture) are
+	transformed to world space and merged into one vertex and index buffer
+	per region and texture. A region then draws in a few calls, instead of a
+	matrix push and a draw per item per atom.
+
+	The map invalidates a region when an item in it is added, deleted,
+	destroyed, or a door in it opens or closes. Map::BakeChunks() rebuilds the
+	invalid regions before the frame is drawn. Baked models are flagged
+	MODEL_BAKED and aren't queued; they stay in the SpaceTree for hit testing.
+	Items hidden by the fog of war (MODEL_INVISIBLE) are left out of the draw
+	without a rebuild.
+*/
+class MapChunks
+{
+public:
+	MapChunks();
+	~MapChunks()	{ Free(); }
+
+	enum {
+		REGION_SIZE	= 16,
+		REGIONS		= EL_MAP_SIZE / REGION_SIZE,
+		NUM_REGIONS	= REGIONS*REGIONS,
+		MAX_VERTEX	= 0xffff		// indices are U16
+	};
+
+	// Marks the regions touched by 'bounds' (map coordinates) for a rebuild.
+	void Invalidate( const grinliz::Rectangle2I& bounds );
+	void InvalidateAll();
+	bool IsDirty( int region ) const				{ GLASSERT( region >= 0 && region < NUM_REGIONS ); return dirty[region]; }
+	// Map coordinates of a region.
+	static grinliz::Rectangle2I RegionBounds( int region );
+
+	// Rebuilds a region. 'models' are the candidates; the ones anchored in this
+	// region that are Model::Cacheable() are merged and flagged MODEL_BAKED, and
+	// the others have the flag cleared.
+	void Build( int region, Model* const* models, int nModels );
+
+	// Draws the chunks that aren't culled by the planes: the opaque textures
+	// with 'opaque', then the alpha textures with 'transparent'. With
+	// RenderQueue::MODE_PLANAR_SHADOW, 'opaque' is the shadow shader and only
+	// the chunks that cast shadows are drawn.
+	void Draw( const grinliz::Plane* planes, int nPlanes, GPUShader* opaque, GPUShader* transparent, int mode );
+
+	void Free();
+	// The GL context was lost, and the buffers with it: forgets them (they
+	// can't be deleted) and marks every region for a rebuild.
+	void DeviceLoss();
+
+	int NumChunks() const;
+
+private:
+	// The indices of one model atom in a chunk, so hidden items can be left out.
+	struct Range {
+		const Model*	model;
+		int				start;
+		int				count;
+	};
+
+	struct Chunk {
+		Texture*				texture;
+		bool					shadow;
+		grinliz::Rectangle3F	bounds;
+		CDynArray<Vertex>		vertex;
+		CDynArray<U16>			index;
+		CDynArray<Range>		range;
+		GPUVertexBuffer			vertexBuffer;
+		GPUIndexBuffer			indexBuffer;
+	};
+
+	static int RegionOf( const Model* model );
+	Chunk* FindChunk( int region, Texture* texture, bool shadow, int nVertex );
+	void FreeRegion( int region );
+	void DrawChunk( Chunk* chunk, GPUShader* shader, int mode );
+
+	bool				dirty[NUM_REGIONS];
+	CDynArray<Chunk*>	chunks[NUM_REGIONS];
+	CDynArray<U16>		visibleIndex;		// scratch, for chunks that are partly hidden
+};
+
+
+#endif // UFOATTACK_MAP_CHUNKS_INCLUDED
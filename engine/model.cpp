@@ -36,6 +36,7 @@ void ModelResource::Free()
 	}
 	delete [] allVertex;
 	delete [] allIndex;
+	bvh.Free();
 }
 
 
@@ -53,35 +54,17 @@ int ModelResource::Intersect(	const grinliz::Vector3F& point,
 								const grinliz::Vector3F& dir,
 								grinliz::Vector3F* intersect ) const
 {
-	float t;
-	int result = IntersectRayAABB( point, dir, header.bounds, intersect, &t );
-	if ( result == grinliz::INTERSECT || result == grinliz::INSIDE ) {
-		float close2 = FLT_MAX;
-		Vector3F test;
-
-		for( unsigned i=0; i<header.nGroups; ++i ) {
-			for( unsigned j=0; j<atom[i].nIndex; j+=3 ) {
-				int r = IntersectRayTri( point, dir, 
-										 atom[i].vertex[ atom[i].index[j+0] ].pos,
-										 atom[i].vertex[ atom[i].index[j+1] ].pos,
-										 atom[i].vertex[ atom[i].index[j+2] ].pos,
-										 &test );
-				if ( r == grinliz::INTERSECT ) {
-					float c2 =  (point.x-test.x)*(point.x-test.x) +
-								(point.y-test.y)*(point.y-test.y) +
-								(point.z-test.z)*(point.z-test.z);
-					if ( c2 < close2 ) {
-						close2 = c2;
-						*intersect = test;
-					}
-				}
-			}
-		}
-		if ( close2 < FLT_MAX ) {
-			return grinliz::INTERSECT;
-		}
-	}
-	return grinliz::REJECT;
+	return bvh.Intersect( point, dir, intersect );
+}
+
+
+void ModelResource::IntersectRays(	const grinliz::Vector3F* point,
+									const grinliz::Vector3F* dir,
+									int nRays,
+									grinliz::Vector3F* intersect,
+									int* result ) const
+{
+	bvh.IntersectRays( point, dir, nRays, intersect, result );
 }
 
 
@@ -138,6 +121,7 @@ void ModelLoader::Load( const gamedb::Item* item, ModelResource* res )
 		iOffset += res->atom[i].nIndex;
 		vOffset += res->atom[i].nVertex;
 	}
+	res->bvh.Build( res );
 }
 
 
@@ -162,6 +146,7 @@ void Model::Init( const ModelResource* resource, SpaceTree* tree )
 	this->tree = tree;
 	this->setTexture = 0;
 	this->auxTexture = 0;
+	this->userData = 0;
 
 	pos.Set( 0, 0, 0 );
 	rot[0] = rot[1] = rot[2] = 0.0f;
@@ -397,24 +382,101 @@ const grinliz::Rectangle3F& Model::AABB() const
 const grinliz::Matrix4& Model::XForm() const
 {
 	if ( !xformValid ) {
-		Matrix4 t;
-		t.SetTranslation( pos );
+		const Model* self = this;
+		UpdateXForms( &self, 1 );
+	}
+	return _xform;
+}
 
-		Matrix4 r;
-		if ( rot[1] != 0.0f ) 
-			r.ConcatRotation( rot[1], 1 );
-		if ( rot[2] != 0.0f )
-			r.ConcatRotation( rot[2], 2 );
-		if ( rot[0] != 0.0f )
-			r.ConcatRotation( rot[0], 0 );
 
-		_xform = t*r;
+void Model::CalcXForm() const
+{
+	Matrix4 t;
+	t.SetTranslation( pos );
+
+	Matrix4 r;
+	if ( rot[1] != 0.0f ) 
+		r.ConcatRotation( rot[1], 1 );
+	if ( rot[2] != 0.0f )
+		r.ConcatRotation( rot[2], 2 );
+	if ( rot[0] != 0.0f )
+		r.ConcatRotation( rot[0], 0 );
 
-		// compute the AABB.
-		MultMatrix4( _xform, resource->header.bounds, &aabb );
-		xformValid = true;
+	_xform = t*r;
+
+	// compute the AABB.
+	MultMatrix4( _xform, resource->header.bounds, &aabb );
+	xformValid = true;
+}
+
+
+/*static*/ void Model::UpdateXForms( const Model* const* models, int n )
+{
+	// The Y-only models are gathered by component, a block at a time,
+	// and the matrices and the AABBs are written in separate passes.
+	enum { BLOCK = 64 };
+	const Model* m[BLOCK];
+	float px[BLOCK], py[BLOCK], pz[BLOCK];
+	float s[BLOCK], c[BLOCK];
+
+	for( int base=0; base<n; base+=BLOCK ) {
+		const int end = Min( n, base+BLOCK );
+		int count = 0;
+
+		for( int i=base; i<end; ++i ) {
+			const Model* model = models[i];
+			if ( model->xformValid )
+				continue;
+			if ( model->rot[0] != 0.0f || model->rot[2] != 0.0f ) {
+				model->CalcXForm();
+				continue;
+			}
+			m[count] = model;
+			px[count] = model->pos.x;
+			py[count] = model->pos.y;
+			pz[count] = model->pos.z;
+
+			// SetRotation keeps the angle in [0,360)
+			const float r = model->rot[1];
+			if ( r == 0.0f )			{ s[count] = 0.0f;	c[count] = 1.0f; }
+			else if ( r == 90.0f )		{ s[count] = 1.0f;	c[count] = 0.0f; }
+			else if ( r == 180.0f )		{ s[count] = 0.0f;	c[count] = -1.0f; }
+			else if ( r == 270.0f )		{ s[count] = -1.0f;	c[count] = 0.0f; }
+			else						SinCosDegree( r, &s[count], &c[count] );
+			++count;
+		}
+
+		// Translation * Y rotation, as the general case computes it.
+		for( int k=0; k<count; ++k ) {
+			float* x = m[k]->_xform.x;
+			x[0] = c[k];	x[1] = 0.0f;	x[2] = -s[k];	x[3] = 0.0f;
+			x[4] = 0.0f;	x[5] = 1.0f;	x[6] = 0.0f;	x[7] = 0.0f;
+			x[8] = s[k];	x[9] = 0.0f;	x[10] = c[k];	x[11] = 0.0f;
+			x[12] = px[k];	x[13] = py[k];	x[14] = pz[k];	x[15] = 1.0f;
+		}
+
+		// A turn about Y moves the center of the bounds, and mixes the x and z
+		// extents by |cos| and |sin|. Quarter turns just swap them.
+		for( int k=0; k<count; ++k ) {
+			const Rectangle3F& b = m[k]->resource->header.bounds;
+			const float cx = ( b.min.x + b.max.x ) * 0.5f;
+			const float cz = ( b.min.z + b.max.z ) * 0.5f;
+			const float ex = ( b.max.x - b.min.x ) * 0.5f;
+			const float ez = ( b.max.z - b.min.z ) * 0.5f;
+			const float ac = fabsf( c[k] );
+			const float as = fabsf( s[k] );
+
+			const float wx = px[k] + c[k]*cx + s[k]*cz;
+			const float wz = pz[k] - s[k]*cx + c[k]*cz;
+			const float hx = ac*ex + as*ez;
+			const float hz = as*ex + ac*ez;
+
+			Rectangle3F& aabb = m[k]->aabb;
+			aabb.min.Set( wx-hx, py[k]+b.min.y, wz-hz );
+			aabb.max.Set( wx+hx, py[k]+b.max.y, wz+hz );
+			m[k]->xformValid = true;
+		}
 	}
-	return _xform;
 }
 
 
@@ -483,6 +545,63 @@ int Model::IntersectRay(	const Vector3F& _origin,
 }
 
 
+void Model::IntersectRays(	const Vector3F* _origin,
+							const Vector3F* _dir,
+							int nRays,
+							Vector3F* intersect,
+							int* result ) const
+{
+	GLASSERT( nRays > 0 && nRays <= EL_MAX_RAY_BATCH );
+
+	Vector3F objOrigin[EL_MAX_RAY_BATCH];
+	Vector3F objDir[EL_MAX_RAY_BATCH];
+	Vector3F objIntersect[EL_MAX_RAY_BATCH];
+	int		 objResult[EL_MAX_RAY_BATCH];
+	int		 map[EL_MAX_RAY_BATCH];
+	int		 nObj = 0;
+
+	const Rectangle3F& aabb = AABB();
+	for( int k=0; k<nRays; ++k ) {
+		result[k] = grinliz::REJECT;
+
+		Vector3F dv;
+		float dt;
+		int initTest = IntersectRayAABB( _origin[k], _dir[k], aabb, &dv, &dt );
+		if ( initTest == grinliz::INTERSECT || initTest == grinliz::INSIDE ) {
+			map[nObj++] = k;
+		}
+	}
+	if ( nObj == 0 )
+		return;
+
+	// Only the rays that touch the AABB are moved to object space.
+	const Matrix4& inv = InvXForm();
+	for( int n=0; n<nObj; ++n ) {
+		const int k = map[n];
+		Vector4F origin = { _origin[k].x, _origin[k].y, _origin[k].z, 1.0f };
+		Vector4F dir    = { _dir[k].x, _dir[k].y, _dir[k].z, 0.0f };
+
+		Vector4F objOrigin4 = inv * origin;
+		Vector4F objDir4    = inv * dir;
+		objOrigin[n].Set( objOrigin4.x, objOrigin4.y, objOrigin4.z );
+		objDir[n].Set( objDir4.x, objDir4.y, objDir4.z );
+	}
+
+	resource->IntersectRays( objOrigin, objDir, nObj, objIntersect, objResult );
+
+	const Matrix4& xform = XForm();
+	for( int n=0; n<nObj; ++n ) {
+		if ( objResult[n] == grinliz::INTERSECT ) {
+			const int k = map[n];
+			Vector4F objIntersect4 = { objIntersect[n].x, objIntersect[n].y, objIntersect[n].z, 1.0f };
+			Vector4F intersect4 = xform*objIntersect4;
+			intersect[k].Set( intersect4.x, intersect4.y, intersect4.z );
+			result[k] = grinliz::INTERSECT;
+		}
+	}
+}
+
+
 
 /*
 void Model::AddIndices( CDynArray<U16>* indexArr, int atomIndex ) const
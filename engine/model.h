@@ -27,6 +27,7 @@
 #include "serialize.h"
 #include "ufoutil.h"
 #include "gpustatemanager.h"
+#include "modelbvh.h"
 
 class Texture;
 class SpaceTree;
@@ -71,10 +72,19 @@ public:
 					const grinliz::Vector3F& dir,
 					grinliz::Vector3F* intersect ) const;
 
+	// Batched Intersect(). Walks the BVH once for all the rays. 'result' is 
+	// filled with REJECT or INTERSECT for each ray.
+	void IntersectRays(	const grinliz::Vector3F* point,
+						const grinliz::Vector3F* dir,
+						int nRays,
+						grinliz::Vector3F* intersect,
+						int* result ) const;
+
 
 	ModelHeader header;						// loaded
 
 	grinliz::Rectangle3F	hitBounds;		// for picking - a bounds approximation
+	ModelBVH				bvh;			// triangle hit testing, built at load
 	U16*					allIndex;		// memory store for vertices and indices. Used for hit-testing.
 	Vertex*					allVertex;
 
@@ -148,6 +158,7 @@ public:
 		MODEL_OWNED_BY_MAP			= 0x04,
 		MODEL_NO_SHADOW				= 0x08,
 		MODEL_INVISIBLE				= 0x10,
+		MODEL_BAKED					= 0x20,		// merged into the MapChunks, not queued
 		MODEL_METADATA				= 0x80,		// mapmaker data that isn't displayed in-game
 
 		// RESERVED!
@@ -162,9 +173,11 @@ public:
 	int Flags()	const				{ return flags; }
 
 	// Can this be put in a render cache? Yes if owned by the
-	// rarely-changing map.
-	// FIXME: also not cacheable if contains any alpha texture
-	bool Cacheable() const			{ return IsFlagSet( MODEL_OWNED_BY_MAP ) != 0; };
+	// rarely-changing map, and drawn with its own textures.
+	bool Cacheable() const			{ return    IsFlagSet( MODEL_OWNED_BY_MAP ) 
+											 && !IsFlagSet( MODEL_METADATA )
+											 && !auxTexture
+											 && !setTexture; };
 
 	const grinliz::Vector3F& Pos() const			{ return pos; }
 	void SetPos( const grinliz::Vector3F& pos );
@@ -199,9 +212,21 @@ public:
 						const grinliz::Vector3F& dir,
 						grinliz::Vector3F* intersect ) const;
 
+	// Batched IntersectRay: 'result' is grinliz::INTERSECT or grinliz::REJECT per ray.
+	void IntersectRays(	const grinliz::Vector3F* origin,
+						const grinliz::Vector3F* dir,
+						int nRays,
+						grinliz::Vector3F* intersect,
+						int* result ) const;
+
 	const ModelResource* GetResource() const	{ return resource; }
 	bool Sentinel()	const						{ return resource==0 && tree==0; }
 
+	// Whatever owns the model (a MapItem, a Unit) can point back to itself here,
+	// so a model from a hit test resolves to its owner directly. Cleared by Init().
+	void  SetUserData( void* data )				{ userData = data; }
+	void* UserData() const						{ return userData; }
+
 	Model* next;			// used by the SpaceTree query
 	Model* next0;			// used by the Engine sub-sorting
 	
@@ -212,6 +237,11 @@ public:
 	const grinliz::Matrix4& XForm() const;
 	bool HasTextureXForm( int i ) const;
 
+	// Brings the transforms and AABBs of many models up to date in one pass.
+	// Models turned only about Y (nearly all of them) skip the matrix
+	// concatenation, and the quarter turns of map items skip the trig.
+	static void UpdateXForms( const Model* const* models, int n );
+
 
 /*	void AddIndices( CDynArray<U16>* indexArr, int atomIndex ) const;
 	enum {
@@ -229,9 +259,11 @@ private:
 		//mapBoundsCache.Set( -1, -1, -1, -1 ); 
 	}
 	const grinliz::Matrix4& InvXForm() const;
+	void CalcXForm() const;		// the general case of UpdateXForms
 
 	SpaceTree* tree;
 	const ModelResource* resource;
+	void* userData;
 	grinliz::Vector3F pos;
 	float rot[3];
 
@@ -250,4 +282,26 @@ private:
 };
 
 
+// Result of one ray in a batched ray query.
+struct RayHit
+{
+	Model*				model;			// null if nothing was hit
+	grinliz::Vector3F	intersection;
+	float				distance;		// from the ray origin; FLT_MAX if no hit
+};
+
+
+// Work done by the last SpaceTree::Query. Boxes are counted once per plane tested.
+// The update counts run until SpaceTree::ResetUpdateStats().
+struct SpaceTreeStats
+{
+	int nodesVisited;
+	int planesComputed;		// node box vs. plane tests
+	int spheresComputed;	// model box vs. plane tests
+	int modelsFound;
+	int updates;			// calls to SpaceTree::Update
+	int relinks;			// updates that moved the model to another node
+};
+
+
 #endif // UFOATTACK_MODEL_INCLUDED
\ No newline at end of file
@@ -0,0 +1,277 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modelbvh.h"
+#include "model.h"
+#include "enginelimits.h"
+
+#include "../grinliz/glgeometry.h"
+
+#include <float.h>
+
+using namespace grinliz;
+
+
+// Slab test. Returns true if the ray enters the box before 'tMax', and the
+// entry distance (in units of 'dir') in 'tNear'.
+static inline bool RayBox( const Vector3F& p, const Vector3F& inv, const Rectangle3F& b, float tMax, float* tNear )
+{
+	float t0 = 0.0f;
+	float t1 = tMax;
+	for( int k=0; k<3; ++k ) {
+		const float pk = p.X(k);
+		if ( inv.X(k) == FLT_MAX ) {
+			// Parallel to the slab.
+			if ( pk < b.min.X(k) || pk > b.max.X(k) )
+				return false;
+			continue;
+		}
+		float tA = ( b.min.X(k) - pk ) * inv.X(k);
+		float tB = ( b.max.X(k) - pk ) * inv.X(k);
+		if ( tA > tB ) Swap( &tA, &tB );
+		if ( tA > t0 ) t0 = tA;
+		if ( tB < t1 ) t1 = tB;
+		if ( t0 > t1 )
+			return false;
+	}
+	*tNear = t0;
+	return true;
+}
+
+
+static inline Vector3F Inverse( const Vector3F& dir )
+{
+	Vector3F inv;
+	for( int k=0; k<3; ++k ) {
+		inv.X(k) = ( dir.X(k) != 0.0f ) ? 1.0f / dir.X(k) : FLT_MAX;
+	}
+	return inv;
+}
+
+
+void ModelBVH::Free()
+{
+	delete [] nodes;
+	delete [] tris;
+	nodes = 0;
+	tris = 0;
+	nNodes = 0;
+	nTris = 0;
+}
+
+
+void ModelBVH::Build( const ModelResource* res )
+{
+	Free();
+
+	for( unsigned i=0; i<res->header.nGroups; ++i ) {
+		nTris += res->atom[i].nIndex / 3;
+	}
+	if ( nTris == 0 )
+		return;
+
+	tris = new Tri[nTris];
+	Vector3F* center = new Vector3F[nTris];
+
+	int n = 0;
+	for( unsigned i=0; i<res->header.nGroups; ++i ) {
+		const ModelAtom& atom = res->atom[i];
+		for( unsigned j=0; j<atom.nIndex; j+=3, ++n ) {
+			for( int k=0; k<3; ++k ) {
+				tris[n].v[k] = atom.vertex[ atom.index[j+k] ].pos;
+			}
+			center[n] = ( tris[n].v[0] + tris[n].v[1] + tris[n].v[2] ) * (1.0f/3.0f);
+		}
+	}
+
+	// A binary tree with at least 1 triangle per leaf has fewer than 2n nodes.
+	nodes = new Node[2*nTris];
+	BuildRec( center, 0, nTris, 0 );
+	GLASSERT( nNodes < 2*nTris );
+
+	delete [] center;
+}
+
+
+int ModelBVH::BuildRec( Vector3F* center, int start, int count, int depth )
+{
+	const int index = nNodes++;
+	Node* node = &nodes[index];
+
+	node->bounds.min = node->bounds.max = tris[start].v[0];
+	Rectangle3F centerBounds;
+	centerBounds.min = centerBounds.max = center[start];
+	for( int i=start; i<start+count; ++i ) {
+		for( int k=0; k<3; ++k ) {
+			node->bounds.DoUnion( tris[i].v[k] );
+		}
+		centerBounds.DoUnion( center[i] );
+	}
+
+	if ( count <= LEAF_SIZE ) {
+		node->offset = start;
+		node->count = (U16)count;
+		node->axis = 0;
+		return index;
+	}
+
+	// Split the longest axis of the centers at its midpoint.
+	int axis = 0;
+	Vector3F size = centerBounds.max - centerBounds.min;
+	if ( size.y > size.X(axis) ) axis = 1;
+	if ( size.z > size.X(axis) ) axis = 2;
+	const float split = ( centerBounds.min.X(axis) + centerBounds.max.X(axis) ) * 0.5f;
+
+	int mid = start;
+	for( int i=start; depth < MAX_SPATIAL_DEPTH && i<start+count; ++i ) {
+		if ( center[i].X(axis) < split ) {
+			Swap( &tris[i], &tris[mid] );
+			Swap( &center[i], &center[mid] );
+			++mid;
+		}
+	}
+	// All the centers on one side (coincident triangles) or too deep: split in half.
+	if ( mid == start || mid == start+count ) {
+		mid = start + count/2;
+	}
+
+	// 'nodes' is allocated up front, so 'node' stays valid.
+	BuildRec( center, start, mid-start, depth+1 );
+	const int second = BuildRec( center, mid, start+count-mid, depth+1 );
+	node->offset = second;
+	node->count = 0;
+	node->axis = (U16)axis;
+	return index;
+}
+
+
+int ModelBVH::Intersect( const Vector3F& point, const Vector3F& dir, Vector3F* intersect ) const
+{
+	if ( !nNodes )
+		return REJECT;
+
+	const Vector3F inv = Inverse( dir );
+	const float invLen2 = 1.0f / DotProduct( dir, dir );
+	float best = FLT_MAX;
+	float tNear;
+	Vector3F test;
+
+	int stack[STACK_SIZE];
+	int depth = 0;
+	if ( RayBox( point, inv, nodes[0].bounds, best, &tNear ) )
+		stack[depth++] = 0;
+
+	while( depth ) {
+		const Node& node = nodes[stack[--depth]];
+		// A node is tested when pushed, but the best hit may be closer now.
+		if ( !RayBox( point, inv, node.bounds, best, &tNear ) )
+			continue;
+
+		if ( node.count ) {
+			for( U32 i=node.offset; i<node.offset+node.count; ++i ) {
+				if ( IntersectRayTri( point, dir, tris[i].v[0], tris[i].v[1], tris[i].v[2], &test ) == INTERSECT ) {
+					float t = DotProduct( test - point, dir ) * invLen2;
+					if ( t < best ) {
+						best = t;
+						*intersect = test;
+					}
+				}
+			}
+		}
+		else {
+			// Push the far child first, so the near child is walked first.
+			int first = &node - nodes + 1;
+			int second = node.offset;
+			if ( dir.X( node.axis ) < 0.0f )
+				Swap( &first, &second );
+
+			GLASSERT( depth+2 <= STACK_SIZE );
+			stack[depth++] = second;
+			stack[depth++] = first;
+		}
+	}
+	return ( best < FLT_MAX ) ? INTERSECT : REJECT;
+}
+
+
+void ModelBVH::IntersectRays( const Vector3F* point, const Vector3F* dir, int nRays, Vector3F* intersect, int* result ) const
+{
+	GLASSERT( nRays > 0 && nRays <= EL_MAX_RAY_BATCH );
+
+	Vector3F inv[EL_MAX_RAY_BATCH];
+	float invLen2[EL_MAX_RAY_BATCH];
+	float best[EL_MAX_RAY_BATCH];
+
+	for( int k=0; k<nRays; ++k ) {
+		result[k] = REJECT;
+		inv[k] = Inverse( dir[k] );
+		invLen2[k] = 1.0f / DotProduct( dir[k], dir[k] );
+		best[k] = FLT_MAX;
+	}
+	if ( !nNodes )
+		return;
+
+	// The stack carries the node and the mask of the rays that reached it.
+	// The rays are a fan from a common area, so they are walked in the 
+	// order of the first ray.
+	int stack[STACK_SIZE];
+	U32 mask[STACK_SIZE];
+	int depth = 0;
+	Vector3F test;
+	float tNear;
+
+	stack[depth] = 0;
+	mask[depth] = (1U<<nRays)-1;
+	++depth;
+
+	while( depth ) {
+		--depth;
+		const Node& node = nodes[stack[depth]];
+		U32 in = 0;
+		for( int k=0; k<nRays; ++k ) {
+			if ( ( mask[depth] & (1U<<k) ) && RayBox( point[k], inv[k], node.bounds, best[k], &tNear ) )
+				in |= 1U<<k;
+		}
+		if ( !in )
+			continue;
+
+		if ( node.count ) {
+			for( U32 i=node.offset; i<node.offset+node.count; ++i ) {
+				for( int k=0; k<nRays; ++k ) {
+					if (    ( in & (1U<<k) ) 
+						 && IntersectRayTri( point[k], dir[k], tris[i].v[0], tris[i].v[1], tris[i].v[2], &test ) == INTERSECT ) 
+					{
+						float t = DotProduct( test - point[k], dir[k] ) * invLen2[k];
+						if ( t < best[k] ) {
+							best[k] = t;
+							intersect[k] = test;
+							result[k] = INTERSECT;
+						}
+					}
+				}
+			}
+		}
+		else {
+			int first = &node - nodes + 1;
+			int second = node.offset;
+			if ( dir[0].X( node.axis ) < 0.0f )
+				Swap( &first, &second );
+
+			GLASSERT( depth+2 <= STACK_SIZE );
+			stack[depth] = second;	mask[depth] = in;	++depth;
+			stack[depth] = first;	mask[depth] = in;	++depth;
+		}
+	}
+}
@@ -0,0 +1,84 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFOATTACK_MODEL_BVH_INCLUDED
+#define UFOATTACK_MODEL_BVH_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glvector.h"
+#include "../grinliz/glrectangle.h"
+
+class ModelResource;
+
+
+/*
+	Bounding volume hierarchy over the triangles of a ModelResource, in the
+	object space of the resource. Built when the resource is loaded. The
+	triangle positions are copied in leaf order, so a leaf is a contiguous
+	run of triangles and the hit test never touches the render vertices.
+
+	Rays are walked front to back, and a node further away than the
+	closest hit so far is skipped.
+*/
+class ModelBVH
+{
+public:
+	ModelBVH() : nodes( 0 ), nNodes( 0 ), tris( 0 ), nTris( 0 )	{}
+	~ModelBVH()														{ Free(); }
+
+	void Build( const ModelResource* res );
+	void Free();
+	bool Empty() const		{ return nNodes == 0; }
+
+	// Closest hit along the ray. Returns INTERSECT or REJECT.
+	int Intersect(	const grinliz::Vector3F& point,
+					const grinliz::Vector3F& dir,
+					grinliz::Vector3F* intersect ) const;
+
+	// Intersect() for up to EL_MAX_RAY_BATCH rays. The tree is walked once,
+	// carrying the rays that are still in each node.
+	void IntersectRays(	const grinliz::Vector3F* point,
+						const grinliz::Vector3F* dir,
+						int nRays,
+						grinliz::Vector3F* intersect,
+						int* result ) const;
+
+private:
+	enum {
+		LEAF_SIZE	= 4,
+		MAX_SPATIAL_DEPTH = 24,	// below this, split by count to bound the depth
+		STACK_SIZE	= 64
+	};
+
+	struct Node {
+		grinliz::Rectangle3F bounds;
+		U32 offset;		// leaf: first triangle. interior: the second child. (The first child is this+1.)
+		U16 count;		// leaf: number of triangles. 0 if interior.
+		U16 axis;		// interior: the split axis
+	};
+	struct Tri {
+		grinliz::Vector3F v[3];
+	};
+
+	int BuildRec( grinliz::Vector3F* center, int start, int count, int depth );
+
+	Node*	nodes;
+	int		nNodes;
+	Tri*	tris;
+	int		nTris;
+};
+
+
+#endif // UFOATTACK_MODEL_BVH_INCLUDED
@@ -0,0 +1,244 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef XENOENGINE_NULL_GL
+
+#include <string.h>
+#include "nullgl.h"
+
+/*static*/ GLRecorder* GLRecorder::instance = 0;
+
+static const char* gTypeName[GLRecorder::NUM_TYPES] = {
+	"draw", "state", "matrix", "buffer", "bufferUpload", "texture", "textureUpload", "query", "other"
+};
+
+
+GLRecorder::GLRecorder()
+{
+	recording = false;
+	lastID = 0;
+	matrixMode = GL_MODELVIEW;
+	memset( viewport, 0, sizeof( viewport ) );
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+
+void GLRecorder::Clear()
+{
+	commands.Clear();
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+
+int GLRecorder::TotalCalls() const
+{
+	int total = 0;
+	for( int i=0; i<NUM_TYPES; ++i )
+		total += stats.calls[i];
+	return total;
+}
+
+
+void GLRecorder::Record( const char* name, int type, U32 arg0, U32 arg1, U32 bytes )
+{
+	GLASSERT( type >= 0 && type < NUM_TYPES );
+	stats.calls[type] += 1;
+	if ( type == DRAW )
+		stats.indices += arg1;
+	else if ( type == BUFFER_UPLOAD )
+		stats.bufferBytes += bytes;
+	else if ( type == TEXTURE_UPLOAD )
+		stats.textureBytes += bytes;
+
+	if ( recording ) {
+		Command* c = commands.Push();
+		c->name = name;
+		c->type = type;
+		c->arg0 = arg0;
+		c->arg1 = arg1;
+		c->bytes = bytes;
+	}
+}
+
+
+void GLRecorder::Dump( FILE* fp ) const
+{
+	for( int i=0; i<commands.Size(); ++i ) {
+		const Command& c = commands[i];
+		fprintf( fp, "%s 0x%x %u", c.name, c.arg0, c.arg1 );
+		if ( c.bytes )
+			fprintf( fp, " %ub", c.bytes );
+		fprintf( fp, "\n" );
+	}
+	for( int i=0; i<NUM_TYPES; ++i ) {
+		fprintf( fp, "%s=%d ", gTypeName[i], stats.calls[i] );
+	}
+	fprintf( fp, "indices=%d bufferBytes=%u textureBytes=%u\n", stats.indices, stats.bufferBytes, stats.textureBytes );
+}
+
+
+#define RECORD( type )						GLRecorder::Instance()->Record( __FUNCTION__, GLRecorder::type )
+#define RECORD_ARG( type, arg )				GLRecorder::Instance()->Record( __FUNCTION__, GLRecorder::type, (U32)(arg) )
+#define RECORD_ARGS( type, a0, a1, bytes )	GLRecorder::Instance()->Record( __FUNCTION__, GLRecorder::type, (U32)(a0), (U32)(a1), (U32)(bytes) )
+
+
+static U32 PixelBytes( GLenum format, GLenum type )
+{
+	if ( type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_6_5 )
+		return 2;
+	switch ( format ) {
+		case GL_ALPHA:	return 1;
+		case GL_RGB:	return 3;
+		default:		return 4;
+	}
+}
+
+
+// State
+void glEnable( GLenum cap )											{ RECORD_ARG( STATE, cap ); }
+void glDisable( GLenum cap )										{ RECORD_ARG( STATE, cap ); }
+void glEnableClientState( GLenum array )							{ RECORD_ARG( STATE, array ); }
+void glDisableClientState( GLenum array )							{ RECORD_ARG( STATE, array ); }
+GLboolean glIsEnabled( GLenum cap )									{ RECORD_ARG( QUERY, cap ); return GL_FALSE; }
+void glActiveTexture( GLenum texture )								{ RECORD_ARG( STATE, texture ); }
+void glClientActiveTexture( GLenum texture )						{ RECORD_ARG( STATE, texture ); }
+void glBlendFunc( GLenum sfactor, GLenum dfactor )					{ RECORD_ARG( STATE, sfactor ); }
+void glAlphaFunc( GLenum func, GLclampf ref )						{ RECORD_ARG( STATE, func ); }
+void glDepthFunc( GLenum func )										{ RECORD_ARG( STATE, func ); }
+void glDepthMask( GLboolean flag )									{ RECORD_ARG( STATE, flag ); }
+void glCullFace( GLenum mode )										{ RECORD_ARG( STATE, mode ); }
+void glScissor( GLint x, GLint y, GLsizei width, GLsizei height )	{ RECORD( STATE ); }
+void glColor4f( GLfloat r, GLfloat g, GLfloat b, GLfloat a )		{ RECORD( STATE ); }
+void glLightfv( GLenum light, GLenum pname, const GLfloat* params )	{ RECORD_ARG( STATE, pname ); }
+void glMaterialfv( GLenum face, GLenum pname, const GLfloat* params )	{ RECORD_ARG( STATE, pname ); }
+void glColorMaterial( GLenum face, GLenum mode )					{ RECORD_ARG( STATE, mode ); }
+void glPointSize( GLfloat size )									{ RECORD( STATE ); }
+void glLineWidth( GLfloat width )									{ RECORD( STATE ); }
+void glTexEnvf( GLenum target, GLenum pname, GLfloat param )		{ RECORD_ARG( STATE, pname ); }
+void glTexEnvi( GLenum target, GLenum pname, GLint param )			{ RECORD_ARG( STATE, pname ); }
+void glTexEnvx( GLenum target, GLenum pname, GLfixed param )		{ RECORD_ARG( STATE, pname ); }
+
+void glViewport( GLint x, GLint y, GLsizei width, GLsizei height )
+{
+	GLRecorder* r = GLRecorder::Instance();
+	r->viewport[0] = x;
+	r->viewport[1] = y;
+	r->viewport[2] = width;
+	r->viewport[3] = height;
+	RECORD( OTHER );
+}
+
+
+// Arrays and drawing
+void glVertexPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr )		{ RECORD_ARG( STATE, stride ); }
+void glNormalPointer( GLenum type, GLsizei stride, const GLvoid* ptr )					{ RECORD_ARG( STATE, stride ); }
+void glColorPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr )		{ RECORD_ARG( STATE, stride ); }
+void glTexCoordPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr )	{ RECORD_ARG( STATE, stride ); }
+void glDrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid* indices )	{ RECORD_ARGS( DRAW, mode, count, 0 ); }
+void glDrawArrays( GLenum mode, GLint first, GLsizei count )							{ RECORD_ARGS( DRAW, mode, count, 0 ); }
+void glBegin( GLenum mode )																{ RECORD_ARG( DRAW, mode ); }
+void glEnd()																			{}
+void glVertex3f( GLfloat x, GLfloat y, GLfloat z )										{}
+void glClear( GLbitfield mask )															{ RECORD_ARG( OTHER, mask ); }
+
+void glReadPixels( GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels )
+{
+	// A black screen.
+	if ( pixels && type == GL_UNSIGNED_BYTE ) {
+		memset( pixels, 0, width*height*PixelBytes( format, type ) );
+	}
+	RECORD_ARG( OTHER, format );
+}
+
+
+// Matrices
+void glMatrixMode( GLenum mode )						{ GLRecorder::Instance()->matrixMode = mode; RECORD_ARG( MATRIX, mode ); }
+void glLoadIdentity()									{ RECORD( MATRIX ); }
+void glLoadMatrixf( const GLfloat* m )					{ RECORD( MATRIX ); }
+void glMultMatrixf( const GLfloat* m )					{ RECORD( MATRIX ); }
+void glPushMatrix()										{ RECORD( MATRIX ); }
+void glPopMatrix()										{ RECORD( MATRIX ); }
+void glRotatef( GLfloat angle, GLfloat x, GLfloat y, GLfloat z )	{ RECORD( MATRIX ); }
+void glFrustum( GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar )	{ RECORD( MATRIX ); }
+void glOrtho( GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar )		{ RECORD( MATRIX ); }
+
+
+// Buffers
+void glGenBuffers( GLsizei n, GLuint* buffers )
+{
+	for( int i=0; i<n; ++i )
+		buffers[i] = GLRecorder::Instance()->NewID();
+	RECORD_ARG( BUFFER, n );
+}
+
+void glDeleteBuffers( GLsizei n, const GLuint* buffers )								{ RECORD_ARG( BUFFER, n ); }
+void glBindBuffer( GLenum target, GLuint buffer )										{ RECORD_ARGS( STATE, target, buffer, 0 ); }
+void glBufferData( GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage )	{ RECORD_ARGS( BUFFER_UPLOAD, target, 0, size ); }
+void glBufferSubData( GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data )	{ RECORD_ARGS( BUFFER_UPLOAD, target, offset, size ); }
+
+
+// Textures
+void glGenTextures( GLsizei n, GLuint* textures )
+{
+	for( int i=0; i<n; ++i )
+		textures[i] = GLRecorder::Instance()->NewID();
+	RECORD_ARG( TEXTURE, n );
+}
+
+void glDeleteTextures( GLsizei n, const GLuint* textures )					{ RECORD_ARG( TEXTURE, n ); }
+GLboolean glIsTexture( GLuint texture )										{ RECORD_ARG( QUERY, texture ); return GLRecorder::Instance()->IsID( texture ) ? GL_TRUE : GL_FALSE; }
+void glBindTexture( GLenum target, GLuint texture )							{ RECORD_ARGS( STATE, target, texture, 0 ); }
+void glTexParameteri( GLenum target, GLenum pname, GLint param )			{ RECORD_ARG( TEXTURE, pname ); }
+void glGetTexLevelParameteriv( GLenum target, GLint level, GLenum pname, GLint* params )	{ *params = 0; RECORD_ARG( QUERY, pname ); }
+
+void glTexImage2D( GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels )
+{
+	RECORD_ARGS( TEXTURE_UPLOAD, format, level, width*height*PixelBytes( format, type ) );
+}
+
+
+// Queries
+GLenum glGetError()			{ return GL_NO_ERROR; }		// not recorded: called after almost everything in DEBUG
+
+const GLubyte* glGetString( GLenum name )
+{
+	RECORD_ARG( QUERY, name );
+	switch( name ) {
+		case GL_VENDOR:		return (const GLubyte*)"xenowar";
+		case GL_RENDERER:	return (const GLubyte*)"null";
+		case GL_VERSION:	return (const GLubyte*)"1.5 recording";
+		case GL_EXTENSIONS:	return (const GLubyte*)"GL_ARB_vertex_buffer_object GL_ARB_point_sprite";
+		default:			return (const GLubyte*)"";
+	}
+}
+
+
+void glGetIntegerv( GLenum pname, GLint* params )
+{
+	GLRecorder* r = GLRecorder::Instance();
+	switch( pname ) {
+		case GL_VIEWPORT:		memcpy( params, r->viewport, sizeof( r->viewport ) );	break;
+		case GL_MATRIX_MODE:	*params = r->matrixMode;								break;
+		case GL_DEPTH_BITS:		*params = 16;											break;
+		default:				*params = 0;											break;
+	}
+	RECORD_ARG( QUERY, pname );
+}
+
+
+void glGetBooleanv( GLenum pname, GLboolean* params )	{ *params = GL_FALSE; RECORD_ARG( QUERY, pname ); }
+void glGetPointerv( GLenum pname, GLvoid** params )		{ *params = 0; RECORD_ARG( QUERY, pname ); }
+
+#endif // XENOENGINE_NULL_GL
@@ -0,0 +1,293 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFOATTACK_NULLGL_INCLUDED
+#define UFOATTACK_NULLGL_INCLUDED
+
+#ifdef XENOENGINE_NULL_GL
+
+#include <stdio.h>
+#include <stddef.h>
+#include "../grinliz/gldebug.h"
+#include "../grinliz/gltypes.h"
+#include "ufoutil.h"
+
+/*
+	The recording GL backend, for profiling and testing the CPU side of the
+	renderer on machines without a GPU. Built with XENOENGINE_NULL_GL (the
+	XENOWAR_NULL_GL CMake option), platformgl.h includes this header instead
+	of the GL headers, and the subset of GL 1.x the engine uses is implemented
+	in nullgl.cpp. Nothing is drawn.
+
+	Every call is counted by type, with the indices drawn and the bytes
+	uploaded to buffers and textures. If recording is on, each call is also
+	appended to an in-memory command stream that can be inspected or dumped.
+	The queries answer with fixed values: no errors, VBOs and point sprites
+	are supported, and the viewport is whatever was last set.
+*/
+class GLRecorder
+{
+public:
+	static GLRecorder* Instance()	{ if ( !instance ) instance = new GLRecorder(); return instance; }
+
+	enum {
+		DRAW,				// glDrawElements, glDrawArrays
+		STATE,				// enables, binds, pointers, blend and depth, lights, color
+		MATRIX,				// the matrix stacks
+		BUFFER,				// buffer creation and deletion
+		BUFFER_UPLOAD,		// glBufferData, glBufferSubData
+		TEXTURE,			// texture creation, deletion, and parameters
+		TEXTURE_UPLOAD,		// glTexImage2D
+		QUERY,				// glGet*, glIsEnabled
+		OTHER,				// clear, viewport, read pixels
+		NUM_TYPES
+	};
+
+	struct Command {
+		const char*	name;		// the gl function
+		int			type;
+		U32			arg0;		// first enum or id argument, or 0
+		U32			arg1;		// indices or points for draws, or 0
+		U32			bytes;		// bytes for uploads, or 0
+	};
+
+	struct Stats {
+		int calls[NUM_TYPES];
+		int indices;			// indices (or points) drawn
+		U32 bufferBytes;
+		U32 textureBytes;
+	};
+
+	// Recording keeps the command stream, which grows until cleared.
+	// The stats are always kept.
+	void SetRecording( bool record )		{ recording = record; }
+	bool IsRecording() const				{ return recording; }
+
+	// Clears the command stream and the stats. (Usually once a frame.)
+	void Clear();
+
+	const Stats& GetStats() const			{ return stats; }
+	int TotalCalls() const;
+	int NumCommands() const					{ return commands.Size(); }
+	const Command& GetCommand( int i ) const	{ return commands[i]; }
+
+	// One command per line, then the stats.
+	void Dump( FILE* fp ) const;
+
+	// Called by the gl functions.
+	void Record( const char* name, int type, U32 arg0=0, U32 arg1=0, U32 bytes=0 );
+	U32  NewID()							{ return ++lastID; }
+	bool IsID( U32 id ) const				{ return id > 0 && id <= lastID; }
+
+	int viewport[4];
+	int matrixMode;
+
+private:
+	GLRecorder();
+	static GLRecorder* instance;
+
+	bool recording;
+	U32 lastID;
+	Stats stats;
+	CDynArray<Command> commands;
+};
+
+
+// The GL types and constants that the engine uses, with the standard values.
+typedef unsigned int	GLenum;
+typedef unsigned int	GLbitfield;
+typedef unsigned int	GLuint;
+typedef int				GLint;
+typedef int				GLsizei;
+typedef unsigned char	GLboolean;
+typedef unsigned char	GLubyte;
+typedef float			GLfloat;
+typedef float			GLclampf;
+typedef double			GLdouble;
+typedef int				GLfixed;
+typedef void			GLvoid;
+typedef ptrdiff_t		GLintptr;
+typedef ptrdiff_t		GLsizeiptr;
+
+#define GL_FALSE						0
+#define GL_TRUE							1
+#define GL_NO_ERROR						0
+
+#define GL_LINES						0x0001
+#define GL_POINTS						0x0000
+#define GL_TRIANGLES					0x0004
+
+#define GL_LESS							0x0201
+#define GL_LEQUAL						0x0203
+#define GL_GREATER						0x0204
+#define GL_SRC_ALPHA					0x0302
+#define GL_ONE_MINUS_SRC_ALPHA			0x0303
+#define GL_BACK							0x0405
+#define GL_FRONT_AND_BACK				0x0408
+
+#define GL_CULL_FACE					0x0B44
+#define GL_LIGHTING						0x0B50
+#define GL_COLOR_MATERIAL				0x0B57
+#define GL_DEPTH_TEST					0x0B71
+#define GL_DEPTH_WRITEMASK				0x0B72
+#define GL_MATRIX_MODE					0x0BA0
+#define GL_VIEWPORT						0x0BA2
+#define GL_ALPHA_TEST					0x0BC0
+#define GL_BLEND						0x0BE2
+#define GL_SCISSOR_TEST					0x0C11
+#define GL_DEPTH_BITS					0x0D56
+#define GL_TEXTURE_2D					0x0DE1
+#define GL_TEXTURE_WIDTH				0x1000
+#define GL_TEXTURE_HEIGHT				0x1001
+#define GL_TEXTURE_INTERNAL_FORMAT		0x1003
+
+#define GL_AMBIENT						0x1200
+#define GL_DIFFUSE						0x1201
+#define GL_SPECULAR						0x1202
+#define GL_POSITION						0x1203
+#define GL_AMBIENT_AND_DIFFUSE			0x1602
+#define GL_EMISSION						0x1600
+
+#define GL_UNSIGNED_BYTE				0x1401
+#define GL_UNSIGNED_SHORT				0x1403
+#define GL_FLOAT						0x1406
+
+#define GL_MODELVIEW					0x1700
+#define GL_PROJECTION					0x1701
+#define GL_TEXTURE						0x1702
+
+#define GL_ALPHA						0x1906
+#define GL_RGB							0x1907
+#define GL_RGBA							0x1908
+
+#define GL_VENDOR						0x1F00
+#define GL_RENDERER						0x1F01
+#define GL_VERSION						0x1F02
+#define GL_EXTENSIONS					0x1F03
+
+#define GL_MODULATE						0x2100
+#define GL_TEXTURE_ENV_MODE				0x2200
+#define GL_TEXTURE_ENV					0x2300
+#define GL_LINEAR						0x2601
+#define GL_LINEAR_MIPMAP_NEAREST		0x2701
+#define GL_TEXTURE_MAG_FILTER			0x2800
+#define GL_TEXTURE_MIN_FILTER			0x2801
+#define GL_LIGHT0						0x4000
+
+#define GL_DEPTH_BUFFER_BIT				0x00000100
+#define GL_COLOR_BUFFER_BIT				0x00004000
+
+#define GL_UNSIGNED_SHORT_4_4_4_4		0x8033
+#define GL_UNSIGNED_SHORT_5_6_5			0x8363
+#define GL_GENERATE_MIPMAP				0x8191
+
+#define GL_VERTEX_ARRAY					0x8074
+#define GL_NORMAL_ARRAY					0x8075
+#define GL_COLOR_ARRAY					0x8076
+#define GL_INDEX_ARRAY					0x8077
+#define GL_TEXTURE_COORD_ARRAY			0x8078
+#define GL_VERTEX_ARRAY_POINTER			0x808E
+#define GL_NORMAL_ARRAY_POINTER			0x808F
+#define GL_COLOR_ARRAY_POINTER			0x8090
+#define GL_TEXTURE_COORD_ARRAY_POINTER	0x8092
+
+#define GL_TEXTURE0						0x84C0
+#define GL_TEXTURE1						0x84C1
+
+#define GL_POINT_SPRITE					0x8861
+#define GL_POINT_SPRITE_OES				0x8861
+#define GL_COORD_REPLACE				0x8862
+#define GL_COORD_REPLACE_OES			0x8862
+
+#define GL_ARRAY_BUFFER					0x8892
+#define GL_ELEMENT_ARRAY_BUFFER			0x8893
+#define GL_STATIC_DRAW					0x88E4
+#define GL_DYNAMIC_DRAW					0x88E8
+
+
+// State
+void glEnable( GLenum cap );
+void glDisable( GLenum cap );
+void glEnableClientState( GLenum array );
+void glDisableClientState( GLenum array );
+GLboolean glIsEnabled( GLenum cap );
+void glActiveTexture( GLenum texture );
+void glClientActiveTexture( GLenum texture );
+void glBlendFunc( GLenum sfactor, GLenum dfactor );
+void glAlphaFunc( GLenum func, GLclampf ref );
+void glDepthFunc( GLenum func );
+void glDepthMask( GLboolean flag );
+void glCullFace( GLenum mode );
+void glScissor( GLint x, GLint y, GLsizei width, GLsizei height );
+void glViewport( GLint x, GLint y, GLsizei width, GLsizei height );
+void glColor4f( GLfloat r, GLfloat g, GLfloat b, GLfloat a );
+void glLightfv( GLenum light, GLenum pname, const GLfloat* params );
+void glMaterialfv( GLenum face, GLenum pname, const GLfloat* params );
+void glColorMaterial( GLenum face, GLenum mode );
+void glPointSize( GLfloat size );
+void glLineWidth( GLfloat width );
+void glTexEnvf( GLenum target, GLenum pname, GLfloat param );
+void glTexEnvi( GLenum target, GLenum pname, GLint param );
+void glTexEnvx( GLenum target, GLenum pname, GLfixed param );
+
+// Arrays and drawing
+void glVertexPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr );
+void glNormalPointer( GLenum type, GLsizei stride, const GLvoid* ptr );
+void glColorPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr );
+void glTexCoordPointer( GLint size, GLenum type, GLsizei stride, const GLvoid* ptr );
+void glDrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid* indices );
+void glDrawArrays( GLenum mode, GLint first, GLsizei count );
+void glBegin( GLenum mode );
+void glEnd();
+void glVertex3f( GLfloat x, GLfloat y, GLfloat z );
+void glClear( GLbitfield mask );
+void glReadPixels( GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels );
+
+// Matrices
+void glMatrixMode( GLenum mode );
+void glLoadIdentity();
+void glLoadMatrixf( const GLfloat* m );
+void glMultMatrixf( const GLfloat* m );
+void glPushMatrix();
+void glPopMatrix();
+void glRotatef( GLfloat angle, GLfloat x, GLfloat y, GLfloat z );
+void glFrustum( GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar );
+void glOrtho( GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar );
+
+// Buffers
+void glGenBuffers( GLsizei n, GLuint* buffers );
+void glDeleteBuffers( GLsizei n, const GLuint* buffers );
+void glBindBuffer( GLenum target, GLuint buffer );
+void glBufferData( GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage );
+void glBufferSubData( GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data );
+
+// Textures
+void glGenTextures( GLsizei n, GLuint* textures );
+void glDeleteTextures( GLsizei n, const GLuint* textures );
+GLboolean glIsTexture( GLuint texture );
+void glBindTexture( GLenum target, GLuint texture );
+void glTexParameteri( GLenum target, GLenum pname, GLint param );
+void glTexImage2D( GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels );
+void glGetTexLevelParameteriv( GLenum target, GLint level, GLenum pname, GLint* params );
+
+// Queries
+GLenum glGetError();
+const GLubyte* glGetString( GLenum name );
+void glGetIntegerv( GLenum pname, GLint* params );
+void glGetBooleanv( GLenum pname, GLboolean* params );
+void glGetPointerv( GLenum pname, GLvoid** params );
+
+#endif // XENOENGINE_NULL_GL
+#endif // UFOATTACK_NULLGL_INCLUDED
@@ -20,9 +20,79 @@
 #include "camera.h"
 #include "particleeffect.h"
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	include <emmintrin.h>
+#	define PARTICLE_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#	include <arm_neon.h>
+#	define PARTICLE_NEON
+#endif
+
 using namespace grinliz;
 
 
+// 4 wide float operations for the particle integration.
+// Loads are aligned, stores are not (compaction writes to any index.)
+namespace {
+#if defined( PARTICLE_SSE2 )
+	typedef __m128 Float4;
+	inline Float4	Load4( const float* p )							{ return _mm_load_ps( p ); }
+	inline void		Store4( float* p, Float4 v )					{ _mm_storeu_ps( p, v ); }
+	inline Float4	Splat4( float f )								{ return _mm_set1_ps( f ); }
+	inline Float4	MulAdd4( Float4 a, Float4 b, Float4 c )			{ return _mm_add_ps( a, _mm_mul_ps( b, c ) ); }
+	inline int		PositiveMask4( Float4 v )						{ return _mm_movemask_ps( _mm_cmpgt_ps( v, _mm_setzero_ps() ) ); }
+#elif defined( PARTICLE_NEON )
+	typedef float32x4_t Float4;
+	inline Float4	Load4( const float* p )							{ return vld1q_f32( p ); }
+	inline void		Store4( float* p, Float4 v )					{ vst1q_f32( p, v ); }
+	inline Float4	Splat4( float f )								{ return vdupq_n_f32( f ); }
+	inline Float4	MulAdd4( Float4 a, Float4 b, Float4 c )			{ return vmlaq_f32( a, b, c ); }
+	inline int		PositiveMask4( Float4 v ) {
+		static const uint32_t BITS[4] = { 1, 2, 4, 8 };
+		uint32x4_t m = vandq_u32( vcgtq_f32( v, vdupq_n_f32( 0 ) ), vld1q_u32( BITS ) );
+		return (int)( vgetq_lane_u32( m, 0 ) | vgetq_lane_u32( m, 1 ) | vgetq_lane_u32( m, 2 ) | vgetq_lane_u32( m, 3 ) );
+	}
+#else
+	struct Float4 { float x[4]; };
+	inline Float4	Load4( const float* p )							{ Float4 v = { { p[0], p[1], p[2], p[3] } }; return v; }
+	inline void		Store4( float* p, const Float4& v )				{ p[0] = v.x[0]; p[1] = v.x[1]; p[2] = v.x[2]; p[3] = v.x[3]; }
+	inline Float4	Splat4( float f )								{ Float4 v = { { f, f, f, f } }; return v; }
+	inline Float4	MulAdd4( const Float4& a, const Float4& b, const Float4& c ) {
+		Float4 v = { { a.x[0]+b.x[0]*c.x[0], a.x[1]+b.x[1]*c.x[1], a.x[2]+b.x[2]*c.x[2], a.x[3]+b.x[3]*c.x[3] } };
+		return v;
+	}
+	inline int		PositiveMask4( const Float4& v ) {
+		return ( v.x[0] > 0 ? 1 : 0 ) | ( v.x[1] > 0 ? 2 : 0 ) | ( v.x[2] > 0 ? 4 : 0 ) | ( v.x[3] > 0 ? 8 : 0 );
+	}
+#endif
+}
+
+
+ParticleSystem::ParticleStream::ParticleStream( int _capacity )
+{
+	capacity = ( _capacity + 3 ) & (~3);
+	size = 0;
+
+	// One block for all the streams. Each is 16 byte aligned.
+	const int bytes = NUM_STREAMS*capacity*sizeof(float) + capacity + 16;
+	mem = malloc( bytes );
+	memset( mem, 0, bytes );
+
+	float* f = (float*)( ( (uintptr_t)mem + 15 ) & ~((uintptr_t)15) );
+	for( int i=0; i<NUM_STREAMS; ++i ) {
+		s[i] = f;
+		f += capacity;
+	}
+	type = (U8*)f;
+}
+
+
+ParticleSystem::ParticleStream::~ParticleStream()
+{
+	free( mem );
+}
+
+
 /*static*/ void ParticleSystem::Create()
 {
 	GLASSERT( instance == 0 );
@@ -41,17 +111,34 @@ using namespace grinliz;
 ParticleSystem* ParticleSystem::instance = 0;
 
 
-ParticleSystem::ParticleSystem()
+ParticleSystem::ParticleSystem() : pointBuffer( EL_MAX_POINT_PARTICLES ), quadBuffer( EL_MAX_QUAD_PARTICLES )
 {
+	// An auto-fire burst is a bolt or trail and 1-2 impacts per round.
+	static const int EFFECT_CAP[ParticleEffect::NUM_TYPES] = {
+		32,		// BOLT
+		64,		// IMPACT
+		32,		// SMOKE_TRAIL
+		8		// RING
+	};
+
 	pointTexture = 0;
 	quadTexture = 0;
-	frame = 0;
+	memset( &stats, 0, sizeof( stats ) );
+	for( int i=0; i<ParticleEffect::NUM_TYPES; ++i ) {
+		effectCap[i] = EFFECT_CAP[i];
+		effectCount[i] = 0;
+	}
 }
 
 
 ParticleSystem::~ParticleSystem()
 {
 	Clear();
+	for( int i=0; i<ParticleEffect::NUM_TYPES; ++i ) {
+		for( int j=0; j<effectPool[i].Size(); ++j ) {
+			delete effectPool[i][j];
+		}
+	}
 }
 
 
@@ -59,78 +146,156 @@ void ParticleSystem::Clear()
 {
 	pointBuffer.Clear();
 	quadBuffer.Clear();
+	memset( &stats, 0, sizeof( stats ) );
 
 	for( int i=0; i<effectArr.Size(); ++i ) {
-		delete effectArr[i];
+		effectPool[effectArr[i]->Type()].Push( effectArr[i] );
 	}
 	effectArr.Clear();
+	for( int i=0; i<ParticleEffect::NUM_TYPES; ++i ) {
+		effectCount[i] = 0;
+	}
 }
 
 
-void ParticleSystem::AddEffect( ParticleEffect* effect )
+void ParticleSystem::SetEffectCap( int type, int cap )
 {
-	effectArr.Push( effect );
+	GLASSERT( type >= 0 && type < ParticleEffect::NUM_TYPES );
+	GLASSERT( cap > 0 );
+	effectCap[type] = cap;
 }
 
 
-ParticleEffect* ParticleSystem::EffectFactory( const char* name )
+ParticleEffect* ParticleSystem::AllocEffect( int type )
 {
-	for( int i=0; i<effectArr.Size(); ++i ) {
-		if ( effectArr[i]->Done() && strcmp( effectArr[i]->Name(), name ) == 0 ) {
-			ParticleEffect* effect = effectArr[i];
-			effectArr.SwapRemove( i );
-			return effect;
+	GLASSERT( type >= 0 && type < ParticleEffect::NUM_TYPES );
+	ParticleEffect* effect = 0;
+
+	// An effect is live, and counted, from the moment it is handed out. That
+	// way effects allocated together (an explosion's two impacts) can't go
+	// over the cap between them.
+	if ( effectCount[type] >= effectCap[type] ) {
+		// Take over the oldest live effect of this type.
+		for( int i=0; i<effectArr.Size(); ++i ) {
+			if ( effectArr[i]->Type() == type ) {
+				effect = effectArr[i];
+				for( ; i<effectArr.Size()-1; ++i ) {
+					effectArr[i] = effectArr[i+1];
+				}
+				effectArr.Trim( effectArr.Size()-1 );
+				stats.nEffectsTaken++;
+				break;
+			}
 		}
 	}
 
-	// If we can't re-use, and there are a few entries, go ahead and
-	// cull the old memory. '20' is the magic random number here.
-	if ( effectArr.Size() > 20 ) {
-		int dc=0;
-		while ( dc < effectArr.Size() ) {
-			if ( effectArr[dc]->Done() ) {
-				delete effectArr[dc];
-				effectArr.SwapRemove( dc );
-			}
-			else {
-				++dc;
+	if ( !effect ) {
+		if ( !effectPool[type].Empty() ) {
+			const int last = effectPool[type].Size()-1;
+			effect = effectPool[type][last];
+			effectPool[type].Trim( last );
+		}
+		else {
+			switch( type ) {
+				case ParticleEffect::BOLT:			effect = new BoltEffect( this );		break;
+				case ParticleEffect::IMPACT:		effect = new ImpactEffect( this );		break;
+				case ParticleEffect::SMOKE_TRAIL:	effect = new SmokeTrailEffect( this );	break;
+				case ParticleEffect::RING:			effect = new RingEffect( this );		break;
+				default:
+					GLASSERT( 0 );
+					break;
 			}
 		}
+		effectCount[type]++;
 	}
-	return 0;
+	GLASSERT( effect->Type() == type );
+	effect->Clear();
+	effectArr.Push( effect );
+	return effect;
 }
 
 
-void ParticleSystem::Cull( CDynArray<Particle>* buffer )
+const ParticleStats& ParticleSystem::Stats()
 {
-	if ( !buffer->Empty() ) {
-		Particle* p = buffer->Mem();
-		Particle* q = buffer->Mem();
-		const Particle* end = buffer->Mem() + buffer->Size();
-
-		while ( q < end ) {
-			*p = *q;
-			q++;
-//			if ( p->age < p->lifetime )
-//				++p;
-			if ( p->color.a > 0.0f )
-				++p;
-		}
-		int size = p - buffer->Mem();
-		if ( size < buffer->Size() )
-			buffer->Trim( size );
+	stats.nPoints = pointBuffer.Size();
+	stats.nQuads = quadBuffer.Size();
+	stats.nEffects = effectArr.Size();
+	return stats;
+}
+
+
+bool ParticleSystem::Admit( const ParticleStream& stream, int priority )
+{
+	GLASSERT( priority >= 0 && priority < NUM_PRIORITIES );
+	// Percent full where thinning starts. Past that, the chance of
+	// emitting falls linearly to 0 at a full buffer.
+	static const int THROTTLE_START[NUM_PRIORITIES] = { 50, 75, 100 };
+
+	const int size = stream.Size();
+	const int cap = stream.Capacity();
+	if ( size >= cap ) {
+		++stats.nDropped;
+		return false;
 	}
+	const int start = cap * THROTTLE_START[priority] / 100;
+	if ( size >= start && (int)rand.Rand( cap - start ) < size - start ) {
+		++stats.nThrottled;
+		return false;
+	}
+	return true;
 }
 
 
-void ParticleSystem::Process( CDynArray<Particle>* buffer, float time, unsigned msec )
+void ParticleSystem::Integrate( ParticleStream* stream, float sec )
 {
-	Particle* p = buffer->Mem();
-	const Particle* end = buffer->Mem() + buffer->Size();
-	while ( p < end ) {
-		p->Process( time, msec );
-		++p;
+	typedef ParticleStream PS;
+	float** s = stream->s;
+	const Float4 dt = Splat4( sec );
+	const int size = stream->Size();
+
+	// Particles are integrated in groups of 4, in place, and the live
+	// ones are written back at 'write'. A particle is dead once it has
+	// faded out; alpha falls linearly, so that is its lifetime.
+	int write = 0;
+	for( int read=0; read<size; read+=4 ) {
+		Float4 v[PS::NUM_STREAMS];
+		for( int k=PS::POS_X; k<=PS::POS_Z; ++k )
+			v[k] = MulAdd4( Load4( s[k]+read ), Load4( s[k-PS::POS_X+PS::VEL_X]+read ), dt );
+		for( int k=PS::COLOR_R; k<=PS::COLOR_A; ++k )
+			v[k] = MulAdd4( Load4( s[k]+read ), Load4( s[k-PS::COLOR_R+PS::COLOR_VEL_R]+read ), dt );
+		for( int k=PS::VEL_X; k<=PS::COLOR_VEL_A; ++k )
+			v[k] = Load4( s[k]+read );
+		v[PS::HALF_WIDTH] = MulAdd4( Load4( s[PS::HALF_WIDTH]+read ), Load4( s[PS::VEL_HALF_WIDTH]+read ), dt );
+		v[PS::VEL_HALF_WIDTH] = Load4( s[PS::VEL_HALF_WIDTH]+read );
+
+		int alive = PositiveMask4( v[PS::COLOR_A] );
+		if ( read + 4 > size ) {
+			alive &= ( 1 << ( size - read ) ) - 1;	// the padding is never alive
+		}
+
+		if ( alive == 0xf ) {
+			// The common case: the whole group survives.
+			for( int k=0; k<PS::NUM_STREAMS; ++k )
+				Store4( s[k]+write, v[k] );
+			if ( write != read )
+				memmove( stream->type+write, stream->type+read, 4 );
+			write += 4;
+		}
+		else if ( alive ) {
+			float lane[PS::NUM_STREAMS][4];
+			for( int k=0; k<PS::NUM_STREAMS; ++k )
+				Store4( lane[k], v[k] );
+			for( int j=0; j<4; ++j ) {
+				if ( alive & (1<<j) ) {
+					for( int k=0; k<PS::NUM_STREAMS; ++k )
+						s[k][write] = lane[k][j];
+					stream->type[write] = stream->type[read+j];
+					++write;
+				}
+			}
+		}
 	}
+	stream->size = write;
 }
 
 
@@ -138,21 +303,28 @@ void ParticleSystem::Update( U32 deltaTime, U32 currentTime )
 {
 	GRINLIZ_PERFTRACK
 
-	// Process the effects (may change number of particles, etc.
+	// Process the effects (may change number of particles, etc.) Finished
+	// effects go back to their pool; the rest keep their order.
+	int nLive = 0;
 	for( int i=0; i<effectArr.Size(); ++i ) {
-		if ( !effectArr[i]->Done() ) {
-			effectArr[i]->DoTick( currentTime, deltaTime );
+		ParticleEffect* effect = effectArr[i];
+		if ( !effect->Done() ) {
+			effect->DoTick( currentTime, deltaTime );
+		}
+		if ( effect->Done() ) {
+			effectPool[effect->Type()].Push( effect );
+			effectCount[effect->Type()]--;
+		}
+		else {
+			effectArr[nLive++] = effect;
 		}
 	}
-
-	++frame;
-	Cull( (frame&1) ? &pointBuffer : &quadBuffer );	// cull one buffer / frame
-
+	effectArr.Trim( nLive );
 
 	// Process the particles.
 	float sec = (float)deltaTime / 1000.0f;
-	Process( &pointBuffer, sec, deltaTime );
-	Process( &quadBuffer, sec, deltaTime );
+	Integrate( &pointBuffer, sec );
+	Integrate( &quadBuffer, sec );
 }
 
 
@@ -176,7 +348,8 @@ void ParticleSystem::Emit(	int primitive,					// POINT or QUAD
 							const grinliz::Vector3F& vel,	// velocity
 							float velFuzz,
 							float halfWidth,
-							float velHalfWidth )
+							float velHalfWidth,
+							int priority )
 {
 	GLASSERT( primitive >= 0 && primitive < NUM_PRIMITIVES );
 	GLASSERT( type >=0 && type < 16 );
@@ -196,7 +369,12 @@ void ParticleSystem::Emit(	int primitive,					// POINT or QUAD
 		normal.Set( 0, 1, 0 );
 	}
 
+	ParticleStream* stream = (primitive==POINT) ? &pointBuffer : &quadBuffer;
+
 	for( int i=0; i<count; ++i ) {
+		if ( !Admit( *stream, priority ) )
+			continue;
+
 		switch (config) {
 			case PARTICLE_RAY:
 				velP = vel;
@@ -241,17 +419,28 @@ void ParticleSystem::Emit(	int primitive,					// POINT or QUAD
 
 		Color4F colorVelocityP = colorVelocity;
 		if ( colorVelocityP.a > -0.1f )
-			colorVelocityP.a = -0.f;	// must fade!
-
-		Particle* p = (primitive==POINT) ? pointBuffer.Push() : quadBuffer.Push();
-
-		p->pos = posP;
-		p->halfWidth = halfWidth;
-		p->velHalfWidth = velHalfWidth;
-		p->color = colP;
-		p->vel = velP;
-		p->colorVel = colorVelocityP;
-		p->type = (U8)type;
+			colorVelocityP.a = -0.1f;	// must fade!
+
+		const int n = stream->Push();
+		float** s = stream->s;
+
+		s[ParticleStream::POS_X][n] = posP.x;
+		s[ParticleStream::POS_Y][n] = posP.y;
+		s[ParticleStream::POS_Z][n] = posP.z;
+		s[ParticleStream::COLOR_R][n] = colP.r;
+		s[ParticleStream::COLOR_G][n] = colP.g;
+		s[ParticleStream::COLOR_B][n] = colP.b;
+		s[ParticleStream::COLOR_A][n] = colP.a;
+		s[ParticleStream::VEL_X][n] = velP.x;
+		s[ParticleStream::VEL_Y][n] = velP.y;
+		s[ParticleStream::VEL_Z][n] = velP.z;
+		s[ParticleStream::COLOR_VEL_R][n] = colorVelocityP.r;
+		s[ParticleStream::COLOR_VEL_G][n] = colorVelocityP.g;
+		s[ParticleStream::COLOR_VEL_B][n] = colorVelocityP.b;
+		s[ParticleStream::COLOR_VEL_A][n] = colorVelocityP.a;
+		s[ParticleStream::HALF_WIDTH][n] = halfWidth;
+		s[ParticleStream::VEL_HALF_WIDTH][n] = velHalfWidth;
+		stream->type[n] = (U8)type;
 	}
 }
 
@@ -263,10 +452,11 @@ void ParticleSystem::EmitPoint(	int count,
 								const grinliz::Vector3F& pos,	
 								float posFuzz,					
 								const grinliz::Vector3F& vel,	
-								float velFuzz )					
+								float velFuzz,
+								int priority )
 {
 	Emit( POINT, 0, count, configuration, color, colorVelocity, pos, posFuzz, 
-		  vel, velFuzz, 0.0f, 0.0f );
+		  vel, velFuzz, 0.0f, 0.0f, priority );
 }
 
 
@@ -278,10 +468,11 @@ void ParticleSystem::EmitQuad(	int type,
 								const grinliz::Vector3F& vel,	
 								float velFuzz,					
 								float halfWidth,
-								float velHalfWidth )			
+								float velHalfWidth,
+								int priority )
 {
 	Emit( QUAD, type, 1, 0, color, colorVelocity, pos, posFuzz, vel, velFuzz, 
-		  halfWidth, velHalfWidth );
+		  halfWidth, velHalfWidth, priority );
 }
 
 
@@ -290,7 +481,7 @@ void ParticleSystem::EmitOnePoint(	const Color4F& color,
 									const grinliz::Vector3F& pos )
 {
 	grinliz::Vector3F vel = { 0, 0, 0 };
-	Emit( POINT, 0, 1, PARTICLE_RAY, color, colorVelocity, pos, 0, vel, 0, 0, 0 );
+	Emit( POINT, 0, 1, PARTICLE_RAY, color, colorVelocity, pos, 0, vel, 0, 0, 0, PRIORITY_NORMAL );
 }
 
 
@@ -335,7 +526,8 @@ void ParticleSystem::EmitSmokeAndFlame( U32 delta, const Vector3F& _pos, bool fl
 					color,		colorVec,
 					pos,		0.4f,	
 					velocity,	0.3f,
-					0.5f,		0.0f );		
+					0.5f,		0.0f,
+					PRIORITY_LOW );
 		}
 	}
 	
@@ -356,7 +548,8 @@ void ParticleSystem::EmitSmokeAndFlame( U32 delta, const Vector3F& _pos, bool fl
 					color,		colorVec,
 					pos,		0.4f,	
 					velocity,	0.2f,
-					0.5f,		0.0f );		
+					0.5f,		0.0f,
+					PRIORITY_LOW );
 		}
 	}
 	
@@ -376,7 +569,8 @@ void ParticleSystem::EmitSmokeAndFlame( U32 delta, const Vector3F& _pos, bool fl
 					color,		colorVec,
 					pos,		0.05f,	
 					velocity,	0.3f,
-					0.5f,		0.0f );		
+					0.5f,		0.0f,
+					PRIORITY_LOW );
 		}
 	}
 }
@@ -387,6 +581,9 @@ void ParticleSystem::Draw( const Vector3F* eyeDir, const grinliz::BitArray<Map::
 	GRINLIZ_PERFTRACK
 
 	this->fogOfWar = fogOfWar;
+	if ( fogOfWar ) {
+		CalcFogBlocks();
+	}
 
 	if ( !pointTexture ) {
 		pointTexture = TextureManager::Instance()->GetTexture( "particleSparkle" );
@@ -407,15 +604,109 @@ void ParticleSystem::Draw( const Vector3F* eyeDir, const grinliz::BitArray<Map::
 }
 
 
+void ParticleSystem::DeviceLoss()
+{
+	streamBuffer.Destroy();
+	quadIndexBuffer.Destroy();
+}
+
+
+void ParticleSystem::CreateBuffers()
+{
+	if ( quadIndex.Empty() ) {
+		U16* index = quadIndex.PushArr( 6*MAX_QUADS );
+		for( int i=0; i<MAX_QUADS; ++i ) {
+			const U16 v = (U16)(i*4);
+			index[0] = v+0;
+			index[1] = v+1;
+			index[2] = v+2;
+			index[3] = v+0;
+			index[4] = v+2;
+			index[5] = v+3;
+			index += 6;
+		}
+	}
+	if ( GPUShader::SupportsVBOs() && !streamBuffer.IsValid() ) {
+		streamBuffer = GPUVertexBuffer::Create( 0, 0 );
+		quadIndexBuffer = GPUIndexBuffer::Create( quadIndex.Mem(), quadIndex.Size() );
+	}
+}
+
+
+void ParticleSystem::CalcFogBlocks()
+{
+	GLASSERT( fogOfWar );
+	const U32 MASK = ( 1 << FOG_BLOCK ) - 1;
+
+	for( int by=0; by<FOG_BLOCKS; ++by ) {
+		for( int bx=0; bx<FOG_BLOCKS; ++bx ) {
+			const int x = bx*FOG_BLOCK;
+			U32 any = 0;
+			U32 all = MASK;
+			for( int y=by*FOG_BLOCK; y<(by+1)*FOG_BLOCK; ++y ) {
+				U32 bits = ( fogOfWar->Access32( x, y, 0 ) >> ( x & 31 ) ) & MASK;
+				any |= bits;
+				all &= bits;
+			}
+			fogBlock[by*FOG_BLOCKS+bx] = ( all == MASK ) ? FOG_VISIBLE : ( any ? FOG_MIXED : FOG_HIDDEN );
+		}
+	}
+}
+
+
+inline bool ParticleSystem::Visible( float fx, float fz ) const
+{
+	if ( !fogOfWar )
+		return true;
+
+	const int x = (int)fx;
+	const int z = (int)fz;
+	if ( x < 0 || x >= EL_MAP_SIZE || z < 0 || z >= EL_MAP_SIZE )
+		return false;
+
+	const int block = fogBlock[(z/FOG_BLOCK)*FOG_BLOCKS + x/FOG_BLOCK];
+	if ( block != FOG_MIXED )
+		return block == FOG_VISIBLE;
+	return fogOfWar->IsSet( x, z ) != 0;
+}
+
+
+void ParticleSystem::DrawQuads( Texture* texture, const QuadVertex* vertex, int nQuads )
+{
+	if ( nQuads == 0 )
+		return;
+	GLASSERT( nQuads <= MAX_QUADS );
+	CreateBuffers();
+
+	QuadParticleShader shader;
+	shader.SetTexture0( texture );
+
+	GPUStream stream;
+	stream.stride = sizeof( vertex[0] );
+	stream.nPos = 3;
+	stream.posOffset = 0;
+	stream.nTexture0 = 2;
+	stream.texture0Offset = 12;
+	stream.nColor = 4;
+	stream.colorOffset = 20;
+
+	if ( streamBuffer.IsValid() ) {
+		streamBuffer.Stream( vertex, nQuads*4*sizeof(vertex[0]) );
+		shader.SetStream( stream, streamBuffer, nQuads*6, quadIndexBuffer );
+	}
+	else {
+		shader.SetStream( stream, vertex, nQuads*6, quadIndex.Mem() );
+	}
+	shader.Draw();
+}
+
+
 void ParticleSystem::DrawBeamParticles( const Vector3F* eyeDir )
 {
 	if ( beamBuffer.Empty() ) {
 		return;
 	}
 
-	//const static float cornerX[] = { -1, 1, 1, -1 };
-	//const static float cornerY[] = { -1, -1, 1, 1 };
-
 	// fixme: hardcoded texture coordinates
 	static const Vector2F tex[4] = {
 		{ 0.50f, 0.0f },
@@ -424,29 +715,14 @@ void ParticleSystem::DrawBeamParticles( const Vector3F* eyeDir )
 		{ 0.50f, 0.25f }
 	};
 
-	int nIndex = 0;
-	int nVertex = 0;
-
+	const int nBeam = Min( beamBuffer.Size(), (int)MAX_QUADS );
 	vertexBuffer.Clear();
-	indexBuffer.Clear();
-
-	U16* iBuf = indexBuffer.PushArr( 6*quadBuffer.Size() );
-	QuadVertex* vBuf = vertexBuffer.PushArr( 4*quadBuffer.Size() );
+	QuadVertex* vBuf = vertexBuffer.PushArr( 4*nBeam );
 
-	for( int i=0; i<beamBuffer.Size(); ++i ) 
+	for( int i=0; i<nBeam; ++i ) 
 	{
 		const Beam& b = beamBuffer[i];
-
-		// Set up the particle that everything else is derived from:
-		iBuf[nIndex++] = nVertex+0;
-		iBuf[nIndex++] = nVertex+1;
-		iBuf[nIndex++] = nVertex+2;
-
-		iBuf[nIndex++] = nVertex+0;
-		iBuf[nIndex++] = nVertex+2;
-		iBuf[nIndex++] = nVertex+3;
-
-		QuadVertex* pV = &vBuf[nVertex];
+		QuadVertex* pV = &vBuf[i*4];
 
 		const float hw = 0.1f;	//quadBuffer[i].halfWidth;
 		Vector3F n;
@@ -466,25 +742,8 @@ void ParticleSystem::DrawBeamParticles( const Vector3F* eyeDir )
 			pV->color = b.color;
 			++pV;
 		}
-		nVertex += 4;
-	}
-
-	if ( nIndex ) {
-		QuadParticleShader shader;
-		shader.SetTexture0( quadTexture );
-
-		GPUStream stream;
-		stream.stride = sizeof( vertexBuffer[0] );
-		stream.nPos = 3;
-		stream.posOffset = 0;
-		stream.nTexture0 = 2;
-		stream.texture0Offset = 12;
-		stream.nColor = 4;
-		stream.colorOffset = 20;
-
-		shader.SetStream( stream, vBuf, nIndex, iBuf );
-		shader.Draw();
 	}
+	DrawQuads( quadTexture, vBuf, nBeam );
 }
 
 
@@ -494,38 +753,54 @@ void ParticleSystem::DrawPointParticles( const Vector3F* eyeDir )
 	if ( pointBuffer.Empty() )
 		return;
 
+	float* const* s = pointBuffer.s;
+
 	if ( PointParticleShader::IsSupported() )
 	{
+		pointVertexBuffer.Clear();
+		PointVertex* pV = pointVertexBuffer.PushArr( pointBuffer.Size() );
+		int n = 0;
+		for( int i=0; i<pointBuffer.Size(); ++i ) {
+			if ( Visible( s[ParticleStream::POS_X][i], s[ParticleStream::POS_Z][i] ) ) {
+				pV[n].pos = pointBuffer.Pos( i );
+				pV[n].color = pointBuffer.Color( i );
+				++n;
+			}
+		}
+		if ( n == 0 )
+			return;
+		CreateBuffers();
+
 		PointParticleShader shader;
 
 		GPUStream stream;
-		stream.stride = sizeof(pointBuffer[0]);
+		stream.stride = sizeof(pointVertexBuffer[0]);
 		stream.nPos = 3;
 		stream.posOffset = 0;
 		stream.nColor = 4;
 		stream.colorOffset = 12;
 
-		shader.SetStream( stream, pointBuffer.Mem(), 0, 0 );
-		shader.DrawPoints( pointTexture, 4.f, 0, pointBuffer.Size() );
+		if ( streamBuffer.IsValid() ) {
+			streamBuffer.Stream( pV, n*sizeof(pV[0]) );
+			shader.SetStream( stream, streamBuffer );
+		}
+		else {
+			shader.SetStream( stream, pV, 0, 0 );
+		}
+		shader.DrawPoints( pointTexture, 4.f, 0, n );
 	}
 	else {
-		// Try to duplicate the above. Draw a bunch of little tetrahedrons so
+		// Try to duplicate the above. Draw a bunch of little quads so
 		// we don't have to worry about screen space.
 		vertexBuffer.Clear();
-		indexBuffer.Clear();
-
-		int index = 0;
-		int vertex = 0;
-
 		QuadVertex* vBuf = vertexBuffer.PushArr( 4*pointBuffer.Size() );
-		U16* iBuf = indexBuffer.PushArr( 6*pointBuffer.Size() );
 
-		QuadVertex base[4];
+		Vector3F corner[4];
 		float SIZE = 0.07f;
-		base[0].pos = -eyeDir[Camera::RIGHT]*SIZE - eyeDir[Camera::UP]*SIZE;
-		base[1].pos =  eyeDir[Camera::RIGHT]*SIZE - eyeDir[Camera::UP]*SIZE;
-		base[2].pos =  eyeDir[Camera::RIGHT]*SIZE + eyeDir[Camera::UP]*SIZE;
-		base[3].pos = -eyeDir[Camera::RIGHT]*SIZE + eyeDir[Camera::UP]*SIZE;
+		corner[0] = -eyeDir[Camera::RIGHT]*SIZE - eyeDir[Camera::UP]*SIZE;
+		corner[1] =  eyeDir[Camera::RIGHT]*SIZE - eyeDir[Camera::UP]*SIZE;
+		corner[2] =  eyeDir[Camera::RIGHT]*SIZE + eyeDir[Camera::UP]*SIZE;
+		corner[3] = -eyeDir[Camera::RIGHT]*SIZE + eyeDir[Camera::UP]*SIZE;
 
 		static const Vector2F tex[4] = {
 			{ 0.0f, 0.0f },
@@ -534,47 +809,26 @@ void ParticleSystem::DrawPointParticles( const Vector3F* eyeDir )
 			{ 0.0f, 1.0f }
 		};
 
-
+		int nQuad = 0;
 		for( int i=0; i<pointBuffer.Size(); ++i ) 
 		{
-			const Vector3F& pos = pointBuffer[i].pos;
-			const Color4F& color = pointBuffer[i].color;
-
-			// Set up the particle that everything else is derived from:
-			iBuf[index++] = vertex+0;
-			iBuf[index++] = vertex+1;
-			iBuf[index++] = vertex+2;
-
-			iBuf[index++] = vertex+0;
-			iBuf[index++] = vertex+2;
-			iBuf[index++] = vertex+3;
+			const float x = s[ParticleStream::POS_X][i];
+			const float z = s[ParticleStream::POS_Z][i];
+			if ( !Visible( x, z ) )
+				continue;
 
-			QuadVertex* pV = vBuf + vertex;
+			const float y = s[ParticleStream::POS_Y][i];
+			const Color4F color = pointBuffer.Color( i );
+			QuadVertex* pV = vBuf + nQuad*4;
 
 			for( int j=0; j<4; ++j ) {
-				pV->pos = base[j].pos + pos;
-				pV->tex = tex[j];
-				pV->color = color;
-				++pV;
+				pV[j].pos.Set( x+corner[j].x, y+corner[j].y, z+corner[j].z );
+				pV[j].tex = tex[j];
+				pV[j].color = color;
 			}
-			vertex += 4;
-		}
-
-		if ( index ) {
-			QuadParticleShader shader;
-			GPUStream stream;
-			stream.stride = sizeof( vertexBuffer[0] );
-			stream.nPos = 3;
-			stream.posOffset = 0;
-			stream.nTexture0 = 2;
-			stream.texture0Offset = 12;
-			stream.nColor = 4;
-			stream.colorOffset = 20;
-
-			shader.SetStream( stream, vBuf, index, iBuf );
-			shader.SetTexture0( TextureManager::Instance()->GetTexture( "particleSparkle" ) );
-			shader.Draw();
+			++nQuad;
 		}
+		DrawQuads( pointTexture, vBuf, nQuad );
 	}
 }
 
@@ -595,28 +849,32 @@ void ParticleSystem::DrawQuadParticles( const Vector3F* eyeDir )
 		{ 0.0f, 0.25f }
 	};
 
-	int nIndex = 0;
-	int nVertex = 0;
+	// The billboard offsets are the same for every particle, scaled by
+	// the half width.
+	Vector3F corner[4];
+	for( int j=0; j<4; ++j ) {
+		corner[j] = cornerX[j]*eyeDir[Camera::RIGHT] + cornerY[j]*eyeDir[Camera::UP];
+	}
 
 	vertexBuffer.Clear();
-	indexBuffer.Clear();
-
-	U16* iBuf = indexBuffer.PushArr( 6*quadBuffer.Size() );
 	QuadVertex* vBuf = vertexBuffer.PushArr( 4*quadBuffer.Size() );
-	Rectangle2I bounds;
-	bounds.Set( 0, 0, EL_MAP_SIZE-1, EL_MAP_SIZE-1 );
+	float* const* s = quadBuffer.s;
+	int nQuad = 0;
 
 	for( int i=0; i<quadBuffer.Size(); ++i ) 
 	{
-		const Particle& p = quadBuffer[i];
-
-		const int type	  = p.type;
+		const float x = s[ParticleStream::POS_X][i];
+		const float z = s[ParticleStream::POS_Z][i];
+		if ( !Visible( x, z ) )
+			continue;
+
+		const float y = s[ParticleStream::POS_Y][i];
+		const float hw = s[ParticleStream::HALF_WIDTH][i];
+		const int type = quadBuffer.type[i];
 		const float tx = 0.25f * (float)(type&0x03);
 		const float ty = 0.25f * (float)(type>>2);
-		
-		//const float size = particleTypeArr[QUAD].size;
-		const Vector3F& pos  = p.pos;
-		Color4F color = p.color;
+
+		Color4F color = quadBuffer.Color( i );
 
 		static const float FADE_IN = 0.95f;
 		static const float FADE_IN_INV = 1.0f / (1.0f-FADE_IN);
@@ -625,55 +883,13 @@ void ParticleSystem::DrawQuadParticles( const Vector3F* eyeDir )
 			color.a = (1.0f - color.a)*FADE_IN_INV;
 		}
 
-		if ( fogOfWar ) {
-			Vector2I fowPos = { (int)pos.x, (int)pos.z };
-
-			if (    !bounds.Contains( fowPos )
-				 || !fogOfWar->IsSet( fowPos.x, fowPos.y ) )
-			{
-				continue;
-			}
-		}
-
-		// Set up the particle that everything else is derived from:
-		iBuf[nIndex++] = nVertex+0;
-		iBuf[nIndex++] = nVertex+1;
-		iBuf[nIndex++] = nVertex+2;
-
-		iBuf[nIndex++] = nVertex+0;
-		iBuf[nIndex++] = nVertex+2;
-		iBuf[nIndex++] = nVertex+3;
-
-		QuadVertex* pV = &vBuf[nVertex];
-
-		const float hw = quadBuffer[i].halfWidth;
-
+		QuadVertex* pV = vBuf + nQuad*4;
 		for( int j=0; j<4; ++j ) {
-			pV->pos =   pos + ( cornerX[j]*eyeDir[Camera::RIGHT] + cornerY[j]*eyeDir[Camera::UP] ) * hw;
-			pV->tex.Set( tx+tex[j].x, ty+tex[j].y );
-			pV->color = color;
-			++pV;
+			pV[j].pos.Set( x+corner[j].x*hw, y+corner[j].y*hw, z+corner[j].z*hw );
+			pV[j].tex.Set( tx+tex[j].x, ty+tex[j].y );
+			pV[j].color = color;
 		}
-		nVertex += 4;
-	}
-
-	if ( nIndex ) {
-		QuadParticleShader shader;
-		shader.SetTexture0( quadTexture );
-
-		GPUStream stream;
-		stream.stride = sizeof( vertexBuffer[0] );
-		stream.nPos = 3;
-		stream.posOffset = 0;
-		stream.nTexture0 = 2;
-		stream.texture0Offset = 12;
-		stream.nColor = 4;
-		stream.colorOffset = 20;
-
-		shader.SetStream( stream, vBuf, nIndex, iBuf );
-		shader.Draw();
+		++nQuad;
 	}
+	DrawQuads( quadTexture, vBuf, nQuad );
 }
-
-
-
@@ -22,9 +22,20 @@
 #include "vertex.h"
 #include "ufoutil.h"
 #include "map.h"
+#include "gpustatemanager.h"
+#include "particleeffect.h"
 
 class Texture;
-class ParticleEffect;
+
+struct ParticleStats
+{
+	int nPoints;		// live particles
+	int nQuads;
+	int nThrottled;		// emissions skipped to stay under the budget, since Clear()
+	int nDropped;		// emissions lost at a full budget, since Clear()
+	int nEffects;		// live effects
+	int nEffectsTaken;	// live effects taken over at a cap, since Clear()
+};
 
 /*	Class to render all sorts of particle effects.
 */
@@ -60,6 +71,15 @@ public:
 		PARTICLE_SPHERE,
 	};
 
+	// As a buffer fills, low priority emission is thinned first. High
+	// priority is only refused when the buffer is full.
+	enum {
+		PRIORITY_LOW,		// ambient: map fire, smoke
+		PRIORITY_NORMAL,
+		PRIORITY_HIGH,		// gameplay feedback
+		NUM_PRIORITIES
+	};
+
 
 	// Emit N point particles.
 	void EmitPoint(	int count,						// number of particles to create
@@ -69,7 +89,8 @@ public:
 					const grinliz::Vector3F& pos,	// origin
 					float posFuzz,					// fuzz in the position
 					const grinliz::Vector3F& vel,	// velocity
-					float velFuzz );					// fuzz in the velocity
+					float velFuzz,					// fuzz in the velocity
+					int priority=PRIORITY_NORMAL );
 
 	// Emit one quad particle.
 	void EmitQuad(	int type,						// FIRE, SMOKE
@@ -80,7 +101,8 @@ public:
 					const grinliz::Vector3F& vel,	// velocity
 					float velFuzz,					// fuzz in the velocity
 					float halfWidth,				// 1/2 size of the particle
-					float velHalfWidth );				// rate of change of the 1/2 size
+					float velHalfWidth,				// rate of change of the 1/2 size
+					int priority=PRIORITY_NORMAL );
 
 	// Simple call to emit a point at a location.
 	void EmitOnePoint(	const grinliz::Color4F& color, 
@@ -97,10 +119,17 @@ public:
 	void Update( U32 deltaTime, U32 currentTime );
 	void Draw( const grinliz::Vector3F* eyeDir, const grinliz::BitArray<Map::SIZE, Map::SIZE, 1>* fogOfWar );
 	void Clear();
+	// Frees the GPU buffers; they are re-created on the next Draw().
+	void DeviceLoss();
 
-	void AddEffect( ParticleEffect* effect );
-	// Not a "real" factory - can return 0. But re-uses when possible.
-	ParticleEffect* EffectFactory( const char* name );
+	const ParticleStats& Stats();
+
+	// Returns a cleared effect of a type (ParticleEffect::BOLT, etc.) from its
+	// pool, already live. If the type is at its cap, the oldest live effect of
+	// the type is taken over. Set it up before the next Update().
+	ParticleEffect* AllocEffect( int type );
+	// Most live effects of a type.
+	void SetEffectCap( int type, int cap );
 
 private:
 	ParticleSystem();
@@ -108,27 +137,44 @@ private:
 
 	static ParticleSystem* instance;
 
-	struct Particle
+	// Particles are stored as separate float streams (structure of arrays)
+	// so they can be integrated 4 at a time. The capacity is fixed: it is
+	// the particle budget.
+	struct ParticleStream
+	{
+		enum {
+			POS_X, POS_Y, POS_Z,
+			COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+			VEL_X, VEL_Y, VEL_Z,					// units / second
+			COLOR_VEL_R, COLOR_VEL_G, COLOR_VEL_B, COLOR_VEL_A,
+			HALF_WIDTH,								// for rays and quads
+			VEL_HALF_WIDTH,							// for quads
+			NUM_STREAMS
+		};
+
+		ParticleStream( int capacity );
+		~ParticleStream();
+
+		int Size() const		{ return size; }
+		int Capacity() const	{ return capacity; }
+		bool Empty() const		{ return size == 0; }
+		void Clear()			{ size = 0; }
+		int Push()				{ GLASSERT( size < capacity ); return size++; }
+
+		grinliz::Vector3F Pos( int i ) const	{ grinliz::Vector3F v = { s[POS_X][i], s[POS_Y][i], s[POS_Z][i] }; return v; }
+		grinliz::Color4F Color( int i ) const	{ grinliz::Color4F c = { s[COLOR_R][i], s[COLOR_G][i], s[COLOR_B][i], s[COLOR_A][i] }; return c; }
+
+		float*	s[NUM_STREAMS];	// 16 byte aligned, padded to a multiple of 4
+		U8*		type;
+		int		size;
+		int		capacity;
+		void*	mem;
+	};
+
+	struct PointVertex
 	{
-		// streamed to GL
-		grinliz::Vector3F	pos;		
-		grinliz::Color4F				color;
-
-		// extra data
-		grinliz::Vector3F vel;			// units / second
-		grinliz::Color4F  colorVel;		// units / second
-		float			  halfWidth;	// for rays and quads
-		float			  velHalfWidth;	// for quads
-		U8				  type;	
-
-		void Process( float sec, unsigned msec ) {
-			pos			+= vel*sec;
-			color.r		= color.r + colorVel.r*sec;
-			color.g		= color.g + colorVel.g*sec;
-			color.b		= color.b + colorVel.b*sec;
-			color.a		= color.a + colorVel.a*sec;
-			halfWidth	+= velHalfWidth*sec;
-		}
+		grinliz::Vector3F	pos;
+		grinliz::Color4F	color;
 	};
 
 	struct QuadVertex
@@ -145,6 +191,16 @@ private:
 		grinliz::Color4F	color;	
 	};
 
+	enum {
+		// Most quads in one draw. Every particle can become a quad.
+		MAX_QUADS	= EL_MAX_POINT_PARTICLES > EL_MAX_QUAD_PARTICLES ? EL_MAX_POINT_PARTICLES : EL_MAX_QUAD_PARTICLES,
+		FOG_BLOCK	= 8,						// map cells on a side of a fog block
+		FOG_BLOCKS	= EL_MAP_SIZE / FOG_BLOCK,	// fog blocks on a side of the map
+		FOG_HIDDEN	= 0,
+		FOG_VISIBLE,
+		FOG_MIXED
+	};
+
 	// General do-all for emmitting all kinds of particles (except decals.)
 	void Emit(	int primitive,					// POINT or QUAD
 				int type,						// FIRE, SMOKE, BEAM (location in the texture)
@@ -157,33 +213,54 @@ private:
 				const grinliz::Vector3F& vel,	// velocity
 				float velFuzz,					// fuzz in the velocity
 				float halfWidth,				// half width of beams and quads
-				float velHalfWidth );			// rate of change of the width
+				float velHalfWidth,				// rate of change of the width
+				int priority );
 
 	void DrawPointParticles( const grinliz::Vector3F* eyeDir );
 	void DrawQuadParticles( const grinliz::Vector3F* eyeDir );
 	void DrawBeamParticles( const grinliz::Vector3F* eyeDir );
+	// Draws 4 vertices per quad with the shared quad indices.
+	void DrawQuads( Texture* texture, const QuadVertex* vertex, int nQuads );
+	void CreateBuffers();
+
+	// Sorts the fog of war blocks into hidden, visible, and mixed, so
+	// most particles are culled without a per-cell test.
+	void CalcFogBlocks();
+	inline bool Visible( float x, float z ) const;
 	void EmitSmokeAndFlame( U32 delta, const grinliz::Vector3F& pos, bool flame );
-	void RemoveOldParticles( int primitive );
 	int NumParticles( int type ) { return type == POINT ? pointBuffer.Size() : quadBuffer.Size(); };
-	
-	void Cull( CDynArray<Particle>* );
-	void Process( CDynArray<Particle>*, float time, unsigned msec );
+
+	// Returns false if a particle of this priority should be skipped to
+	// stay in the budget.
+	bool Admit( const ParticleStream& stream, int priority );
+	// Moves the particles forward by 'sec' and removes the ones that have
+	// faded out, in one pass.
+	void Integrate( ParticleStream* stream, float sec );
 
 	grinliz::Random rand;
 
 	Texture* quadTexture;
 	Texture* pointTexture;
-	int frame;
+	ParticleStats stats;
 
-	CDynArray<ParticleEffect*>							effectArr;
+	CDynArray<ParticleEffect*>							effectArr;		// live effects, oldest first
+	CDynArray<ParticleEffect*>							effectPool[ParticleEffect::NUM_TYPES];
+	int													effectCap[ParticleEffect::NUM_TYPES];
+	int													effectCount[ParticleEffect::NUM_TYPES];	// handed out and not yet finished
 	const grinliz::BitArray<Map::SIZE, Map::SIZE, 1>*	fogOfWar;
-	CDynArray<Particle>									pointBuffer;
-	CDynArray<Particle>									quadBuffer;
+	ParticleStream										pointBuffer;
+	ParticleStream										quadBuffer;
 	CDynArray<Beam>										beamBuffer;
 
-	// When we don't have point sprites:
+	U8													fogBlock[FOG_BLOCKS*FOG_BLOCKS];
+
+	// Point sprites are streamed interleaved.
+	CDynArray<PointVertex>								pointVertexBuffer;
+	// Quads, beams, and points without point sprites:
 	CDynArray<QuadVertex>								vertexBuffer;
-	CDynArray<U16>										indexBuffer;
+	CDynArray<U16>										quadIndex;			// 0,1,2, 0,2,3 for MAX_QUADS; never changes
+	GPUIndexBuffer										quadIndexBuffer;	// quadIndex, if there are VBOs
+	GPUVertexBuffer										streamBuffer;		// re-filled by each draw, if there are VBOs
 };
 
 #endif // UFOTACTICAL_PARTICLE_INCLUDED
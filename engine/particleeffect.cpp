@@ -19,7 +19,7 @@
 using namespace grinliz;
 
 
-BoltEffect::BoltEffect( ParticleSystem* system ) : ParticleEffect( system )
+BoltEffect::BoltEffect( ParticleSystem* system ) : ParticleEffect( system, BOLT )
 {
 	Clear();
 }
@@ -141,7 +141,7 @@ const char* BoltEffect::Name()
 }
 
 
-ImpactEffect::ImpactEffect( ParticleSystem* system ) : ParticleEffect( system )
+ImpactEffect::ImpactEffect( ParticleSystem* system ) : ParticleEffect( system, IMPACT )
 {
 	Clear();
 }
@@ -205,7 +205,7 @@ const char* ImpactEffect::Name()
 }
 
 
-SmokeTrailEffect::SmokeTrailEffect( ParticleSystem* system ) : ParticleEffect( system )
+SmokeTrailEffect::SmokeTrailEffect( ParticleSystem* system ) : ParticleEffect( system, SMOKE_TRAIL )
 {
 	Clear();
 }
@@ -284,7 +284,7 @@ const char* SmokeTrailEffect::Name()
 }
 
 
-RingEffect::RingEffect( ParticleSystem* system ) : ParticleEffect( system )
+RingEffect::RingEffect( ParticleSystem* system ) : ParticleEffect( system, RING )
 {
 	Clear();
 }
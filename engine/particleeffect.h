@@ -31,11 +31,22 @@ class ParticleSystem;
 class ParticleEffect
 {
 public:
-	ParticleEffect( ParticleSystem* system ) 
-		: particleSystem( system ) 			
+	// Each type has its own pool and cap in the ParticleSystem.
+	enum {
+		BOLT,
+		IMPACT,
+		SMOKE_TRAIL,
+		RING,
+		NUM_TYPES
+	};
+
+	ParticleEffect( ParticleSystem* system, int _type ) 
+		: particleSystem( system ), type( _type )
 	{}
 	virtual ~ParticleEffect()	{}
 
+	int Type() const			{ return type; }
+
 	virtual bool Done() = 0;
 	virtual void DoTick( U32 time, U32 deltaTime ) = 0;
 	virtual void Draw( const grinliz::Vector3F* eyeDir ) {}	// mostly particles are created in DoTick; however, if the Effect actually draws, do it here.
@@ -45,6 +56,9 @@ public:
 
 protected:
 	ParticleSystem* particleSystem;
+
+private:
+	int type;
 };
 
 class BoltEffect : public ParticleEffect
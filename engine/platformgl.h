@@ -18,7 +18,18 @@
 
 #include "../grinliz/gldebug.h"
 
-#if defined (__MOBILE__)
+#if defined (XENOENGINE_NULL_GL)
+	// Records the GL calls instead of rendering. See nullgl.h.
+	#include "nullgl.h"
+
+	#define glFrustumfX		glFrustum
+	#define glOrthofX		glOrtho
+	#define glGenBuffersX	glGenBuffers
+	#define glBindBufferX	glBindBuffer
+	#define glBufferDataX	glBufferData
+	#define glBufferSubDataX	glBufferSubData
+	#define glDeleteBuffersX	glDeleteBuffers
+#elif defined (__MOBILE__)
 #if defined (__APPLE__)
 	#include <OpenGLES/ES1/gl.h>
 	#include <OpenGLES/ES1/glext.h>
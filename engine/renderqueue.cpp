@@ -24,8 +24,12 @@ using namespace grinliz;
 
 RenderQueue::RenderQueue()
 {
-	nState = 0;
-	nItem = 0;
+	eye.Zero();
+	sorted = false;
+	nStates = 0;
+	nRadixPasses = 0;
+	nLimitHits = 0;
+	sortedKeys = 0;
 
 	vertexCacheSize = 0;
 	vertexCacheCap = 0;
@@ -38,102 +42,141 @@ RenderQueue::~RenderQueue()
 }
 
 
-RenderQueue::State* RenderQueue::FindState( const State& state )
+void RenderQueue::Clear()
 {
-	int low = 0;
-	int high = nState - 1;
-	int answer = -1;
-	int mid = 0;
-	int insert = 0;		// Where to put the new state. 
-
-	while (low <= high) {
-		mid = low + (high - low) / 2;
-		int compare = Compare( statePool[mid], state );
-
-		if (compare > 0) {
-			high = mid - 1;
-		}
-		else if ( compare < 0) {
-			insert = mid;	// since we know the mid is less than the state we want to add,
-							// we can move insert up at least to that index.
-			low = mid + 1;
-		}
-		else {
-           answer = mid;
-		   break;
-		}
-	}
-	if ( answer >= 0 ) {
-		return &statePool[answer];
-	}
-	if ( nState == MAX_STATE ) {
-		return 0;
+	items.Clear();
+	keys.Clear();
+	shaders.Clear();
+	sorted = false;
+	sortedKeys = 0;
+	nStates = 0;
+	nRadixPasses = 0;
+	nLimitHits = 0;
+}
+
+
+void RenderQueue::QueryStats( RenderQueueStats* stats ) const
+{
+	stats->nItems = items.Size();
+	stats->nStates = nStates;
+	stats->nRadixPasses = nRadixPasses;
+	stats->nLimitHits = nLimitHits;
+}
+
+
+int RenderQueue::ShaderSlot( GPUShader* shader )
+{
+	// Only a handful of shaders are used in a frame, and they tend
+	// to be added in runs. Check the last one first.
+	int n = shaders.Size();
+	if ( n && shaders[n-1] == shader )
+		return n-1;
+	for( int i=0; i<n; ++i ) {
+		if ( shaders[i] == shader )
+			return i;
 	}
+	if ( n == MAX_SHADERS )
+		return NO_SLOT;
+	shaders.Push( shader );
+	return n;
+}
 
-	if ( nState == 0 ) {
-		insert = 0;
+
+void RenderQueue::Add( Model* model, const ModelAtom* atom, GPUShader* shader, const grinliz::Matrix4* textureXForm, Texture* replaceAllTextures )
+{
+	GLASSERT( shader );
+	Item* item = items.Push();
+	item->model = model;
+	item->atom = atom;
+	item->shader = shader;
+	item->texture = replaceAllTextures ? replaceAllTextures : atom->texture;
+	item->textureXForm = textureXForm;
+
+	int shaderSlot = ShaderSlot( shader );
+	int textureSlot = TextureManager::Instance()->TextureIndex( item->texture );
+	if ( textureSlot < 0 || textureSlot >= NO_SLOT ) {
+		textureSlot = NO_SLOT;
+		++nLimitHits;
 	}
-	else {
-		while (    insert < nState
-			    && Compare( statePool[insert], state ) < 0 ) 
-		{
-			++insert;
-		}
+	else if ( shaderSlot == NO_SLOT ) {
+		++nLimitHits;
 	}
 
-	// move up
-	for( int i=nState; i>insert; --i ) {
-		statePool[i] = statePool[i-1];
+	// Squared distance is fine for ordering. 1/4 unit resolution 
+	// at the eye, out to 128 units.
+	const int sortOrder = shader->SortOrder();
+	int depth = (int)( ( model->Pos() - eye ).LengthSquared() * 4.0f );
+	if ( depth > DEPTH_MASK ) {
+		depth = DEPTH_MASK;
+		++nLimitHits;
 	}
-	// and insert
-	statePool[insert] = state;
-	statePool[insert].root = 0;
-	nState++;
-
-#ifdef DEBUG
-	for( int i=0; i<nState-1; ++i ) {
-		//GLOUTPUT(( " %d:%d:%x", statePool[i].state.flags, statePool[i].state.textureID, statePool[i].state.atom ));
-		GLASSERT( Compare( statePool[i], statePool[i+1] ) < 0 );
+	if ( sortOrder == 2 ) {
+		// Blending goes back to front.
+		depth = DEPTH_MASK - depth;
 	}
-	//GLOUTPUT(( "\n" ));
-#endif
 
-	return &statePool[insert];
+	SortKey* k = keys.Push();
+	k->key =   ( (U64)sortOrder << SORT_SHIFT )
+			 | ( (U64)shaderSlot << SHADER_SHIFT )
+			 | ( (U64)textureSlot << TEXTURE_SHIFT )
+			 | ( (U64)depth << DEPTH_SHIFT );
+	k->index = items.Size() - 1;
+	sorted = false;
 }
 
 
-void RenderQueue::Add( Model* model, const ModelAtom* atom, GPUShader* shader, const grinliz::Matrix4* textureXForm, Texture* replaceAllTextures )
+void RenderQueue::Sort()
 {
-	if ( nItem == MAX_ITEMS ) {
-		GLASSERT( 0 );
-		return;
-	}
+	GRINLIZ_PERFTRACK
 
-	State s0 = { shader, replaceAllTextures ? replaceAllTextures : atom->texture, 0 };
+	const int n = keys.Size();
+	nRadixPasses = 0;
+	nStates = 0;
 
-	State* state = FindState( s0 );
-	if ( !state ) {
-		GLASSERT( 0 );
-		return;
+	// Only the bytes that differ between keys need a pass.
+	U64 keyOr = 0;
+	U64 keyAnd = ~((U64)0);
+	for( int i=0; i<n; ++i ) {
+		keyOr |= keys[i].key;
+		keyAnd &= keys[i].key;
 	}
-
-	Item* item = &itemPool[nItem++];
-	item->model = model;
-	item->atom = atom;
-	
-	item->atomIndex = -1;
-	const ModelResource* resource = model->GetResource();
-	for( int i=0; i<resource->header.nGroups; ++i ) {
-		if ( &resource->atom[i] == atom ) {
-			item->atomIndex = i;
-			break;
+	const U64 diff = keyOr ^ keyAnd;
+
+	keyScratch.Clear();
+	keyScratch.PushArr( n );
+	SortKey* src = keys.Mem();
+	SortKey* dst = keyScratch.Mem();
+
+	// LSD radix sort, a byte at a time. Each pass is stable.
+	for( int shift=0; shift<64; shift+=8 ) {
+		if ( ((diff >> shift) & 0xff) == 0 )
+			continue;
+
+		int offset[256];
+		memset( offset, 0, sizeof(offset) );
+		for( int i=0; i<n; ++i ) {
+			offset[ (src[i].key >> shift) & 0xff ] += 1;
+		}
+		int total = 0;
+		for( int i=0; i<256; ++i ) {
+			int c = offset[i];
+			offset[i] = total;
+			total += c;
 		}
+		for( int i=0; i<n; ++i ) {
+			dst[ offset[ (src[i].key >> shift) & 0xff ]++ ] = src[i];
+		}
+		Swap( &src, &dst );
+		++nRadixPasses;
 	}
-	GLASSERT( item->atomIndex >= 0 );
+	sortedKeys = src;
+	sorted = true;
 
-	item->textureXForm = textureXForm;
-	item->next  = state->root;
-	state->root = item;
+	static const U64 STATE_MASK = ~( (U64)DEPTH_MASK << DEPTH_SHIFT );
+	for( int i=0; i<n; ++i ) {
+		if ( i == 0 || (sortedKeys[i].key & STATE_MASK) != (sortedKeys[i-1].key & STATE_MASK) )
+			++nStates;
+	}
 }
 
 
@@ -151,71 +194,76 @@ void RenderQueue::Submit( GPUShader* overRideShader, int mode, int required, int
 	}
 #endif
 
-	for( int i=0; i<nState; ++i ) {
-		indexBuf.Clear();
-		GPUShader* shader = overRideShader ? overRideShader : statePool[i].shader;
+	if ( !sorted ) {
+		Sort();
+	}
+
+	GPUShader* current = 0;
+	Texture* currentTexture = 0;
 
-		for( Item* item = statePool[i].root; item; item=item->next ) 
+	for( int i=0; i<items.Size(); ++i ) {
+		const Item* item = &items[ sortedKeys[i].index ];
+		Model* model = item->model;
+		GLASSERT( model );
+		int modelFlags = model->Flags();
+
+		if (    ( (required & modelFlags) == required)
+			 && ( (excluded & modelFlags) == 0 ) )
 		{
-			Model* model = item->model;
-			int modelFlags = model->Flags();
-
-			if (    ( (required & modelFlags) == required)
-				 && ( (excluded & modelFlags) == 0 ) )
-			{
-				//GRINLIZ_PERFTRACK_NAME( "Submit Inner" )
-				if ( !overRideShader ) {
-					//GLASSERT( statePool[i].texture == item->atom->texture );
-					shader->SetTexture0( statePool[i].texture );
+			GPUShader* shader = overRideShader ? overRideShader : item->shader;
+			if ( !overRideShader ) {
+				// The items are grouped by shader and texture; only
+				// set the texture when the run changes.
+				if ( shader != current || item->texture != currentTexture ) {
+					shader->SetTexture0( item->texture );
+					current = shader;
+					currentTexture = item->texture;
 				}
+			}
+
+			if ( mode & MODE_PLANAR_SHADOW ) {
+				//GRINLIZ_PERFTRACK_NAME( "Submit Inner-1" )
+				GLASSERT( shader );
+				item->atom->BindPlanarShadow( shader );
 
-				Model* model = item->model;
-				GLASSERT( model );
+				// Push the xform matrix to the texture and the model view.
+				shader->PushTextureMatrix( 3 );
+				shader->MultTextureMatrix( 3, model->XForm() );
 
-				if ( mode & MODE_PLANAR_SHADOW ) {
-					//GRINLIZ_PERFTRACK_NAME( "Submit Inner-1" )
-					GLASSERT( shader );
-					item->atom->BindPlanarShadow( shader );
+				shader->PushMatrix( GPUShader::MODELVIEW_MATRIX );
+				shader->MultMatrix( GPUShader::MODELVIEW_MATRIX, model->XForm() );
 
-					// Push the xform matrix to the texture and the model view.
-					shader->PushTextureMatrix( 3 );
-					shader->MultTextureMatrix( 3, model->XForm() );
+				shader->Draw();
 
-					shader->PushMatrix( GPUShader::MODELVIEW_MATRIX );
-					shader->MultMatrix( GPUShader::MODELVIEW_MATRIX, model->XForm() );
+				// Unravel all that.
+				shader->PopTextureMatrix( 3 );
+				shader->PopMatrix( GPUShader::MODELVIEW_MATRIX );
+			}
+			else {
+				//GRINLIZ_PERFTRACK_NAME( "Submit Inner-2" )
+				item->atom->Bind( shader );
+
+				shader->PushMatrix( GPUShader::MODELVIEW_MATRIX );
+				shader->MultMatrix( GPUShader::MODELVIEW_MATRIX, model->XForm() );
+
+				if ( item->textureXForm ) {
+					shader->PushTextureMatrix( 1 );
+					shader->MultTextureMatrix( 1, *item->textureXForm );
+				}
+				
+				if ( shader->HasTexture1() ) {
+					shader->PushTextureMatrix( 2 );
+					shader->MultTextureMatrix( 2, model->XForm() );
+				}
 
-					shader->Draw();
+				shader->Draw();
 
-					// Unravel all that.
-					shader->PopTextureMatrix( 3 );
-					shader->PopMatrix( GPUShader::MODELVIEW_MATRIX );
+				shader->PopMatrix( GPUShader::MODELVIEW_MATRIX );
+				if ( item->textureXForm ) {
+					shader->PopTextureMatrix( 1 );
 				}
-				else {
-					//GRINLIZ_PERFTRACK_NAME( "Submit Inner-2" )
-					item->atom->Bind( shader );
-
-					shader->PushMatrix( GPUShader::MODELVIEW_MATRIX );
-					shader->MultMatrix( GPUShader::MODELVIEW_MATRIX, model->XForm() );
-
-					if ( item->textureXForm ) {
-						shader->PushTextureMatrix( 1 );
-						shader->MultTextureMatrix( 1, *item->textureXForm );
-					}
-					
-					if ( shader->HasTexture1() ) {
-						shader->PushTextureMatrix( 2 );
-						shader->MultTextureMatrix( 2, model->XForm() );
-					}
-
-					shader->Draw();
-
-					shader->PopMatrix( GPUShader::MODELVIEW_MATRIX );
-					if ( item->textureXForm ) {
-						shader->PopTextureMatrix( 1 );
-					}
-					if (  shader->HasTexture1() ) {
-						shader->PopTextureMatrix( 2 );
-					}
+				if (  shader->HasTexture1() ) {
+					shader->PopTextureMatrix( 2 );
 				}
 			}
 		}
@@ -33,20 +33,41 @@ class Texture;
 	and 2) texture. In general I question this for tile based GPUs, but it's better to start
 	with a queue architecture rather than have to retrofit later.
 
-	RenderQueue queues up everything to be rendered. Flush() commits, and should be called 
-	at the end of the render pass. Flush() may also be called automatically if the queues 
-	are full.
+	RenderQueue queues up everything to be rendered; Submit() draws it. Each item gets a
+	64 bit sort key:
+		bits 56-63	shader SortOrder() (opaque, alpha test, blend)
+		bits 48-55	shader, in the order first seen this frame
+		bits 40-47	texture, by its TextureManager slot
+		bits 24-39	distance from the eye: front to back, or back to front for blending
+	The items are radix sorted on the key once per frame, at the first Submit(), so a
+	run of items with the same shader and texture is drawn with one state change.
+
+	The queue grows as needed. The key fields do not: a shader past MAX_SHADERS, a
+	texture the TextureManager doesn't own, or a distance past the depth range all
+	still draw correctly, but sort together. Those are counted in the stats.
 */
+struct RenderQueueStats
+{
+	int nItems;			// atoms queued
+	int nStates;		// distinct shader and texture runs
+	int nRadixPasses;	// passes the sort needed (key bytes that differed)
+	int nLimitHits;		// items whose key fields were clamped
+};
+
+
 class RenderQueue
 {
 public:
 	enum {
-		MAX_STATE  = 128,
-		MAX_ITEMS  = 1024,
+		MAX_SHADERS	= 255		// shader slots in the sort key. Slot 255 is the overflow.
 	};
 
 	RenderQueue();
 	~RenderQueue();
+
+	// Where the camera is. Set before the models are added, for the depth sort.
+	void SetEye( const grinliz::Vector3F& eye )	{ this->eye = eye; }
+
 	void Add(	Model* model,					// Can be chaned: billboard rotation will be set.
 				const ModelAtom* atom, 
 				GPUShader* shader,
@@ -59,43 +80,49 @@ public:
 
 	/* If a shader is passed it, it will override the shader set by the Add. */
 	void Submit( GPUShader* shader, int mode, int required, int excluded );
-	bool Empty() { return nState == 0 && nItem == 0; }
-	void Clear() { nState = 0; nItem = 0; }
+	bool Empty() const		{ return items.Empty(); }
+	void Clear();
+
+	// Work from the current frame. (Call before Clear.)
+	void QueryStats( RenderQueueStats* stats ) const;
 
 private:
 	struct Item {
 		Model*					model;
 		const ModelAtom*		atom;
-		int						atomIndex;
+		GPUShader*				shader;
+		Texture*				texture;
 		const grinliz::Matrix4*	textureXForm;
-		Item*					next;
 	};
 
-	struct State {
-		GPUShader*			shader;
-		Texture*			texture;
-		Item*				root;
+	struct SortKey {
+		U64		key;
+		int		index;		// into items
 	};
 
-	static int Compare( const State& s0, const State& s1 ) 
-	{
-		if ( s0.shader == s1.shader ) {
-			if ( s0.texture == s1.texture )
-				return 0;
-			return ( s0.texture < s1.texture ) ? -1 : 1;
-		}
-		if ( s0.shader->SortOrder() == s1.shader->SortOrder() ) {
-			return s0.shader < s1.shader ? -1 : 1;
-		}
-		return s0.shader->SortOrder() - s1.shader->SortOrder();
-	}
+	enum {
+		SORT_SHIFT		= 56,
+		SHADER_SHIFT	= 48,
+		TEXTURE_SHIFT	= 40,
+		DEPTH_SHIFT		= 24,
+		DEPTH_MASK		= 0xffff,
+		NO_SLOT			= 0xff
+	};
 
-	//void CacheAtom( Model* model, int atomIndex );
+	int ShaderSlot( GPUShader* shader );
+	void Sort();
 
-	State* FindState( const State& state );
+	grinliz::Vector3F	eye;
+	bool				sorted;
+	int					nStates;
+	int					nRadixPasses;
+	int					nLimitHits;
 
-	int nState;
-	int nItem;
+	CDynArray<Item>		items;
+	CDynArray<SortKey>	keys;
+	CDynArray<SortKey>	keyScratch;
+	const SortKey*		sortedKeys;		// points into 'keys' or 'keyScratch' after Sort()
+	CArray<GPUShader*, MAX_SHADERS> shaders;
 
 	GPUVertexBuffer vertexCache;
 	int vertexCacheSize;
@@ -103,9 +130,6 @@ private:
 
 	CDynArray<Vertex> vertexBuf;
 	CDynArray<U16>    indexBuf;
-
-	State statePool[MAX_STATE];
-	Item itemPool[MAX_ITEMS];
 };
 
 
@@ -47,8 +47,6 @@ UFOText::UFOText( const gamedb::Reader* database, Texture* texture, Screenport*
 
 	memset( metricCache, 0, sizeof(Metric)*CHAR_RANGE );
 	memset( kerningCache, 100, CHAR_RANGE*CHAR_RANGE );
-	memset( vBuf, 0, sizeof(PTVertex2)*BUF_SIZE*4 );
-	memset( iBuf, 0, sizeof(U16)*BUF_SIZE*6 );
 
 	const gamedb::Item* fontItem = database->Root()->Child( "data" )
 												   ->Child( "fonts" )
@@ -61,6 +59,8 @@ UFOText::UFOText( const gamedb::Reader* database, Texture* texture, Screenport*
 	texWidthInv = 1.0f / (float)commonItem->GetInt( "scaleW" );
 	texHeight = (float)commonItem->GetInt( "scaleH" );
 	texHeightInv = 1.0f / texHeight;
+
+	BuildGlyphTable();
 }
 
 
@@ -185,82 +185,96 @@ void UFOText::Metrics(	int c, int cPrev,
 }
 
 
-void UFOText::TextOut( GPUShader* shader, const char* str, int _x, int _y, int _h, int* w )
+void UFOText::BuildGlyphTable()
 {
-	bool rendering = true;
-	float x = (float)_x;
-	float y = (float)_y;
-	float h = (float)_h;
-
-	if ( w ) {
-		*w = 0;
-		rendering = false;
+	for( int c=CHAR_OFFSET; c<END_CHAR; ++c ) {
+		Metrics( c, 0, fontSize, &glyphTable[ MetricIndex( c ) ] );
 	}
+}
 
-	GLASSERT( !rendering || shader );
-
-	if ( rendering ) {
-		if ( iBuf[1] == 0 ) {
-			// not initialized
-			for( int pos=0; pos<BUF_SIZE; ++pos ) {
-				iBuf[pos*6+0] = pos*4 + 0;
-				iBuf[pos*6+1] = pos*4 + 2;
-				iBuf[pos*6+2] = pos*4 + 1;
-				iBuf[pos*6+3] = pos*4 + 0;
-				iBuf[pos*6+4] = pos*4 + 3;
-				iBuf[pos*6+5] = pos*4 + 2;
-			}
-		}
-	}
 
-	int pos = 0;
+void UFOText::TextOut( const char* str, int _x, int _y, int _h )
+{
+	float x = (float)_x;
+	const float y = (float)_y;
+	const float h = (float)_h;
+	const float scale = h / fontSize;
+
 	while( *str )
 	{
-		// Draw a glyph or nothing, at this point:
-		GLASSERT( pos < BUF_SIZE );
+		int c = *str;
+		if ( c < 0 ) c += 256;
 
 		gamui::IGamuiText::GlyphMetrics metric;
-		Metrics( *str, 0, (float)h, &metric );
-
-		if ( rendering ) {
-			vBuf[pos*4+0].tex.Set( metric.tx0, metric.ty0 );
-			vBuf[pos*4+1].tex.Set( metric.tx1, metric.ty0 );
-			vBuf[pos*4+2].tex.Set( metric.tx1, metric.ty1 );
-			vBuf[pos*4+3].tex.Set( metric.tx0, metric.ty1 );
-
-			vBuf[pos*4+0].pos.Set( (float)x+metric.x,			(float)y+metric.y );	
-			vBuf[pos*4+1].pos.Set( (float)x+metric.x+metric.w,	(float)y+metric.y );	
-			vBuf[pos*4+2].pos.Set( (float)x+metric.x+metric.w,	(float)y+metric.y+metric.h );	
-			vBuf[pos*4+3].pos.Set( (float)x+metric.x,			(float)y+metric.y+metric.h );				
+		const gamui::IGamuiText::GlyphMetrics* m = &metric;
+		float s = 1.0f;
+
+		if ( c >= CHAR_OFFSET && c < END_CHAR ) {
+			m = &glyphTable[ MetricIndex( c ) ];
+			s = scale;
+		}
+		else {
+			Metrics( c, 0, h, &metric );
 		}
-		x += metric.advance;
-		++pos;
-
-		if ( rendering ) {
-			if ( pos == BUF_SIZE || *(str+1) == 0 ) {
-				if ( pos > 0 ) {
-					GPUStream stream( vBuf );
-					shader->SetStream( stream, vBuf, pos*6, iBuf );
-					shader->SetTexture0( texture );
-
-					shader->Draw();
-					pos = 0;
-				}
+
+		// Blanks only advance.
+		if ( m->w > 0 ) {
+			if ( batchVertex.Size() == MAX_BATCH*4 ) {
+				Flush();
 			}
+			const float x0 = x + m->x*s;
+			const float x1 = x0 + m->w*s;
+			const float y0 = y + m->y*s;
+			const float y1 = y0 + m->h*s;
+
+			PTVertex2* v = batchVertex.PushArr( 4 );
+			v[0].tex.Set( m->tx0, m->ty0 );
+			v[1].tex.Set( m->tx1, m->ty0 );
+			v[2].tex.Set( m->tx1, m->ty1 );
+			v[3].tex.Set( m->tx0, m->ty1 );
+
+			v[0].pos.Set( x0, y0 );
+			v[1].pos.Set( x1, y0 );
+			v[2].pos.Set( x1, y1 );
+			v[3].pos.Set( x0, y1 );
 		}
+		x += m->advance*s;
 		++str;
 	}
-	if ( w ) {
-		*w = int(x+0.5f) - _x;
-	}
 }
 
 
-void UFOText::Draw( int x, int y, const char* format, ... )
+void UFOText::Flush()
 {
+	if ( batchVertex.Empty() )
+		return;
+
+	const int nGlyph = batchVertex.Size() / 4;
+	while ( batchIndex.Size() < nGlyph*6 ) {
+		const U16 base = (U16)( batchIndex.Size() / 6 * 4 );
+		U16* index = batchIndex.PushArr( 6 );
+		index[0] = base + 0;
+		index[1] = base + 2;
+		index[2] = base + 1;
+		index[3] = base + 0;
+		index[4] = base + 3;
+		index[5] = base + 2;
+	}
+
 	screenport->SetUI( 0 );
 	CompositingShader shader( true );
 
+	GPUStream stream( batchVertex.Mem() );
+	shader.SetStream( stream, batchVertex.Mem(), nGlyph*6, batchIndex.Mem() );
+	shader.SetTexture0( texture );
+	shader.Draw();
+
+	batchVertex.Clear();
+}
+
+
+void UFOText::Draw( int x, int y, const char* format, ... )
+{
     va_list     va;
 	const int	size = 1024;
     char		buffer[size];
@@ -280,5 +294,5 @@ void UFOText::Draw( int x, int y, const char* format, ... )
 #endif
 	va_end( va );
 
-    TextOut( &shader, buffer, x, y, 16, 0 );
+    TextOut( buffer, x, y, 16 );
 }
@@ -22,6 +22,7 @@
 #include "screenport.h"
 #include "texture.h"
 #include "vertex.h"
+#include "ufoutil.h"
 #include "../gamui/gamui.h"
 #include "../shared/gamedbreader.h"
 
@@ -32,7 +33,10 @@ class UFOText
 public:
 	static UFOText* Instance() 	{ GLASSERT( instance ); return instance; }
 
+	// Queues the text; nothing is rendered until Flush().
 	void Draw( int x, int y, const char* format, ... );
+	// Renders all the text queued this frame in one draw.
+	void Flush();
 	void Metrics(	int c, int c1,
 					float lineHeight,
 					gamui::IGamuiText::GlyphMetrics* metric );
@@ -55,7 +59,8 @@ private:
 	void CacheMetric( int c );
 	void CacheKern( int c, int cPrev );
 
-	void TextOut( GPUShader* shader, const char* str, int x, int y, int h, int *w );
+	void BuildGlyphTable();
+	void TextOut( const char* str, int x, int y, int h );
 
 	static UFOText* instance;
 	
@@ -69,20 +74,23 @@ private:
 	float texHeightInv;
 
 	enum {
-		BUF_SIZE = 30,
 		CHAR_OFFSET = 32,
 		CHAR_RANGE  = 128 - CHAR_OFFSET,
 		CACHE_SIZE = CHAR_RANGE * CHAR_RANGE,
-		END_CHAR = CHAR_OFFSET + CHAR_RANGE
+		END_CHAR = CHAR_OFFSET + CHAR_RANGE,
+		MAX_BATCH = 0x10000 / 4		// glyphs per flush, limited by U16 indices
 	};
 
 	int MetricIndex( int c )          { return c - CHAR_OFFSET; }
 	int KernIndex( int c, int cPrev ) { return (c-CHAR_OFFSET)*CHAR_RANGE + (cPrev-CHAR_OFFSET); }
 
-	PTVertex2	vBuf[BUF_SIZE*4];
-	U16			iBuf[BUF_SIZE*6];
 	Metric		metricCache[ CHAR_RANGE ];
 	S8			kerningCache[ CACHE_SIZE ];
+	// ASCII glyphs at a line height of fontSize, without kerning.
+	gamui::IGamuiText::GlyphMetrics glyphTable[ CHAR_RANGE ];
+
+	CDynArray< PTVertex2 >	batchVertex;	// 4 per glyph, this frame
+	CDynArray< U16 >		batchIndex;		// quad pattern, grown as needed
 };
 
 #endif // UFOATTACK_TEXT_INCLUDED
\ No newline at end of file
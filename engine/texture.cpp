@@ -1,6 +1,7 @@
 #include "texture.h"
 #include "platformgl.h"
 #include "surface.h"
+#include "gpustatemanager.h"
 
 #include "../grinliz/glstringutil.h"
 using namespace grinliz;
@@ -341,6 +342,7 @@ U32 TextureManager::CreateGLTexture( int w, int h, int format, int flags )
 	GLuint texID;
 	glGenTextures( 1, &texID );
 	glBindTexture( GL_TEXTURE_2D, texID );
+	GPUShader::InvalidateTextureBinding();
 
 	if ( flags & Texture::PARAM_LINEAR ) {
 		// Some devices report white squares
@@ -393,6 +395,7 @@ void Texture::Upload( const void* pixels, int size )
 	int glFormat, glType;
 	TextureManager::Instance()->CalcOpenGL( m_format, &glFormat, &glType );
 	glBindTexture( GL_TEXTURE_2D, m_gpuMem->glID );
+	GPUShader::InvalidateTextureBinding();
 
 #if defined( _WIN32 ) && defined( DEBUG )
 	int data;
@@ -100,6 +100,8 @@ public:
 	void ContextShift();
 
 	unsigned NumTextures() const			{ return textureArr.Size(); }
+	// Slot of a texture owned by the manager, or -1. Stable for the life of the texture.
+	int TextureIndex( const Texture* t ) const	{ int i = (int)(t - textureArr.Mem()); return ( i >= 0 && i < (int)textureArr.Size() ) ? i : -1; }
 	unsigned NumGPUResources() const		{ return gpuMemArr.Size(); }
 	U32 CalcTextureMem() const;
 	U32 CalcGPUMem() const;
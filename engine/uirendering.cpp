@@ -102,6 +102,78 @@ void UIRenderer::Render( const void* renderState, const void* textureHandle, int
 }
 
 
+/*static*/ int UIBuffers::generation = 0;
+
+/*static*/ void* UIBuffers::Create()
+{
+	if ( !GPUShader::SupportsVBOs() )
+		return 0;
+	return new UIBuffers();
+}
+
+
+/*static*/ void UIBuffers::Destroy( void* buffers )
+{
+	delete (UIBuffers*)buffers;
+}
+
+
+UIBuffers::~UIBuffers()
+{
+	if ( gen != generation ) {
+		// Lost with the old context; the ids may be in use in the new one.
+		vertexBuffer.Clear();
+		indexBuffer.Clear();
+	}
+	else {
+		vertexBuffer.Destroy();
+		indexBuffer.Destroy();
+	}
+}
+
+
+void UIBuffers::Upload( const gamui::Gamui::Dirty& dirty,
+						const uint16_t* index, int nIndex,
+						const gamui::Gamui::Vertex* vertex, int nVertex )
+{
+	bool all = dirty.resized;
+	if ( gen != generation ) {
+		// The context went away, and the buffers with it.
+		vertexBuffer.Clear();
+		indexBuffer.Clear();
+		gen = generation;
+	}
+	if ( !vertexBuffer.IsValid() ) {
+		vertexBuffer = GPUVertexBuffer::Create( 0, 0 );
+		indexBuffer = GPUIndexBuffer::Create( 0, 0 );
+		all = true;
+	}
+
+	if ( all ) {
+		vertexBuffer.Stream( vertex, nVertex*sizeof(Gamui::Vertex) );
+		indexBuffer.Stream( index, nIndex );
+	}
+	else {
+		if ( dirty.vertex1 > dirty.vertex0 ) {
+			vertexBuffer.UploadBytes( vertex + dirty.vertex0, 
+									  (dirty.vertex1 - dirty.vertex0)*sizeof(Gamui::Vertex), 
+									  dirty.vertex0*sizeof(Gamui::Vertex) );
+		}
+		if ( dirty.index1 > dirty.index0 ) {
+			indexBuffer.Upload( index + dirty.index0, dirty.index1 - dirty.index0, dirty.index0 );
+		}
+	}
+}
+
+
+void UIBuffers::Draw( GPUShader* shader, int indexStart, int nIndex )
+{
+	GPUStream stream( GPUStream::kGamuiType );
+	shader->SetStream( stream, vertexBuffer, nIndex, indexBuffer, indexStart );
+	shader->Draw();
+}
+
+
 void UIRenderer::SetAtomCoordFromPixel( int x0, int y0, int x1, int y1, int w, int h, RenderAtom* atom )
 {
 	atom->tx0 = (float)x0 / (float)w;
@@ -22,6 +22,34 @@
 class Screenport;
 
 
+// GPU copies of one Gamui instance's vertex and index buffers, for the
+// IGamuiRenderer buffer mode. Only the changed ranges are uploaded.
+class UIBuffers
+{
+public:
+	// Null if VBOs aren't supported: the Gamui renders from client memory.
+	static void* Create();
+	static void Destroy( void* buffers );
+	// The buffers re-create and re-upload on their next use.
+	static void DeviceLoss()	{ ++generation; }
+
+	void Upload( const gamui::Gamui::Dirty& dirty,
+				 const uint16_t* index, int nIndex,
+				 const gamui::Gamui::Vertex* vertex, int nVertex );
+	void Draw( GPUShader* shader, int indexStart, int nIndex );
+
+private:
+	UIBuffers() : gen( generation ) {}
+	~UIBuffers();
+
+	GPUVertexBuffer	vertexBuffer;
+	GPUIndexBuffer	indexBuffer;
+	int				gen;
+
+	static int generation;
+};
+
+
 class UIRenderer : public gamui::IGamuiRenderer, public gamui::IGamuiText
 {
 public:
@@ -47,6 +75,15 @@ public:
 	virtual void BeginTexture( const void* textureHandle );
 	virtual void Render( const void* renderState, const void* textureHandle, int nIndex, const uint16_t* index, int nVertex, const gamui::Gamui::Vertex* vertex ) ;
 
+	virtual void* CreateBuffers()					{ return UIBuffers::Create(); }
+	virtual void DestroyBuffers( void* buffers )	{ UIBuffers::Destroy( buffers ); }
+	virtual void UploadBuffers( void* buffers, const gamui::Gamui::Dirty& dirty, const uint16_t* index, int nIndex, const gamui::Gamui::Vertex* vertex, int nVertex ) {
+		((UIBuffers*)buffers)->Upload( dirty, index, nIndex, vertex, nVertex );
+	}
+	virtual void RenderBuffers( void* buffers, const void* renderState, const void* textureHandle, int indexStart, int nIndex ) {
+		((UIBuffers*)buffers)->Draw( &shader, indexStart, nIndex );
+	}
+
 	static void SetAtomCoordFromPixel( int x0, int y0, int x1, int y1, int w, int h, gamui::RenderAtom* );
 	static void LayoutListOnScreen( gamui::UIItem* items, int nItems, int stride, float x, float y, float vSpace, const Screenport& port );
 	virtual void GamuiGlyph( int c, int c1, float lineHeight, gamui::IGamuiText::GlyphMetrics* metric );
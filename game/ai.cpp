@@ -143,12 +143,14 @@ bool AI::SafeLineOfSight(	const Unit* source,
 		return false;
 	}
 
-	const int COUNT = multicast ? 5 : 1;
+	const int COUNT_MULTICAST = 5;
+	const int COUNT = multicast ? COUNT_MULTICAST : 1;
 
 	// Send out rays over the possible shooting space, see what happens. Basically want to know:
 	// 1. Does the center ray hit.
 	// 2. Do other possible solutions do bad things.
 
+	Ray rays[COUNT_MULTICAST];
 	for( int i=0; i<COUNT; ++i ) {
 		float delta = 0;
 		if ( COUNT > 1 ) {
@@ -158,14 +160,18 @@ bool AI::SafeLineOfSight(	const Unit* source,
 		}
 		Vector3F t = sourcePos + normal*length + tangent*delta;
 
-		Ray ray;
-		ray.origin = sourcePos;
-		ray.direction = t - sourcePos;
-		Vector3F intersection;
+		rays[i].origin = sourcePos;
+		rays[i].direction = t - sourcePos;
+	}
+
+	// The rays are a narrow fan, so they share one query of the space tree.
+	RayHit hits[COUNT_MULTICAST];
+	const Model* ignore[3] = { sourceModel, sourceWeaponModel, 0 };
+	engine->IntersectModels( rays, COUNT, TEST_TRI, 0, 0, ignore, hits );
 
-		const Model* ignore[3] = { sourceModel, sourceWeaponModel, 0 };
-		Model* m = engine->IntersectModel( ray, TEST_TRI, 0, 0, ignore, &intersection );
-		float distanceToImpact = m ? (intersection - sourcePos).Length() : (float)MAP_SIZE;
+	for( int i=0; i<COUNT; ++i ) {
+		Model* m = hits[i].model;
+		float distanceToImpact = m ? hits[i].distance : (float)MAP_SIZE;
 
 		// Did we hit our own team?
 		const Unit* u = battle->GetUnit( m, false );
@@ -0,0 +1,318 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "autoresolve.h"
+#include "battledata.h"
+#include "item.h"
+#include "../grinliz/glperformance.h"
+
+#include "SDL.h"
+
+using namespace grinliz;
+
+
+void AutoResolveStats::Add( const AutoResolveStats& rhs )
+{
+	nBattles		+= rhs.nBattles;
+	victory			+= rhs.victory;
+	defeat			+= rhs.defeat;
+	tie				+= rhs.tie;
+	soldiersDown	+= rhs.soldiersDown;
+	aliensDown		+= rhs.aliensDown;
+	civsDown		+= rhs.civsDown;
+	roundsFired		+= rhs.roundsFired;
+	alienRoundsFired+= rhs.alienRoundsFired;
+}
+
+
+AutoResolve::AutoResolve( const Unit* _soldiers, const Unit* _aliens, const Unit* _civs, bool _dayTime )
+{
+	dayTime = _dayTime;
+	for( int i=0; i<MAX_TERRANS; ++i )
+		soldiers[i] = _soldiers[i];
+	for( int i=0; i<MAX_ALIENS; ++i )
+		aliens[i] = _aliens[i];
+	for( int i=0; i<MAX_CIVS; ++i ) {
+		if ( _civs )
+			civs[i] = _civs[i];
+		else
+			civs[i].Free();
+	}
+}
+
+
+void AutoResolve::Run( U32 seed, int nBattles, int nThreads, AutoResolveResult* result )
+{
+	GRINLIZ_PERFTRACK
+
+	if ( nThreads <= 0 )
+		nThreads = SDL_GetCPUCount();
+	nThreads = Clamp( nThreads, 1, (int)MAX_THREADS );
+	nThreads = Min( nThreads, Max( nBattles, 1 ) );
+
+	Worker worker[MAX_THREADS];
+	SDL_Thread* thread[MAX_THREADS];
+
+	for( int i=0; i<nThreads; ++i ) {
+		worker[i].resolve = this;
+		worker[i].seed = seed;
+		worker[i].start = i;
+		worker[i].stride = nThreads;
+		worker[i].nBattles = nBattles;
+		worker[i].stats.Clear();
+		thread[i] = 0;
+	}
+	// The calling thread is worker 0. If a thread can't be created, its
+	// share of the battles is run here instead.
+	for( int i=1; i<nThreads; ++i ) {
+		thread[i] = SDL_CreateThread( WorkerMain, "AutoResolve", &worker[i] );
+	}
+	RunWorker( &worker[0] );
+
+	AutoResolveStats total;
+	total.Clear();
+	for( int i=0; i<nThreads; ++i ) {
+		if ( i > 0 ) {
+			if ( thread[i] )
+				SDL_WaitThread( thread[i], 0 );
+			else
+				RunWorker( &worker[i] );
+		}
+		total.Add( worker[i].stats );
+	}
+
+	memset( result, 0, sizeof(*result) );
+	result->nBattles = total.nBattles;
+	if ( total.nBattles ) {
+		const float n = (float)total.nBattles;
+		result->victory				= (float)total.victory / n;
+		result->defeat				= (float)total.defeat / n;
+		result->tie					= (float)total.tie / n;
+		result->soldiersDown		= (float)total.soldiersDown / n;
+		result->aliensDown			= (float)total.aliensDown / n;
+		result->civsDown			= (float)total.civsDown / n;
+		result->roundsFired			= (float)total.roundsFired / n;
+		result->alienRoundsFired	= (float)total.alienRoundsFired / n;
+	}
+}
+
+
+/*static*/ int AutoResolve::WorkerMain( void* data )
+{
+#ifdef GRINLIZ_PROFILE
+	Performance::SetThreadName( "AutoResolve" );
+#endif
+	Worker* worker = (Worker*)data;
+	worker->resolve->RunWorker( worker );
+	return 0;
+}
+
+
+void AutoResolve::RunWorker( Worker* worker )
+{
+	GRINLIZ_PERFTRACK
+
+	// Scratch teams, on the heap to keep the worker stacks small.
+	Unit* s = new Unit[MAX_TERRANS+MAX_ALIENS+MAX_CIVS];
+	Unit* a = s + MAX_TERRANS;
+	Unit* c = a + MAX_ALIENS;
+
+	const Random base( worker->seed );
+
+	for( int n=worker->start; n<worker->nBattles; n+=worker->stride ) {
+		for( int i=0; i<MAX_TERRANS; ++i )	s[i] = soldiers[i];
+		for( int i=0; i<MAX_ALIENS; ++i )	a[i] = aliens[i];
+		for( int i=0; i<MAX_CIVS; ++i )		c[i] = civs[i];
+
+		// The stream depends only on the seed and the battle number. The
+		// units' own rolls come from it too, or every battle would repeat them.
+		Random random = base.Stream( (U32)n );
+		for( int i=0; i<MAX_TERRANS+MAX_ALIENS+MAX_CIVS; ++i ) {
+			s[i].SetRandomSeed( random.Rand() );
+		}
+
+		Simulate( s, a, c, dayTime, &random, &worker->stats );
+	}
+	delete [] s;
+}
+
+
+/*static*/ int AutoResolve::Fight( Unit* att, Unit* def, float tu, float range, Random* random, AutoResolveStats* stats )
+{
+	int rounds = 0;
+	BulletTarget target( range );
+	float chanceToHit, chanceAnyHit, tuNeeded, dptu;
+	static const int mode[2] = { AUTO_SHOT, SNAP_SHOT };
+
+	int m=0;
+	while( m < 2 && def->IsAlive() ) {
+		if (    att->CanFire( mode[m] )
+			 && att->FireStatistics( mode[m], target, &chanceToHit, &chanceAnyHit, &tuNeeded, &dptu )
+			 && tuNeeded <= tu )
+		{
+			const WeaponItemDef* wid = att->GetWeapon()->IsWeapon();
+			const ClipItemDef* cid = wid->GetClipItemDef( mode[m] );
+			int nShots = wid->RoundsNeeded( mode[m] );
+
+			tu -= tuNeeded;
+			const int roundsBefore = rounds;
+			for( int shot=0; shot<nShots; ++shot ) {
+				if ( !def->IsAlive() )
+					break;
+				if ( att->GetInventory()->CalcClipRoundsTotal( cid ) == 0 )
+					break;
+
+				att->GetInventory()->UseClipRound( cid );
+				++rounds;
+
+				if ( random->Uniform() < chanceToHit ) {
+					DamageDesc d;
+					wid->DamageBase( mode[m], &d );
+					def->DoDamage( d, 0, false );
+				}
+			}
+			if ( !def->IsAlive() ) {
+				att->CreditKill();
+			}
+			if ( rounds == roundsBefore ) {
+				// Out of ammo for this mode.
+				++m;
+			}
+		}
+		else {
+			++m;
+		}
+	}
+	return rounds;
+}
+
+
+/*static*/ int AutoResolve::Simulate(	Unit* soldier, Unit* alien, Unit* civs,
+										bool day,
+										Random* random,
+										AutoResolveStats* stats,
+										Duel* duels, int maxDuels, int* nDuels )
+{
+	// Bound the battle. Most duels take out a unit, but a duel can time out
+	// with both sides standing. 24 is the cap the old FastBattleScene::RunSim
+	// had (a line of its display per duel); changing it changes the results.
+	static const int MAX_DUELS = 24;
+	static const int MAX_EXCHANGE = 20;
+
+	const int nSoldierStart = Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE );
+	const int nAlienStart   = Unit::Count( alien, MAX_ALIENS, Unit::STATUS_ALIVE );
+	const int nCivStart     = Unit::Count( civs, MAX_CIVS, Unit::STATUS_ALIVE );
+	const int nSoldierTotal = Unit::Count( soldier, MAX_TERRANS, -1 );
+
+	int soldierIndex = random->Rand( MAX_TERRANS );
+	int alienIndex = random->Rand( MAX_ALIENS );
+	int nDuel = 0;
+
+	for( int duel=0; duel<MAX_DUELS; ++duel ) {
+		int nSoldiers = Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE );
+		int nAliens = Unit::Count( alien, MAX_ALIENS, Unit::STATUS_ALIVE );
+		if ( nSoldiers == 0 || nAliens == 0 )
+			break;
+
+		if (    random->Bit()
+			 && nSoldiers < nSoldierTotal/2
+			 && nSoldiers < nAliens )
+		{
+			// Heavy losses. Run.
+			break;
+		}
+
+		int civIndex = random->Rand( MAX_CIVS );
+		if ( civs[civIndex].IsAlive() ) {
+			civs[civIndex].Kill( 0, false );
+		}
+
+		while( true ) {
+			++soldierIndex;
+			if ( soldierIndex >= MAX_TERRANS ) soldierIndex = 0;
+			if ( soldier[soldierIndex].IsAlive() )
+				break;
+		}
+		while( true ) {
+			++alienIndex;
+			if ( alienIndex >= MAX_ALIENS ) alienIndex = 0;
+			if ( alien[alienIndex].IsAlive() )
+				break;
+		}
+
+		// We have our combatants.
+		float range = 4.0f + 16.0f*random->Uniform();
+		Unit* pS = &soldier[soldierIndex];
+		Unit* pA = &alien[alienIndex];
+
+		if ( !pS->GetWeapon() ) {
+			pS->Kill( 0, false );
+		}
+		else if ( !pA->GetWeapon() ) {
+			pA->Kill( 0, false );
+		}
+		else {
+			Unit* att=pS;
+			Unit* def=pA;
+			if ( !day || random->Bit() ) {
+				Swap( &att, &def );
+			}
+
+			for( int exchange=0; exchange<MAX_EXCHANGE && pS->IsAlive() && pA->IsAlive(); ++exchange ) {
+				float tu = att->GetStats().TotalTU() * (0.5f+0.5f*random->Uniform());	// cut some TU for movement
+				// Player is smarter than AI
+				if ( pA == att ) {
+					tu *= 0.8f;
+				}
+				int rounds = Fight( att, def, tu, range, random, stats );
+				if ( att == pS )
+					stats->roundsFired += rounds;
+				else
+					stats->alienRoundsFired += rounds;
+				Swap( &att, &def );
+			}
+		}
+
+		if ( duels && nDuel < maxDuels ) {
+			duels[nDuel].soldier = soldierIndex;
+			duels[nDuel].alien = alienIndex;
+			duels[nDuel].soldierAlive = pS->IsAlive();
+			duels[nDuel].alienAlive = pA->IsAlive();
+			++nDuel;
+		}
+	}
+	if ( nDuels ) {
+		*nDuels = nDuel;
+	}
+
+	int nSoldiers = Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE );
+	int nAliens   = Unit::Count( alien, MAX_ALIENS, Unit::STATUS_ALIVE );
+
+	int result = BattleData::TIE;
+	if ( nSoldiers > 0 && nAliens == 0 )
+		result = BattleData::VICTORY;
+	else if ( nSoldiers == 0 && nAliens > 0 )
+		result = BattleData::DEFEAT;
+
+	stats->nBattles++;
+	if ( result == BattleData::VICTORY )		stats->victory++;
+	else if ( result == BattleData::DEFEAT )	stats->defeat++;
+	else										stats->tie++;
+
+	stats->soldiersDown	+= nSoldierStart - nSoldiers;
+	stats->aliensDown	+= nAlienStart - nAliens;
+	stats->civsDown		+= nCivStart - Unit::Count( civs, MAX_CIVS, Unit::STATUS_ALIVE );
+	return result;
+}
@@ -0,0 +1,119 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFO_AUTO_RESOLVE_INCLUDED
+#define UFO_AUTO_RESOLVE_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glrandom.h"
+#include "gamelimits.h"
+#include "unit.h"
+
+
+// Totals for one or many simulated battles.
+struct AutoResolveStats
+{
+	void Clear()	{ memset( this, 0, sizeof(*this) ); }
+	void Add( const AutoResolveStats& rhs );
+
+	int nBattles;
+	int victory;
+	int defeat;
+	int tie;
+	int soldiersDown;	// KIA or unconscious
+	int aliensDown;
+	int civsDown;
+	int roundsFired;	// by the soldiers
+	int alienRoundsFired;
+};
+
+
+// The prediction: 'nBattles' worth of AutoResolveStats boiled down to
+// probabilities and expected values.
+struct AutoResolveResult
+{
+	int   nBattles;
+	float victory;			// probability, 0-1
+	float defeat;
+	float tie;
+	float soldiersDown;		// expected per battle
+	float aliensDown;
+	float civsDown;
+	float roundsFired;
+	float alienRoundsFired;
+};
+
+
+/*
+	Statistical battle resolution. There is no map: soldiers and aliens are
+	paired into duels at random ranges, and the duels are fought with
+	Unit::FireStatistics until one side is gone or the terrans retreat.
+
+	Run() plays many independent battles from the same starting teams (the teams
+	are copied, never modified) spread across worker threads. Each battle has
+	its own Random stream derived from the seed and the battle number, so the
+	result is the same regardless of the thread count.
+*/
+class AutoResolve
+{
+public:
+	AutoResolve(	const Unit* soldiers,	// MAX_TERRANS
+					const Unit* aliens,		// MAX_ALIENS
+					const Unit* civs,		// MAX_CIVS, may be null
+					bool dayTime );
+
+	// nThreads=0 uses all the cores.
+	void Run( U32 seed, int nBattles, int nThreads, AutoResolveResult* result );
+
+	// One duel of a simulated battle. Only used for display.
+	struct Duel {
+		int  soldier;		// index into the soldiers
+		int  alien;			// index into the aliens
+		bool soldierAlive;
+		bool alienAlive;
+	};
+
+	// Runs one battle, modifying the units in place. Returns BattleData::VICTORY,
+	// DEFEAT, or TIE. If 'duels' is not null, records up to 'maxDuels' of them.
+	static int Simulate(	Unit* soldiers, Unit* aliens, Unit* civs,
+							bool dayTime,
+							grinliz::Random* random,
+							AutoResolveStats* stats,
+							Duel* duels=0, int maxDuels=0, int* nDuels=0 );
+
+private:
+	struct Worker {
+		AutoResolve*		resolve;
+		U32					seed;
+		int					start;
+		int					stride;
+		int					nBattles;
+		AutoResolveStats	stats;
+	};
+	static int WorkerMain( void* data );
+	void RunWorker( Worker* worker );
+
+	static int Fight( Unit* att, Unit* def, float tu, float range, grinliz::Random* random, AutoResolveStats* stats );
+
+	enum { MAX_THREADS = 16 };
+
+	bool dayTime;
+	Unit soldiers[MAX_TERRANS];
+	Unit aliens[MAX_ALIENS];
+	Unit civs[MAX_CIVS];
+};
+
+
+#endif // UFO_AUTO_RESOLVE_INCLUDED
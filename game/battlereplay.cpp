@@ -0,0 +1,332 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "battlereplay.h"
+#include "battlescene.h"
+#include "unit.h"
+#include "../engine/map.h"
+#include "../grinliz/glrandom.h"
+
+using namespace grinliz;
+
+
+BattleReplay::BattleReplay() : seed( 0 ), terranAI( false )
+{
+}
+
+
+void BattleReplay::Begin( U32 _seed, const char* _start, bool _terranAI )
+{
+	seed = _seed;
+	terranAI = _terranAI;
+	start.Clear();
+	if ( _start ) {
+		int len = strlen( _start );
+		memcpy( start.PushArr( len+1 ), _start, len+1 );
+	}
+	stream.Clear();
+}
+
+
+void BattleReplay::RecordMove( int unitID, const MotionPath& path )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	GLASSERT( path.pathLen >= 0 && path.pathLen <= MAX_TU );
+	WriteU8( REPLAY_MOVE );
+	WriteU8( unitID );
+	WriteU8( path.pathLen );
+	Write( path.pathData, path.pathLen*2 );
+}
+
+
+void BattleReplay::RecordRotate( int unitID, float rotation )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	WriteU8( REPLAY_ROTATE );
+	WriteU8( unitID );
+	Write( &rotation, sizeof(rotation) );
+}
+
+
+void BattleReplay::RecordShoot( int unitID, int mode, const Vector3F& target, float targetWidth, float targetHeight )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	WriteU8( REPLAY_SHOOT );
+	WriteU8( unitID );
+	WriteU8( mode );
+	Write( &target, sizeof(target) );
+	Write( &targetWidth, sizeof(targetWidth) );
+	Write( &targetHeight, sizeof(targetHeight) );
+}
+
+
+void BattleReplay::RecordPsi( int unitID, int targetID, U32 roll, bool success )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	GLASSERT( targetID >= 0 && targetID < MAX_UNITS );
+	WriteU8( REPLAY_PSI );
+	WriteU8( unitID );
+	WriteU8( targetID );
+	WriteU8( success ? 1 : 0 );
+	Write( &roll, sizeof(roll) );
+}
+
+
+void BattleReplay::RecordInventory( int unitID )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	WriteU8( REPLAY_INVENTORY );
+	WriteU8( unitID );
+}
+
+
+void BattleReplay::RecordEquip( int unitID, const Inventory* inventory, int storageX, int storageY, const char* storageXML )
+{
+	GLASSERT( unitID >= 0 && unitID < MAX_UNITS );
+	WriteU8( REPLAY_EQUIP );
+	WriteU8( unitID );
+	WriteU8( storageX );
+	WriteU8( storageY );
+
+	for( int i=0; i<Inventory::NUM_SLOTS; ++i ) {
+		Item item = inventory->GetItem( i );
+		WriteU8( item.IsSomething() ? item.GetItemDef()->index : 0xff );
+		int rounds = item.Rounds();
+		Write( &rounds, sizeof(rounds) );
+	}
+	int len = strlen( storageXML );
+	Write( &len, sizeof(len) );
+	Write( storageXML, len+1 );
+}
+
+
+void BattleReplay::RecordTurn( int turn, int team, U64 hash )
+{
+	WriteU8( REPLAY_TURN );
+	WriteU8( team );
+	Write( &turn, sizeof(turn) );
+	Write( &hash, sizeof(hash) );
+}
+
+
+/*static*/ U64 BattleReplay::StateHash( const Unit* units, const Map* map )
+{
+	U64 h = Random::Hash64( 0, 0 );
+	for( int i=0; i<MAX_UNITS; ++i ) {
+		h = units[i].StateHash( h );
+	}
+	if ( map ) {
+		h = map->StateHash( h );
+	}
+	return h;
+}
+
+
+bool BattleReplay::Read( int* pos, void* mem, int size ) const
+{
+	if ( *pos + size > stream.Size() )
+		return false;
+	memcpy( mem, stream.Mem() + *pos, size );
+	*pos += size;
+	return true;
+}
+
+
+int BattleReplay::Next( int pos, Record* record ) const
+{
+	if ( pos < 0 || pos+2 > stream.Size() )
+		return -1;
+
+	memset( record, 0, sizeof(*record) );
+	record->type   = stream[pos++];
+	bool okay = true;
+
+	switch( record->type ) {
+		case REPLAY_MOVE:
+			record->unitID = stream[pos++];
+			okay = pos < stream.Size();
+			if ( okay ) {
+				record->pathLen = stream[pos++];
+				okay = record->pathLen <= MAX_TU && Read( &pos, record->pathData, record->pathLen*2 );
+			}
+			break;
+
+		case REPLAY_ROTATE:
+			record->unitID = stream[pos++];
+			okay = Read( &pos, &record->rotation, sizeof(record->rotation) );
+			break;
+
+		case REPLAY_SHOOT:
+			record->unitID = stream[pos++];
+			okay = pos < stream.Size();
+			if ( okay ) {
+				record->mode = stream[pos++];
+				okay =    Read( &pos, &record->target, sizeof(record->target) )
+					   && Read( &pos, &record->targetWidth, sizeof(record->targetWidth) )
+					   && Read( &pos, &record->targetHeight, sizeof(record->targetHeight) );
+			}
+			break;
+
+		case REPLAY_PSI:
+			record->unitID = stream[pos++];
+			okay = pos+2 <= stream.Size();
+			if ( okay ) {
+				record->targetID = stream[pos++];
+				record->success  = stream[pos++] != 0;
+				okay = Read( &pos, &record->random, sizeof(record->random) );
+			}
+			break;
+
+		case REPLAY_INVENTORY:
+			record->unitID = stream[pos++];
+			break;
+
+		case REPLAY_TURN:
+			record->unitID = -1;
+			record->team = stream[pos++];
+			okay =    Read( &pos, &record->turn, sizeof(record->turn) )
+				   && Read( &pos, &record->hash, sizeof(record->hash) );
+			break;
+
+		case REPLAY_EQUIP:
+			record->unitID = stream[pos++];
+			okay = pos+2 <= stream.Size();
+			if ( okay ) {
+				record->storageX = stream[pos++];
+				record->storageY = stream[pos++];
+				for( int i=0; okay && i<Inventory::NUM_SLOTS; ++i ) {
+					okay = pos < stream.Size();
+					if ( okay ) {
+						int index = stream[pos++];
+						record->slotItem[i] = ( index == 0xff ) ? -1 : index;
+						okay =    record->slotItem[i] < EL_MAX_ITEM_DEFS
+							   && Read( &pos, &record->slotRounds[i], sizeof(record->slotRounds[i]) );
+					}
+				}
+				int len = 0;
+				okay =    okay
+					   && Read( &pos, &len, sizeof(len) )
+					   && len >= 0 && pos+len+1 <= stream.Size()
+					   && stream[pos+len] == 0;
+				if ( okay ) {
+					record->storageXML = (const char*)stream.Mem() + pos;
+					pos += len+1;
+				}
+			}
+			break;
+
+		default:
+			okay = false;
+			break;
+	}
+	if ( okay && record->type != REPLAY_TURN ) {
+		okay = record->unitID < MAX_UNITS;
+	}
+	if ( okay && record->type == REPLAY_TURN ) {
+		okay = record->team < NUM_TEAMS;
+	}
+	return okay ? pos : -1;
+}
+
+
+int BattleReplay::Verify( const BattleReplay& reference ) const
+{
+	Record a, b;
+	int posA = 0, posB = 0;
+
+	while( true ) {
+		do {
+			posA = Next( posA, &a );
+		} while ( posA >= 0 && a.type != REPLAY_TURN );
+		do {
+			posB = reference.Next( posB, &b );
+		} while ( posB >= 0 && b.type != REPLAY_TURN );
+
+		if ( posA < 0 || posB < 0 )
+			break;
+		if ( a.turn != b.turn || a.team != b.team || a.hash != b.hash ) {
+			GLOUTPUT(( "Replay mismatch: turn=%d team=%d\n", a.turn, a.team ));
+			return a.turn;
+		}
+	}
+	return -1;
+}
+
+
+bool BattleReplay::Save( FILE* fp ) const
+{
+	U32 header[6] = { MAGIC, VERSION, seed, terranAI ? 1U : 0U, (U32)start.Size(), (U32)stream.Size() };
+	if ( fwrite( header, sizeof(header), 1, fp ) != 1 )
+		return false;
+	if ( start.Size() && fwrite( start.Mem(), start.Size(), 1, fp ) != 1 )
+		return false;
+	if ( stream.Size() && fwrite( stream.Mem(), stream.Size(), 1, fp ) != 1 )
+		return false;
+	return true;
+}
+
+
+bool BattleReplay::Load( FILE* fp )
+{
+	start.Clear();
+	stream.Clear();
+	seed = 0;
+	terranAI = false;
+
+	long fileStart = ftell( fp );
+	fseek( fp, 0, SEEK_END );
+	long fileLen = ftell( fp ) - fileStart;
+	fseek( fp, fileStart, SEEK_SET );
+
+	U32 header[6] = { 0 };
+	if (    fileLen < (long)sizeof(header)
+		 || fread( header, sizeof(header), 1, fp ) != 1
+		 || header[0] != MAGIC
+		 || header[1] != VERSION )
+	{
+		return false;
+	}
+	// The start and the stream are all that follows the header.
+	const U32 bodyLen = (U32)( fileLen - (long)sizeof(header) );
+	if ( header[4] > bodyLen || header[5] != bodyLen - header[4] ) {
+		return false;
+	}
+	seed = header[2];
+	terranAI = header[3] != 0;
+	int startSize = (int)header[4];
+	int size = (int)header[5];
+	if (    ( startSize && fread( start.PushArr( startSize ), startSize, 1, fp ) != 1 )
+		 || ( size && fread( stream.PushArr( size ), size, 1, fp ) != 1 )
+		 || ( startSize && start[startSize-1] != 0 ) )
+	{
+		start.Clear();
+		stream.Clear();
+		return false;
+	}
+
+	// Every record has to read back, so a truncated or corrupt stream is
+	// refused here rather than found part way through a re-run.
+	Record record;
+	int pos = 0;
+	while( pos >= 0 && pos < stream.Size() ) {
+		pos = Next( pos, &record );
+	}
+	if ( pos != stream.Size() ) {
+		start.Clear();
+		stream.Clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,140 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFO_BATTLE_REPLAY_INCLUDED
+#define UFO_BATTLE_REPLAY_INCLUDED
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glvector.h"
+#include "../engine/ufoutil.h"
+#include "gamelimits.h"
+#include "inventory.h"
+
+class Unit;
+class Map;
+struct MotionPath;
+
+
+/*
+	A compact binary log of a battle. The log starts with the battle as it
+	was loaded (the "BattleScene" XML) and the seed. Every decision - a unit
+	told to move, turn, shoot, or re-equip - is recorded as it is made, and
+	a hash of the units and the map is recorded at the start of every turn
+	and when the battle ends.
+
+	Two runs from the same start and the same decisions should produce the
+	same stream of turn hashes; Verify() finds the first turn where they
+	diverge. A headless BattleScene (Game::RunHeadlessBattle) re-runs a log:
+	the AI teams think again and the player's decisions are fed back in.
+	That's the check for AI, pathing, or visibility changes that must not
+	change the outcome of a battle.
+*/
+class BattleReplay
+{
+public:
+	BattleReplay();
+
+	enum {
+		REPLAY_MOVE = 1,
+		REPLAY_ROTATE,
+		REPLAY_SHOOT,
+		REPLAY_PSI,
+		REPLAY_INVENTORY,
+		REPLAY_TURN,
+		REPLAY_EQUIP
+	};
+
+	// Clears the stream and starts a new battle. 'start' is the battle
+	// as loaded; 'terranAI' is set if the terrans were played by the AI.
+	void Begin( U32 seed, const char* start, bool terranAI );
+	U32  Seed() const			{ return seed; }
+	const char* Start() const	{ return start.Empty() ? "" : start.Mem(); }
+	bool TerranAI() const		{ return terranAI; }
+	bool Empty() const			{ return stream.Empty(); }
+	int  Size() const			{ return stream.Size(); }
+
+	void RecordMove( int unitID, const MotionPath& path );
+	void RecordRotate( int unitID, float rotation );
+	// The aim, before the BulletSpread is applied.
+	void RecordShoot( int unitID, int mode, const grinliz::Vector3F& target, float targetWidth, float targetHeight );
+	// 'roll' is the random number rolled against the psi defense.
+	void RecordPsi( int unitID, int targetID, U32 roll, bool success );
+	void RecordInventory( int unitID );
+	// The inventory and the storage it traded with, after the player
+	// closes the character screen. 'storageXML' is the Storage::Save() output.
+	void RecordEquip( int unitID, const Inventory* inventory, int storageX, int storageY, const char* storageXML );
+	void RecordTurn( int turn, int team, U64 hash );
+
+	// Hash of the units (all MAX_UNITS) and the map damage, doors, and pyro.
+	static U64 StateHash( const Unit* units, const Map* map );
+
+	bool Save( FILE* fp ) const;
+	bool Load( FILE* fp );
+
+	// Compares the turn hashes against a reference replay. Returns the
+	// first turn that doesn't match, or -1 if they all match.
+	int Verify( const BattleReplay& reference ) const;
+
+	struct Record {
+		int			type;
+		int			unitID;
+		int			mode;
+		int			targetID;
+		bool		success;
+		U32			random;					// PSI: the roll
+		float		rotation;
+		grinliz::Vector3F target;
+		float		targetWidth;
+		float		targetHeight;
+		int			turn;
+		int			team;
+		U64			hash;
+		int			pathLen;
+		U8			pathData[MAX_TU*2];
+		// EQUIP: the item index (-1 for an empty slot) and rounds of each
+		// inventory slot, and the storage. 'storageXML' points into the
+		// stream and is null terminated.
+		int			slotItem[Inventory::NUM_SLOTS];
+		int			slotRounds[Inventory::NUM_SLOTS];
+		int			storageX;
+		int			storageY;
+		const char*	storageXML;
+	};
+	// Reads the record at 'pos' and returns the position of the next
+	// record. Returns -1 at the end of the stream, or if the record is
+	// corrupt; Load() refuses a stream with a corrupt record. Start with pos=0.
+	int Next( int pos, Record* record ) const;
+
+private:
+	void Write( const void* mem, int size )	{ memcpy( stream.PushArr( size ), mem, size ); }
+	void WriteU8( int v )					{ stream.Push( (U8)v ); }
+	bool Read( int* pos, void* mem, int size ) const;
+
+	enum {
+		MAGIC	= 0x50455258,	// "XREP"
+		VERSION	= 2
+	};
+
+	U32				seed;
+	bool			terranAI;
+	CDynArray<char>	start;
+	CDynArray<U8>	stream;
+};
+
+
+#endif // UFO_BATTLE_REPLAY_INCLUDED
@@ -57,12 +57,24 @@ BattleScene::BattleScene( Game* game ) : Scene( game )
 	lockedStorage = 0;
 	cameraSet = false;
 	battleEnding = false;
+	headless = false;
+	headlessDone = false;
+	headlessSeed = 0;
+	replaySource = 0;
+	replayPos = 0;
+	replayMismatch = -1;
+	memset( weaponKills, 0, sizeof(weaponKills) );
 	confirmDest.Set( -1, -1 );
-	random.SetSeedFromTime();
+	U32 seed = random.SetSeedFromTime();
 	orbit = 0;
 
 	engine  = game->engine;
+	ResetInterpolation();
 	tacMap = new TacMap( engine->GetSpaceTree(), game->GetItemDefArr() );
+	// The map gets its own stream (fire spread), derived from the battle seed
+	// so the replay can reproduce it.
+	tacMap->random.SetSeed( Random::Hash( &seed, sizeof(seed) ) );
+	replay.Begin( seed, 0, false );
 
 	visibility.Init( this, units, tacMap );
 	nearPathState.Clear();
@@ -349,6 +361,13 @@ void BattleScene::DeActivate()
 }
 
 
+void BattleScene::DeviceLoss()
+{
+	// The map isn't the engine's while another scene is on top.
+	tacMap->DeviceLoss();
+}
+
+
 const Model* BattleScene::GetModel( const Unit* unit )
 { 
 	if ( unit ) {
@@ -388,6 +407,7 @@ void BattleScene::UpgradeCrawlerToSpitter( Unit* unit )
 	int alienCount[Unit::NUM_ALIEN_TYPES] = { 0 };
 	alienCount[Unit::ALIEN_SPITTER] = 1;
 	TacticalIntroScene::GenerateAlienTeam( unit, alienCount, (float)rank, game->GetItemDefArr(), random.Rand() );
+	unit->SetRandomSeed( random.Rand() );
 	unit->SetPos( pos, rot );
 
 	Color4F color = Convert_4U8_4F( game->MainPaletteColor( 4, 3 ) );
@@ -470,8 +490,10 @@ void BattleScene::NextTurn( bool saveOnTerranTurn )
 	CalcTeamTargets();
 	targetEvents.Clear();
 
+	RecordTurnHash();
+
 	// Per turn save:
-	if ( saveOnTerranTurn && currentTeamTurn == TERRAN_TEAM ) {
+	if ( saveOnTerranTurn && !headless && currentTeamTurn == TERRAN_TEAM ) {
 		game->Save( 0, false, true );
 	}
 
@@ -592,6 +614,17 @@ void BattleScene::Load( const XMLElement* battleElement )
 	if ( !battleElement )
 		return;
 
+	// The replay starts here, from the battle as loaded. Everything random
+	// in the battle is reseeded from its seed so a re-run can reproduce it.
+	U32 seed = headless ? headlessSeed : replay.Seed();
+	{
+		XMLPrinter printer;
+		battleElement->Accept( &printer );
+		replay.Begin( seed, printer.CStr(), aiArr[TERRAN_TEAM] != 0 );
+	}
+	random.SetSeed( seed );
+	tacMap->random.SetSeed( Random::Hash( &seed, sizeof(seed) ) );
+
 	battleElement->QueryIntAttribute( "currentTeamTurn", &currentTeamTurn );
 	turnCount = 0;
 	battleElement->QueryIntAttribute( "turnCount", &turnCount );
@@ -602,6 +635,10 @@ void BattleScene::Load( const XMLElement* battleElement )
 	tacMap->SetDayTime( game->battleData.GetDayTime() );
 
 	for( int i=0; i<MAX_UNITS; ++i ) {
+		// Unit::Load seeds the unit from its address.
+		U32 key[2] = { seed, (U32)i };
+		units[i].SetRandomSeed( Random::Hash( key, sizeof(key) ) );
+
 		if ( units[i].InUse() )
 			units[i].InitLoc( tacMap );
 
@@ -617,6 +654,7 @@ void BattleScene::Load( const XMLElement* battleElement )
 	ProcessDoors();
 	CalcTeamTargets();
 	targetEvents.Clear();
+	RecordTurnHash();
 
 	if ( aiArr[currentTeamTurn] ) {
 		aiArr[currentTeamTurn]->StartTurn( units );
@@ -629,6 +667,18 @@ void BattleScene::Load( const XMLElement* battleElement )
 			break;
 		}
 	}
+	ResetInterpolation();
+}
+
+
+void BattleScene::ResetInterpolation()
+{
+	for( int i=0; i<MAX_UNITS; ++i ) {
+		unitFrom[i] = units[i].Pos();
+	}
+	cameraFrom = engine->camera.PosWC();
+	cameraTo = cameraFrom;
+	cameraLerped = false;
 }
 
 
@@ -899,6 +949,11 @@ void BattleScene::DoTick( U32 currentTime, U32 deltaTime )
 	TestHitTesting();
 	tacMap->EmitParticles( deltaTime );
 
+	for( int i=0; i<MAX_UNITS; ++i ) {
+		unitFrom[i] = units[i].Pos();
+	}
+	cameraFrom = engine->camera.PosWC();
+
 #if 0
 		// Debug unit targets.
 		for( int i=ALIEN_UNITS_START; i<ALIEN_UNITS_END; ++i ) {
@@ -950,6 +1005,9 @@ void BattleScene::DoTick( U32 currentTime, U32 deltaTime )
 	if ( !battleEnding && game->battleData.IsBattleOver() ) {
 		PushEndScene();
 	}
+	if ( headlessDone ) {
+		return;
+	}
 	{ 
 		if ( currentTeamTurn == TERRAN_TEAM ) {
 			if ( selection.soldierUnit && !selection.soldierUnit->IsAlive() ) {
@@ -976,12 +1034,19 @@ void BattleScene::DoTick( U32 currentTime, U32 deltaTime )
 					NextTurn( true );
 				}
 			}
+			else if ( replaySource ) {
+				bool done = ProcessReplay();
+				if ( done ) {
+					NextTurn( false );
+				}
+			}
 		}
 	}
 	for( int i=0; i<MAX_UNITS; ++i ) {
 		unitRenderers[i].Update( GetEngine()->GetSpaceTree(), &units[i] );
 	}
 	engine->camera.Orbit( orbit );
+	cameraTo = engine->camera.PosWC();
 	//consoleWidget->DoTick( deltaTime );
 
 	if ( TVMode() ) {
@@ -992,9 +1057,42 @@ void BattleScene::DoTick( U32 currentTime, U32 deltaTime )
 }
 
 
+void BattleScene::InterpolateRender( float alpha )
+{
+	// Only the units the last step moved need to be placed; Place() with
+	// alpha==1 puts them back where the simulation has them.
+	for( int i=0; i<MAX_UNITS; ++i ) {
+		if ( units[i].InUse() && unitFrom[i] != units[i].Pos() ) {
+			unitRenderers[i].Place( unitFrom[i] + alpha*(units[i].Pos()-unitFrom[i]), units[i].Rotation() );
+		}
+	}
+
+	// The camera is also moved by input between the steps. It is only
+	// interpolated if it is still where the last step left it.
+	Camera* camera = &engine->camera;
+	if ( cameraLerped ) {
+		camera->SetPosWC( cameraTo );
+		cameraLerped = false;
+	}
+	if ( alpha < 1.0f && cameraFrom != cameraTo && camera->PosWC() == cameraTo ) {
+		camera->SetPosWC( cameraFrom + alpha*(cameraTo-cameraFrom) );
+		cameraLerped = true;
+	}
+}
+
+
 void BattleScene::PushEndScene()
 {
+	// The end scene can be pushed again; the final hash is recorded once.
+	if ( !battleEnding ) {
+		RecordTurnHash();
+	}
 	battleEnding = true;
+	if ( headless ) {
+		// Nothing to collect or save; the battle is just over.
+		headlessDone = true;
+		return;
+	}
 	// Note that the end scene can get pushed multiple times in a save/load
 	// cycle. It's important to not do anything that can "accumulate".
 	game->battleData.ClearStorage();
@@ -1043,6 +1141,13 @@ void BattleScene::PushEndScene()
 			}
 		}
 	}
+	// Written every time the end scene is pushed; the replay is complete up to here.
+	FILE* fp = game->GameSavePath( SAVEPATH_REPLAY, SAVEPATH_WRITE, 0 );
+	if ( fp ) {
+		replay.Save( fp );
+		fclose( fp );
+	}
+
 	GLASSERT( !game->IsScenePushed() );
 	game->PushScene( Game::END_SCENE, 0 );
 }
@@ -1203,7 +1308,7 @@ void BattleScene::SetSelection( Unit* unit )
 }
 
 
-void BattleScene::PushRotateAction( Unit* src, const Vector3F& dst3F, bool quantize )
+bool BattleScene::PushRotateAction( Unit* src, const Vector3F& dst3F, bool quantize )
 {
 	GLRELASSERT( GetModel( src ) );
 
@@ -1214,7 +1319,9 @@ void BattleScene::PushRotateAction( Unit* src, const Vector3F& dst3F, bool quant
 		Action* action = actionStack.Push();
 		action->Init( ACTION_ROTATE, src );
 		action->type.rotate.rotation = rot;
+		return true;
 	}
+	return false;
 }
 
 
@@ -1478,6 +1585,9 @@ bool BattleScene::ProcessAI()
 					GLRELASSERT( shot );
 					if ( !shot )
 						done = true;
+					else
+						replay.RecordShoot( currentUnitAI, aiAction.shoot.mode, aiAction.shoot.target, 
+											aiAction.shoot.targetWidth, aiAction.shoot.targetHeight );
 				}
 				break;
 
@@ -1496,6 +1606,7 @@ bool BattleScene::ProcessAI()
 					Action* action = actionStack.Push();
 					action->Init( ACTION_MOVE, &units[currentUnitAI] );
 					action->type.move.path = aiAction.move.path;
+					replay.RecordMove( currentUnitAI, action->type.move.path );
 				}
 				break;
 
@@ -1503,11 +1614,14 @@ bool BattleScene::ProcessAI()
 				{
 					AI_LOG(( "[ai] Unit %d ROTATE\n", currentUnitAI ));
 					Vector3F target = { (float)aiAction.rotate.x, 0, (float)aiAction.rotate.y};
-					PushRotateAction( &units[currentUnitAI], target, true );
+					if ( PushRotateAction( &units[currentUnitAI], target, true ) ) {
+						replay.RecordRotate( currentUnitAI, actionStack.Top()->type.rotate.rotation );
+					}
 				}
 				break;
 
 			case AI::ACTION_INVENTORY:
+				replay.RecordInventory( currentUnitAI );
 				ProcessInventoryAI( &units[currentUnitAI] );
 				break;
 
@@ -1526,6 +1640,143 @@ bool BattleScene::ProcessAI()
 }
 
 
+void BattleScene::SetHeadless( const BattleReplay* source, U32 seed )
+{
+	headless = true;
+	replaySource = source;
+	replayPos = 0;
+	replayMismatch = -1;
+	headlessSeed = source ? source->Seed() : seed;
+
+	// The terrans think for themselves, unless there is a player to replay.
+	bool terranAI = source ? source->TerranAI() : true;
+	if ( terranAI && !aiArr[TERRAN_TEAM] ) {
+		aiArr[TERRAN_TEAM] = new WarriorAI( TERRAN_TEAM, &visibility, engine, units, this );
+	}
+	else if ( !terranAI && aiArr[TERRAN_TEAM] ) {
+		delete aiArr[TERRAN_TEAM];
+		aiArr[TERRAN_TEAM] = 0;
+	}
+}
+
+
+bool BattleScene::ProcessReplay()
+{
+	GLRELASSERT( actionStack.Empty() );
+	GLASSERT( replaySource );
+
+	BattleReplay::Record record;
+	while ( actionStack.Empty() ) {
+		int next = replaySource->Next( replayPos, &record );
+		if ( next < 0 ) {
+			// The player left the battle here.
+			headlessDone = true;
+			return false;
+		}
+		if ( record.type == BattleReplay::REPLAY_TURN ) {
+			// The player ended the turn, or (if the hash is for this turn)
+			// the battle, by evacuating. RecordTurnHash() reads the record.
+			if ( record.turn == turnCount ) {
+				Evacuate();
+				return false;
+			}
+			return true;
+		}
+		replayPos = next;
+
+		// The AI decisions are in the stream too; they are re-made, not replayed.
+		if ( record.unitID < 0 || record.unitID >= MAX_UNITS )
+			continue;
+		Unit* unit = &units[record.unitID];
+		if ( unit->Team() != currentTeamTurn || !unit->IsAlive() )
+			continue;
+
+		switch( record.type ) {
+			case BattleReplay::REPLAY_MOVE:
+				{
+					Action* action = actionStack.Push();
+					action->Init( ACTION_MOVE, unit );
+					action->type.move.path.pathLen = record.pathLen;
+					memcpy( action->type.move.path.pathData, record.pathData, record.pathLen*2 );
+					replay.RecordMove( record.unitID, action->type.move.path );
+				}
+				break;
+
+			case BattleReplay::REPLAY_ROTATE:
+				{
+					Action* action = actionStack.Push();
+					action->Init( ACTION_ROTATE, unit );
+					action->type.rotate.rotation = record.rotation;
+					replay.RecordRotate( record.unitID, record.rotation );
+				}
+				break;
+
+			case BattleReplay::REPLAY_SHOOT:
+				if ( PushShootAction( unit, record.target, record.targetWidth, record.targetHeight, record.mode, 1.0f, false ) ) {
+					replay.RecordShoot( record.unitID, record.mode, record.target, record.targetWidth, record.targetHeight );
+				}
+				break;
+
+			case BattleReplay::REPLAY_EQUIP:
+				{
+					Inventory* inventory = unit->GetInventory();
+					const ItemDefArr& itemDefArr = game->GetItemDefArr();
+					for( int i=0; i<Inventory::NUM_SLOTS; ++i ) {
+						inventory->RemoveItem( i );
+						const ItemDef* itemDef = ( record.slotItem[i] >= 0 ) ? itemDefArr.GetIndex( record.slotItem[i] ) : 0;
+						if ( itemDef ) {
+							*inventory->AccessItem( i ) = Item( itemDef, record.slotRounds[i] );
+						}
+					}
+					XMLDocument doc;
+					doc.Parse( record.storageXML );
+					Storage* storage = tacMap->LockStorage( record.storageX, record.storageY );
+					if ( doc.RootElement() ) {
+						storage->Load( doc.RootElement() );
+					}
+					replay.RecordEquip( record.unitID, inventory, storage->X(), storage->Y(), record.storageXML );
+					tacMap->ReleaseStorage( storage );
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+	return false;
+}
+
+
+void BattleScene::RecordTurnHash()
+{
+	U64 hash = BattleReplay::StateHash( units, tacMap );
+	replay.RecordTurn( turnCount, currentTeamTurn, hash );
+
+	if ( replaySource && replayMismatch < 0 ) {
+		// Skip to the source's hash for this turn.
+		BattleReplay::Record record;
+		int pos = replayPos;
+		do {
+			pos = replaySource->Next( pos, &record );
+		} while ( pos >= 0 && record.type != BattleReplay::REPLAY_TURN );
+
+		if ( pos < 0 ) {
+			// The source ended first.
+			replayMismatch = turnCount;
+			headlessDone = true;
+		}
+		else {
+			replayPos = pos;
+			if ( record.turn != turnCount || record.team != currentTeamTurn || record.hash != hash ) {
+				GLOUTPUT(( "Replay mismatch: turn=%d team=%d\n", turnCount, currentTeamTurn ));
+				replayMismatch = turnCount;
+				headlessDone = true;
+			}
+		}
+	}
+}
+
+
 void BattleScene::ProcessDoors()
 {
 	Vector2I loc[MAX_UNITS];
@@ -1977,6 +2228,7 @@ int BattleScene::ProcessActionShoot( Action* action, Unit* unit )
 		h->Init( ACTION_HIT, unit );
 		h->type.hit.damageDesc = damageDesc;
 		h->type.hit.weapon = weaponDef->weapon[mode];
+		h->type.hit.weaponDef = weaponDef;
 		h->type.hit.p = intersection;
 		
 		h->type.hit.n = ray.direction;
@@ -2012,7 +2264,9 @@ void BattleScene::ProcessPsiAttack( Action* action )
 	const Unit* targetUnit = &units[action->type.psi.targetID];
 	int psiAttack = unit->GetStats().PsiPower();
 	int psiDefense = targetUnit->PsiDefense();
-	bool success = random.Rand( psiAttack ) > (U32)psiDefense;
+	U32 roll = random.Rand( psiAttack );
+	bool success = roll > (U32)psiDefense;
+	replay.RecordPsi( unit - units, action->type.psi.targetID, roll, success );
 	GLOUTPUT(( "Psi: id=%d attack=%d defense=%d %s\n", targetUnit-units, psiAttack, psiDefense, success ? "success" : "fail" ));
 
 	// Set up the particle effects.
@@ -2035,7 +2289,8 @@ void BattleScene::ProcessPsiAttack( Action* action )
 							colors[i],	colorVelocity,
 							pos, 0.1f,
 							velocity, 0.1f,
-							0, 0.7f/(1.0f+i) );
+							0, 0.7f/(1.0f+i),
+							ParticleSystem::PRIORITY_HIGH );
 			pos.y += 0.1f;
 		}
 
@@ -2049,7 +2304,8 @@ void BattleScene::ProcessPsiAttack( Action* action )
 		velocity.y = 1;
 		ps->EmitPoint( 5, ParticleSystem::PARTICLE_SPHERE,
 					   colors[0], colorVelocity,
-					   pos, 0.1f, velocity, 0.2f );
+					   pos, 0.1f, velocity, 0.2f,
+					   ParticleSystem::PRIORITY_HIGH );
 	}
 	// Pop this - the PSI_ATTACK
 	actionStack.Pop();
@@ -2073,6 +2329,7 @@ void BattleScene::GenerateCrawler( const Unit* unit, const Unit* shooter )
 				int alienCount[Unit::NUM_ALIEN_TYPES] = { 0 };
 				alienCount[Unit::ALIEN_CRAWLER] = 1;
 				TacticalIntroScene::GenerateAlienTeam( &units[i], alienCount, (float)rank, game->GetItemDefArr(), random.Rand() );
+				units[i].SetRandomSeed( random.Rand() );
 				units[i].SetPos( pos, rot );
 
 				return;
@@ -2118,6 +2375,7 @@ int BattleScene::ProcessActionHit( Action* action )
 					if ( action->unit ) {
 						action->unit->CreditKill();
 					}
+					weaponKills[action->type.hit.weaponDef->index]++;
 				}
 				GLOUTPUT(( "Hit Unit 0x%lx hp=%d/%d\n", (intptr_t)hitUnit, (int)hitUnit->HP(), (int)hitUnit->GetStats().TotalHP() ));
 			}
@@ -2221,6 +2479,7 @@ int BattleScene::ProcessActionHit( Action* action )
 									}
 									if ( action->unit )
 										action->unit->CreditKill();
+									weaponKills[action->type.hit.weaponDef->index]++;
 								}
 							}
 							bool hitAnything = false;
@@ -2355,6 +2614,7 @@ void BattleScene::HandleRotation( float bias )
 		Action* action = actionStack.Push();
 		action->Init( ACTION_ROTATE, unit );
 		action->type.rotate.rotation = r;
+		replay.RecordRotate( unit - units, r );
 	}
 }
 
@@ -2389,7 +2649,9 @@ bool BattleScene::HandleIconTap( const gamui::UIItem* tapped )
 					targetModel->CalcTargetSize( &targetWidth, &targetHeight );
 				}
 			}
-			PushShootAction( selection.soldierUnit, target, targetWidth, targetHeight, mode, 1.0f, false );
+			if ( PushShootAction( selection.soldierUnit, target, targetWidth, targetHeight, mode, 1.0f, false ) ) {
+				replay.RecordShoot( selection.soldierUnit - units, mode, target, targetWidth, targetHeight );
+			}
 		}
 		selection.targetUnit = 0;
 		selection.targetPos.Set( -1, -1 );
@@ -2439,6 +2701,7 @@ bool BattleScene::HandleIconTap( const gamui::UIItem* tapped )
 			Action* action = actionStack.Push();
 			action->Init( ACTION_MOVE, SelectedSoldierUnit() );
 			action->type.move.path.Init( pathCache );
+			replay.RecordMove( SelectedSoldierUnit() - units, action->type.move.path );
 			tacMap->ClearNearPath();
 			confirmDest.Set( -1, -1 );
 		}
@@ -2450,34 +2713,48 @@ bool BattleScene::HandleIconTap( const gamui::UIItem* tapped )
 }
 
 
-void BattleScene::SceneResult( int sceneID, int result )
+void BattleScene::Evacuate()
 {
 	//const Model* model = tacMap->GetLanderModel();
 	//Rectangle2I bounds;
 	//tacMap->MapBoundsOfModel( model, &bounds );
 
-	if ( sceneID == Game::DIALOG_SCENE && result ) {
-		// Exit!
 #ifndef LANDER_RESCUE
-		for( int i=TERRAN_UNITS_START; i<TERRAN_UNITS_END; ++i ) {
-			if ( units[i].InUse() ) {
-				Vector2I v = units[i].Pos();
-				if ( !bounds.Contains( v ) ) {
-					units[i].Leave();
-				}
+	for( int i=TERRAN_UNITS_START; i<TERRAN_UNITS_END; ++i ) {
+		if ( units[i].InUse() ) {
+			Vector2I v = units[i].Pos();
+			if ( !bounds.Contains( v ) ) {
+				units[i].Leave();
 			}
 		}
+	}
 #endif
-		// The aliens are going to get all the civs
-		for( int i=CIV_UNITS_START; i<CIV_UNITS_END; ++i ) {
-			DamageDesc d = { 100, 100, 100 };
-			if ( units[i].IsAlive() )
-				units[i].DoDamage( d, tacMap, true );
-		}
+	// The aliens are going to get all the civs
+	for( int i=CIV_UNITS_START; i<CIV_UNITS_END; ++i ) {
+		DamageDesc d = { 100, 100, 100 };
+		if ( units[i].IsAlive() )
+			units[i].DoDamage( d, tacMap, true );
+	}
 
-		PushEndScene();
+	PushEndScene();
+}
+
+
+void BattleScene::SceneResult( int sceneID, int result )
+{
+	if ( sceneID == Game::DIALOG_SCENE && result ) {
+		// Exit!
+		Evacuate();
 	}
 	else if ( sceneID == Game::CHARACTER_SCENE ) {
+		const Unit* unit = SelectedSoldierUnit();
+		if ( unit ) {
+			XMLPrinter printer;
+			printer.OpenElement( "Equip" );
+			lockedStorage->Save( &printer );
+			printer.CloseElement();
+			replay.RecordEquip( unit - units, unit->GetInventory(), lockedStorage->X(), lockedStorage->Y(), printer.CStr() );
+		}
 		tacMap->ReleaseStorage( lockedStorage );
 		lockedStorage = 0;
 		ShowNearPath( 0 );	// force a redraw				
@@ -2832,6 +3109,7 @@ void BattleScene::Tap(	int action,
 					Action* action = actionStack.Push();
 					action->Init( ACTION_MOVE, SelectedSoldierUnit() );
 					action->type.move.path.Init( pathCache );
+					replay.RecordMove( SelectedSoldierUnit() - units, action->type.move.path );
 					tacMap->ClearNearPath();
 				}
 			}
@@ -2913,7 +3191,13 @@ void BattleScene::MakePathBlockCurrent( Map* map, const void* user )
 Unit* BattleScene::UnitFromModel( const Model* m, bool useWeaponModel )
 {
 	if ( m ) {
-		for( int i=0; i<MAX_UNITS; ++i ) {
+		// Unit models point back to their unit (see UnitRenderer); map
+		// models point to their MapItem, so check the range. (As integers:
+		// ordering pointers that aren't into 'units' is unspecified.)
+		const uintptr_t data  = (uintptr_t) m->UserData();
+		const uintptr_t first = (uintptr_t) units;
+		if ( data >= first && data < (uintptr_t)(units+MAX_UNITS) && ( data - first ) % sizeof(Unit) == 0 ) {
+			int i = (int)(( data - first ) / sizeof(Unit));
 			if (	( !useWeaponModel && GetModel( &units[i] ) == m )
 				 || ( useWeaponModel &&  GetWeaponModel( &units[i] ) == m ) )
 				return &units[i];
@@ -3124,6 +3408,7 @@ void BattleScene::DragUnitEnd( const grinliz::Vector2I& map )
 				Action* action = actionStack.Push();
 				action->Init( ACTION_MOVE, SelectedSoldierUnit() );
 				action->type.move.path.Init( pathCache );
+				replay.RecordMove( SelectedSoldierUnit() - units, action->type.move.path );
 			}
 		}
 	}
@@ -31,6 +31,7 @@
 #include "battlevisibility.h"
 #include "consolewidget.h"
 #include "firewidget.h"
+#include "battlereplay.h"
 
 class Model;
 class UIButtonBox;
@@ -111,6 +112,8 @@ public:
 
 	virtual int RenderPass( grinliz::Rectangle2I* clip3D, grinliz::Rectangle2I* clip2D );
 	virtual void DoTick( U32 currentTime, U32 deltaTime );
+	virtual void InterpolateRender( float alpha );
+	virtual bool CanInterpolateRender() const							{ return true; }
 	virtual void Draw3D();
 	virtual void DrawHUD();
 	virtual void HandleHotKeyMask( int mask );
@@ -118,6 +121,7 @@ public:
 	virtual SavePathType CanSave()										{ return SAVEPATH_TACTICAL; }
 	virtual void Save( tinyxml2::XMLPrinter* );
 	virtual void Load( const tinyxml2::XMLElement* doc );
+	virtual void DeviceLoss();
 
 	// debugging / MapMaker
 	void MouseMove( int x, int y );
@@ -135,6 +139,22 @@ public:
 	}
 	int GetUnitID( const Unit* u ) const { return u-units; }
 
+	// A headless battle (Game::RunHeadlessBattle) plays itself: every team
+	// is run by its AI, nothing is saved, and the end scene isn't pushed.
+	// If 'source' is set, the battle is a re-run of that replay; the
+	// terrans' recorded decisions are fed back in if a player made them,
+	// and every turn hash is checked against the source. Otherwise
+	// 'seed' starts the battle. Call before Load().
+	void SetHeadless( const BattleReplay* source, U32 seed );
+	// True once the battle is over, the source has run out, or the re-run
+	// no longer matches it.
+	bool HeadlessDone() const					{ return headlessDone; }
+	// The first turn that didn't match the source, or -1.
+	int  ReplayMismatch() const					{ return replayMismatch; }
+	int  TurnCount() const						{ return turnCount; }
+	// Units taken down since the battle was loaded, by ItemDef::index of the weapon.
+	const int* WeaponKills() const				{ return weaponKills; }
+
 private:
 	enum {
 		BTN_TAKE_OFF,
@@ -191,6 +211,7 @@ private:
 	struct HitAction {
 		DamageDesc						damageDesc;		// damage done.
 		const WeaponItemDef::Weapon*	weapon;			// by what
+		const WeaponItemDef*			weaponDef;		// the item firing it
 		
 		grinliz::Vector3F	p;				// point of impact
 		grinliz::Vector3F	n;				// normal from shooter to target
@@ -233,7 +254,9 @@ private:
 	CStack< Action > actionStack;
 
 	void PushEndScene();
-	void PushRotateAction( Unit* src, const grinliz::Vector3F& dst, bool quantize );
+	void Evacuate();			// the player leaves: pushes the end scene
+	// Returns true if the unit needed to turn.
+	bool PushRotateAction( Unit* src, const grinliz::Vector3F& dst, bool quantize );
 	
 	// Try to shoot. Return true if success.
 	bool PushShootAction(	Unit* src, 
@@ -385,6 +408,14 @@ private:
 	TacMap*			tacMap;
 	Storage*		lockedStorage;	// locked for use by the character scene
 	grinliz::Random random;			// "the" random number generator for the battle
+	BattleReplay	replay;			// not saved - the decisions and turn hashes since the battle was loaded
+	bool			headless;
+	bool			headlessDone;
+	U32				headlessSeed;
+	const BattleReplay* replaySource;	// headless re-run: the battle being replayed
+	int				replayPos;			// position in replaySource
+	int				replayMismatch;
+	int				weaponKills[EL_MAX_ITEM_DEFS];	// not saved
 	int				currentTeamTurn;
 	AI*				aiArr[3];
 	int				currentUnitAI;
@@ -407,6 +438,8 @@ private:
 	CDynArray< grinliz::Vector2I > doors;
 	void ProcessDoors();
 	bool ProcessAI();			// return true if turn over.
+	bool ProcessReplay();		// feed in the recorded decisions; return true if turn over.
+	void RecordTurnHash();		// and check it against the replaySource
 	void ProcessInventoryAI( Unit* unit );			// return true if turn over.
 
 	// Updates what units can and can not see. Sets the 'Targets' structure above,
@@ -418,6 +451,14 @@ private:
 
 	Unit*				units;
 	UnitRenderer		unitRenderers[MAX_UNITS];
+
+	// Where the units and the camera were at the start of the last step,
+	// for InterpolateRender.
+	grinliz::Vector3F	unitFrom[MAX_UNITS];
+	grinliz::Vector3F	cameraFrom, cameraTo;
+	bool				cameraLerped;
+	// Nothing in motion: the units and camera stay where they are.
+	void ResetInterpolation();
 	gamui::DigitalBar	hpBars[MAX_UNITS];
 
 	// MapMaker
@@ -16,6 +16,8 @@
 #include "../grinliz/gldebug.h"
 #include "cgame.h"
 #include "game.h"
+#include "tournament.h"
+#include "battlereplay.h"
 
 #ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
@@ -24,6 +26,7 @@
 #define resourceFile "uforesource.db"
 
 #include "../grinliz/glstringutil.h"
+#include "../grinliz/glperformance.h"
 
 
 class CheckThread
@@ -133,6 +136,61 @@ void GameTap( void* handle, int action, int x, int y )
 }
 
 
+int GameTournament( void* handle, const char* path, unsigned seed, int nSeeds, int nBattles, int nWorkers )
+{
+	CheckThread check;
+
+	Game* game = (Game*)handle;
+	Tournament tournament( game );
+	return tournament.Run( path, seed, nSeeds, nBattles, nWorkers );
+}
+
+
+int GameVerifyReplay( void* handle, const char* path, int* turn )
+{
+	CheckThread check;
+
+	Game* game = (Game*)handle;
+	*turn = -1;
+
+	BattleReplay source;
+	FILE* fp = fopen( path, "rb" );
+	if ( !fp )
+		return -1;
+	bool okay = source.Load( fp );
+	fclose( fp );
+
+	tinyxml2::XMLDocument doc;
+	if ( okay ) {
+		doc.Parse( source.Start() );
+	}
+	if ( !okay || doc.Error() || !doc.RootElement() )
+		return -1;
+
+	// About 4 hours of battle: far longer than any real one.
+	static const int MAX_STEPS = 1000*1000;
+	int mismatch = -1;
+	int turns = game->RunHeadlessBattle( doc.RootElement(), &source, 0, MAX_STEPS, &mismatch, 0, 0 );
+	*turn = mismatch;
+	return ( turns >= 0 && mismatch < 0 ) ? 1 : 0;
+}
+
+
+int GameWriteProfile( void* handle, const char* path, int nFrames, int* frames )
+{
+	CheckThread check;
+
+	*frames = 0;
+	FILE* fp = fopen( path, "w" );
+	if ( !fp )
+		return -1;
+
+	int n = grinliz::Performance::WriteChromeTrace( fp, nFrames, frames );
+	fclose( fp );
+	return n;
+}
+
+
 void GameDoTick( void* handle, unsigned int timeInMSec )
 {
 	CheckThread check;
@@ -142,6 +200,15 @@ void GameDoTick( void* handle, unsigned int timeInMSec )
 }
 
 
+void GameSetSimSteps( void* handle, int stepsPerFrame )
+{
+	CheckThread check;
+
+	Game* game = (Game*)handle;
+	game->SetSimSteps( stepsPerFrame );
+}
+
+
 void GameCameraGet( void* handle, int param, float* value ) 
 {
 	CheckThread check;
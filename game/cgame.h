@@ -60,6 +60,9 @@ void GameZoom( void* handle, int style, float zoom );
 // Relative rotation, in degrees.
 void GameCameraRotate( void* handle, float degrees );
 void GameDoTick( void* handle, unsigned int timeInMSec );
+// Number of fixed simulation steps per GameDoTick. 0 (the default) follows
+// the wall clock; more fast forwards.
+void GameSetSimSteps( void* handle, int stepsPerFrame );
 
 #define GAME_HK_NEXT_UNIT				0x0001
 #define GAME_HK_PREV_UNIT				0x0002
@@ -104,6 +107,24 @@ void GameAddDatabase( const char* path );
 
 int GamePopSound( void* handle, int* databaseID, int* offset, int* size );	// returns 1 if a sound was available
 
+// Balance tournament: sweeps the scenarios and ranks, plays each battle out on the map
+// AI against AI without rendering, and writes CSV to 'path'. The battles are split
+// over 'nWorkers' processes (0 is one per core) in a null GL build. Returns the number
+// of battles fought, or -1 if the file can't be written.
+int GameTournament( void* handle, const char* path, unsigned seed, int nSeeds, int nBattles, int nWorkers );
+
+// Re-runs the battle replay at 'path' (tacreplay.bin in the save directory is written at
+// the end of every battle) and checks every turn's state hash. Returns 1 if they all
+// match, 0 if not - 'turn' is the first turn that didn't, or -1 if the re-run didn't
+// end - or -1 if the replay can't be read.
+int GameVerifyReplay( void* handle, const char* path, int* turn );
+
+// Writes the profiled scopes of the last nFrames frames, from all threads, as Chrome
+// trace JSON. Only a GRINLIZ_PROFILE build records scopes. Returns the number of
+// scopes written, or -1 if the file can't be opened. 'frames' is the number of
+// whole frames written, which is fewer than nFrames if the scope rings don't hold them.
+int GameWriteProfile( void* handle, const char* path, int nFrames, int* frames );
+
 // --- Core to platform --- //
 void PlatformPathToResource( char* buffer, int bufferLen );
 const char* PlatformName();
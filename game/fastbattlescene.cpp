@@ -57,6 +57,15 @@ FastBattleScene::FastBattleScene( Game* _game, BattleSceneData* data ) : Scene(
 	int nCiv = TacticalIntroScene::CivsInScenario( data->scenario );
 	TacticalIntroScene::GenerateCivTeam( civs, nCiv, game->GetItemDefArr(), random.Rand() );
 
+	// Predict first: RunSim() changes the units.
+	AutoResolve autoResolve( data->soldierUnits, aliens, civs, data->dayTime );
+	autoResolve.Run( random.Rand(), NUM_PREDICT, 0, &prediction );
+
+	SNPrintf( buf, 32, "Win %d%% Lose %d%%", (int)LRintf( prediction.victory*100.0f ), (int)LRintf( prediction.defeat*100.0f ) );
+	scenarioText[TL_PREDICT_RESULT].SetText( buf );
+	SNPrintf( buf, 32, "Lost %.1f Kill %.1f", prediction.soldiersDown, prediction.aliensDown );
+	scenarioText[TL_PREDICT_LOSSES].SetText( buf );
+
 	battleResult = RunSim( data->soldierUnits, aliens, data->dayTime );
 	static const char* battleResultName[] = { "", "Victory", "Defeat", "Tie" };
 	scenarioText[TL_RESULT].SetText( battleResultName[battleResult] );
@@ -159,154 +168,47 @@ void FastBattleScene::SceneResult( int sceneID, int result )
 int FastBattleScene::RunSim( Unit* soldier, Unit* alien, bool day )
 {
 #ifdef FASTBATTLE_SUPPORTED
-	int soldierIndex = random.Rand( MAX_TERRANS );
-	int alienIndex = random.Rand( MAX_ALIENS );
-
 	static const int BUF_SIZE=60;
 	char buf[BUF_SIZE];
-	static const char* alienName[Unit::NUM_ALIEN_TYPES] = { "Grn", "Prme", "Hrnt", "Jckl", "Vpr" };
-	
-	int nBattle = 0;
-
-	while ( true ) {
-		if ( nBattle == NUM_BATTLE )
-			break;
-		int nSoldiers = Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE );
-		int nAliens = Unit::Count( alien, MAX_ALIENS, Unit::STATUS_ALIVE );
-		if ( nSoldiers == 0 || nAliens == 0 )
-			break;
-
-		if (    random.Bit() 
-			 && nSoldiers < Unit::Count( soldier, MAX_TERRANS, -1 )/2
-			 && nSoldiers < nAliens )
-		{
-			// Heavy losses. Run.
-			break;
-		}
 
-		int civIndex = random.Rand( MAX_CIVS );
-		if ( civs[civIndex].IsAlive() ) {
-			civs[civIndex].Kill( 0, false );
-		}
+	AutoResolveStats stats;
+	stats.Clear();
+	AutoResolve::Duel duel[NUM_BATTLE];
+	int nDuel = 0;
 
-		while( true ) {
-			++soldierIndex;
-			if ( soldierIndex >= MAX_TERRANS ) soldierIndex = 0;
-			if ( soldier[soldierIndex].IsAlive() )
-				break;
-		}
-		while( true ) {
-			++alienIndex;
-			if ( alienIndex >= MAX_ALIENS ) alienIndex = 0;
-			if ( alien[alienIndex].IsAlive() )
-				break;
-		}
+	int result = AutoResolve::Simulate( soldier, alien, civs, day, &random, &stats, duel, NUM_BATTLE, &nDuel );
 
-		// We have our combatants.
-		float range = 4.0f + 16.0f*random.Uniform();
-		Unit* pS = &soldier[soldierIndex];
-		Unit* pA = &alien[alienIndex];
+	for( int i=0; i<nDuel; ++i ) {
+		const Unit* pS = &soldier[duel[i].soldier];
+		const Unit* pA = &alien[duel[i].alien];
 
 		if ( !pS->GetWeapon() ) {
 			SNPrintf( buf, BUF_SIZE, "%s %s no weapon. DEFEAT.", pS->FirstName(), pS->LastName() );
-			battle[nBattle++].SetText( buf );
-			pS->Kill( 0, false );
-			continue;
-		}
-		if ( !pA->GetWeapon() ) {
-			SNPrintf( buf, BUF_SIZE, "%s #%d no weapon. VICTORY.", alienName[pA->AlienType()], pA-alien );
-			battle[nBattle++].SetText( buf );
-			pA->Kill( 0, false );
-			continue;
 		}
-
-		Unit* att=pS;
-		Unit* def=pA;
-		if ( !day || random.Bit() ) {
-			Swap( &att, &def );
+		else if ( !pA->GetWeapon() ) {
+			SNPrintf( buf, BUF_SIZE, "%s #%d no weapon. VICTORY.", pA->AlienShortName(), duel[i].alien );
 		}
-
-		int subCount = 0;
-		while ( pS->IsAlive() && pA->IsAlive() && subCount < 20 ) 
-		{
-			float tu = att->GetStats().TotalTU() * (0.5f+0.5f*random.Uniform());	// cut some TU for movement
-			// Player is smarter than AI
-			if ( pA == att ) {
-				tu *= 0.8f;
-			}
-
-			BulletTarget target( range );
-			float chanceToHit, chanceAnyHit, tuNeeded, dptu;
-			WeaponMode mode[2] = { kAutoFireMode, kSnapFireMode };
-
-			int m=0;
-			while( m < 2 ) {
-				att->FireStatistics( kAutoFireMode, target, &chanceToHit, &chanceAnyHit, &tuNeeded, &dptu );
-
-				if ( tuNeeded <= tu && att->CanFire( mode[m] ) )
-				{
-					const WeaponItemDef* wid = att->GetWeapon()->IsWeapon();
-					const ClipItemDef* cid = wid->GetClipItemDef( mode[m] );
-					int nShots = wid->RoundsNeeded( mode[m] );
-
-					tu -= tuNeeded;
-					for( int shot=0; shot<nShots; ++shot ) {
-						if ( !def->IsAlive() )
-							break;
-						if ( att->GetInventory()->CalcClipRoundsTotal( cid ) == 0 )
-							break;
-
-						att->GetInventory()->UseClipRound( cid );
-
-						if ( random.Uniform() < chanceToHit ) {
-							DamageDesc d;
-							wid->DamageBase( mode[m], &d );
-							def->DoDamage( d, 0, false );
-						}
-					}
-				}
-				else {
-					++m;
-				}
-
-				if ( !def->IsAlive() ) {
-					att->CreditKill();
-					break;
-				}
-			}
-
-			++subCount;
-			Swap( &att, &def );
+		else {
+			SNPrintf( buf, BUF_SIZE, "%s%s %s %s%s vs %s%s #%d %s%s", duel[i].soldierAlive ? "[" : "",
+																	  pS->FirstName(), pS->LastName(), pS->GetWeapon()->Name(),
+																	  duel[i].soldierAlive ? "]" : "",
+																	  duel[i].alienAlive ? "[" : "",
+																	  pA->AlienShortName(), duel[i].alien, pA->GetWeapon()->Name(),
+																	  duel[i].alienAlive ? "]" : "" );
 		}
-
-		SNPrintf( buf, BUF_SIZE, "%s%s %s %s%s vs %s%s #%d %s%s", pS->IsAlive() ? "[" : "",
-																  pS->FirstName(), pS->LastName(), pS->GetWeapon()->Name(),
-																  pS->IsAlive() ? "]" : "",
-																  pA->IsAlive() ? "[" : "",
-														          alienName[pA->AlienType()], pA-alien, pA->GetWeapon()->Name(),
-																  pA->IsAlive() ? "]" : "" );
-		battle[nBattle++].SetText( buf );
+		battle[i].SetText( buf );
 	}
 
-	int nSoldiers = Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE );
-	int nAliens   = Unit::Count( alien, MAX_ALIENS, Unit::STATUS_ALIVE );
-
 #ifndef LANDER_RESCUE
-	if ( nSoldiers == 0 ) {
+	if ( Unit::Count( soldier, MAX_TERRANS, Unit::STATUS_ALIVE ) == 0 ) {
 		for( int i=0; i<MAX_TERRANS; ++i ) {
 			if ( soldier[i].InUse() )
 				soldier[i].Leave();
 		}
 	}
 #endif
-
-//	int result = TacticalEndSceneData::TIE;
-//	if ( nSoldiers > 0 && nAliens == 0 )
-//		result = TacticalEndSceneData::VICTORY;
-//	else if ( nSoldiers == 0 && nAliens > 0 )
-//		result = TacticalEndSceneData::DEFEAT;
-//	return result;
-#endif
+	return result;
+#else
 	return 0;
+#endif
 }
-
@@ -21,6 +21,7 @@
 #include "../grinliz/glstringutil.h"
 #include "unit.h"
 #include "battlescenedata.h"
+#include "autoresolve.h"
 
 
 
@@ -54,10 +55,13 @@ private:
 		TL_CRASH,
 		TL_DAYTIME,
 		TL_ALIEN_RANK,
+		TL_PREDICT_RESULT,
+		TL_PREDICT_LOSSES,
 		TL_RESULT,
 		NUM_TL,
 
-		NUM_BATTLE = 24
+		NUM_BATTLE = 24,
+		NUM_PREDICT = 500	// battles simulated for the prediction
 	};
 	BattleSceneData*		data;
 	BackgroundUI			backgroundUI;
@@ -66,6 +70,7 @@ private:
 	gamui::PushButton		button;
 
 	int						battleResult;
+	AutoResolveResult		prediction;
 	grinliz::Random			random;
 
 	Storage					foundStorage;
@@ -39,6 +39,9 @@
 #include "../engine/uirendering.h"
 #include "../engine/particle.h"
 #include "../engine/gpustatemanager.h"
+#ifdef XENOENGINE_NULL_GL
+#include "../engine/nullgl.h"
+#endif
 #include "../engine/renderqueue.h"
 #include "../engine/shadermanager.h"
 
@@ -168,6 +171,14 @@ void Game::Init()
 	scenePopQueued = false;
 	loadSlot = 0;
 	currentFrame = 0;
+#ifdef GRINLIZ_PROFILE
+	Performance::SetThreadName( "Game" );
+#endif
+	simSteps = 0;
+	simTime = 0;
+	simAccumulator = 0;
+	renderTime = 0;
+	sceneTickNeeded = true;
 	surface.Set( Surface::RGBA16, 256, 256 );		// All the memory we will ever need (? or that is the intention)
 	joyStickAccum.Set( 0, 0 );
 
@@ -356,6 +367,9 @@ void Game::PushPopScene()
 	if ( scenePopQueued || sceneQueued.sceneID != NUM_SCENES ) {
 		TextureManager::Instance()->ContextShift();
 	}
+	if ( scenePopQueued || loadSlot || sceneQueued.sceneID != NUM_SCENES ) {
+		sceneTickNeeded = true;
+	}
 
 	while ( ( scenePopQueued || loadSlot ) && !sceneStack.Empty() )
 	{
@@ -513,6 +527,42 @@ void Game::Load( const XMLDocument& doc )
 }
 
 
+int Game::RunHeadlessBattle(	const XMLElement* battleElement, 
+								const BattleReplay* source, U32 seed, int maxSteps,
+								int* mismatch, int* result, int* kills )
+{
+	PushScene( BATTLE_SCENE, 0 );
+	PushPopScene();
+	GLASSERT( sceneStack.Top()->sceneID == BATTLE_SCENE );
+	BattleScene* battle = (BattleScene*)sceneStack.Top()->scene;
+
+	battle->SetHeadless( source, seed );
+	battle->Load( battleElement );
+
+	// Ticked directly, on its own clock, as fast as it will go.
+	U32 time = 0;
+	for( int step=0; step<maxSteps && !battle->HeadlessDone(); ++step ) {
+		time += SIM_STEP;
+		battle->DoTick( time, SIM_STEP );
+	}
+
+	int turns = battle->HeadlessDone() ? battle->TurnCount() : -1;
+	if ( mismatch )
+		*mismatch = battle->ReplayMismatch();
+	if ( result )
+		*result = battleData.CalcResult();
+	if ( kills ) {
+		const int* weaponKills = battle->WeaponKills();
+		for( int i=0; i<EL_MAX_ITEM_DEFS; ++i )
+			kills[i] += weaponKills[i];
+	}
+
+	PopScene();
+	PushPopScene();
+	return turns;
+}
+
+
 FILE* Game::GameSavePath( SavePathType type, SavePathMode mode, int slot ) const
 {	
 	grinliz::GLString str( savePath );
@@ -520,6 +570,8 @@ FILE* Game::GameSavePath( SavePathType type, SavePathMode mode, int slot ) const
 		str += "geogame";
 	else if ( type == SAVEPATH_TACTICAL )
 		str += "tacgame";
+	else if ( type == SAVEPATH_REPLAY )
+		str += "tacreplay";
 	else
 		GLASSERT( 0 );
 
@@ -527,7 +579,7 @@ FILE* Game::GameSavePath( SavePathType type, SavePathMode mode, int slot ) const
 		str += "-";
 		str += '0' + slot;
 	}
-	str += ".xml";
+	str += ( type == SAVEPATH_REPLAY ) ? ".bin" : ".xml";
 
 	FILE* fp = fopen( str.c_str(), (mode == SAVEPATH_WRITE) ? "wb" : "rb" );
 	return fp;
@@ -609,6 +661,8 @@ void Game::DoTick( U32 _currentTime )
 		currentTime = _currentTime;
 		if ( previousTime == 0 ) {
 			previousTime = currentTime-1;
+			simTime = currentTime;
+			renderTime = currentTime;
 		}
 		U32 deltaTime = currentTime - previousTime;
 
@@ -635,7 +689,48 @@ void Game::DoTick( U32 _currentTime )
 		GPUShader::Clear();
 
 		Scene* scene = sceneStack.Top()->scene;
-		scene->DoTick( currentTime, deltaTime );
+
+		int nSteps = simSteps;
+		U32 step = SIM_STEP;
+		if ( nSteps ) {
+			simAccumulator = 0;
+		}
+		else if ( !scene->CanInterpolateRender() ) {
+			// Stepping would judder at the step rate; tick once by the frame time.
+			nSteps = 1;
+			step = simAccumulator + deltaTime;
+			simAccumulator = 0;
+		}
+		else {
+			simAccumulator += deltaTime;
+			nSteps = simAccumulator / SIM_STEP;
+			simAccumulator -= nSteps * SIM_STEP;
+		}
+		// A scene is always ticked before it is first rendered.
+		if ( nSteps == 0 && sceneTickNeeded ) {
+			nSteps = 1;
+		}
+		sceneTickNeeded = false;
+
+		for( int i=0; i<nSteps; ++i ) {
+			simTime += step;
+			scene->DoTick( simTime, step );
+			// Once the scene stack is changing, the rest of the steps belong
+			// to the next scene: they go back to the accumulator. (A fast
+			// forward just runs fewer steps this frame.)
+			if ( scenePopQueued || IsScenePushed() ) {
+				if ( !simSteps )
+					simAccumulator += ( nSteps-1-i ) * step;
+				break;
+			}
+		}
+		// The particles run on the render clock, which is always at or past
+		// the simulation time the effects were started at.
+		U32 particleTime = simTime + simAccumulator;
+		U32 particleDelta = particleTime - renderTime;
+		renderTime = particleTime;
+
+		scene->InterpolateRender( Min( (float)simAccumulator / (float)SIM_STEP, 1.0f ) );
 
 		Rectangle2I clip2D, clip3D;
 		int renderPass = scene->RenderPass( &clip3D, &clip2D );
@@ -653,7 +748,7 @@ void Game::DoTick( U32 _currentTime )
 		
 			const grinliz::Vector3F* eyeDir = engine->camera.EyeDir3();
 			ParticleSystem* particleSystem = ParticleSystem::Instance();
-			particleSystem->Update( deltaTime, currentTime );
+			particleSystem->Update( particleDelta, particleTime );
 			particleSystem->Draw( eyeDir, engine->GetMap() ? &engine->GetMap()->GetFogOfWar() : 0 );
 		}
 
@@ -671,6 +766,8 @@ void Game::DoTick( U32 _currentTime )
 				scene->RenderGamui2D();
 			}
 		}
+		// Back to the simulation state for input and the next step.
+		scene->InterpolateRender( 1.0f );
 //		SoundManager::Instance()->PlayQueuedSounds();
 	}
 
@@ -690,13 +787,39 @@ void Game::DoTick( U32 _currentTime )
 							XENOENGINE_OPENGL );
 		}
 		if ( debugLevel >= 2 ) {
-			ufoText->Draw(	0,  Y-15, "%4.1fK/f %3ddc/f", 
+			const SpaceTreeStats& cull = engine->CullStats();
+			ufoText->Draw(	0,  Y-15, "%4.1fK/f %3ddc/f cull: nodes=%d planes=%d models=%d boxes=%d upd=%d/%d pyro=%d", 
 							(float)GPUShader::TrianglesDrawn()/1000.0f,
-							GPUShader::DrawCalls() );
+							GPUShader::DrawCalls(),
+							cull.nodesVisited,
+							cull.planesComputed,
+							cull.modelsFound,
+							cull.spheresComputed,
+							cull.updates,
+							cull.relinks,
+							engine->GetMap() ? engine->GetMap()->NumPyro() : 0 );
+			const RenderQueueStats& queue = engine->QueueStats();
+			ufoText->Draw(	0,  Y-30, "queue: items=%d states=%d passes=%d limit=%d gl: %d/%d ui=%d",
+							queue.nItems,
+							queue.nStates,
+							queue.nRadixPasses,
+							queue.nLimitHits,
+							GPUShader::StateCalls(),
+							GPUShader::StateCallsFiltered(),
+							Gamui::ItemsQueued() );
+#ifdef XENOENGINE_NULL_GL
+			const GLRecorder::Stats& rec = GLRecorder::Instance()->GetStats();
+			ufoText->Draw(	0,  Y-60, "null gl: calls=%d draws=%d indices=%d upload=%dK/%dK",
+							GLRecorder::Instance()->TotalCalls(),
+							rec.calls[GLRecorder::DRAW],
+							rec.indices,
+							(int)(rec.bufferBytes/1024),
+							(int)(rec.textureBytes/1024) );
+#endif
 		}
 		if ( debugLevel >= 3 ) {
 			if ( !Engine::mapMakerMode )  {
-				ufoText->Draw(  0, Y-30, "new=%d Tex(%d/%d) %dK/%dK mis=%d reuse=%d hit=%d",
+				ufoText->Draw(  0, Y-45, "new=%d Tex(%d/%d) %dK/%dK mis=%d reuse=%d hit=%d",
 								memNewCount,
 								TextureManager::Instance()->NumTextures(),
 								TextureManager::Instance()->NumGPUResources(),
@@ -710,6 +833,10 @@ void Game::DoTick( U32 _currentTime )
 	}
 #endif
 	GPUShader::ResetTriCount();
+	Gamui::ResetItemsQueued();
+#ifdef XENOENGINE_NULL_GL
+	GLRecorder::Instance()->Clear();
+#endif
 
 #ifdef EL_SHOW_MODELS
 	int k=0;
@@ -731,16 +858,21 @@ void Game::DoTick( U32 _currentTime )
 	for( int i=0; i<Performance::NumData(); ++i ) {
 		const PerformanceData& data = Performance::GetData( i );
 
-		UFOText::Draw( 60,  20+i*12, "%s", data.name );
-		UFOText::Draw( 300, 20+i*12, "%.3f", data.normalTime );
-		UFOText::Draw( 380, 20+i*12, "%d", data.functionCalls/SAMPLE );
+		UFOText::Instance()->Draw( 60,  20+i*12, "%s", data.name );
+		UFOText::Instance()->Draw( 300, 20+i*12, "%.3f", data.normalTime );
+		UFOText::Instance()->Draw( 380, 20+i*12, "%d", data.functionCalls/SAMPLE );
 	}
 #endif
+	// All the text of the frame goes out in one draw, over the UI.
+	UFOText::Instance()->Flush();
 
 	previousTime = currentTime;
 	++currentFrame;
 
 	PushPopScene();
+#ifdef GRINLIZ_PROFILE
+	Performance::EndFrame();
+#endif
 }
 
 
@@ -895,6 +1027,12 @@ void Game::DeviceLoss()
 {
 	TextureManager::Instance()->DeviceLoss();
 	ModelResourceManager::Instance()->DeviceLoss();
+	ParticleSystem::Instance()->DeviceLoss();
+	UIBuffers::DeviceLoss();
+	engine->DeviceLoss();
+	for( SceneNode* node = sceneStack.BeginTop(); node; node = sceneStack.Next() ) {
+		node->scene->DeviceLoss();
+	}
 	GPUShader::ResetState();
 #if XENOENGINE_OPENGL == 2
 	ShaderManager::Instance()->DeviceLoss();
@@ -45,6 +45,7 @@ class TiXmlDocument;
 class Stats;
 class Unit;
 class Research;
+class BattleReplay;
 
 static const float ONE8  = 1.0f / 8.0f;
 static const float ONE16 = 1.0f / 16.0f;
@@ -161,9 +162,20 @@ public:
 
 	bool IsScenePushed() const		{ return sceneQueued.sceneID != NUM_SCENES; }
 
-	U32 CurrentTime() const	{ return currentTime; }
+	// The simulation clock: the time the scenes are ticked at.
+	U32 CurrentTime() const	{ return simTime; }
 	U32 DeltaTime() const	{ return currentTime-previousTime; }
 
+	// Scenes that interpolate (Scene::CanInterpolateRender) are ticked in fixed
+	// steps of SIM_STEP msec, decoupled from the frame rate, and the render
+	// state is interpolated between the last two steps; other scenes are ticked
+	// once per frame. With stepsPerFrame == 0 (the default) the simulation
+	// follows the wall clock; with n > 0 exactly n steps run per rendered frame,
+	// for every scene, which is used to fast forward.
+	enum { SIM_STEP = 16 };
+	void SetSimSteps( int stepsPerFrame )	{ simSteps = stepsPerFrame > 0 ? stepsPerFrame : 0; }
+	int SimSteps() const					{ return simSteps; }
+
 	void SuppressText( bool suppress )	{ suppressText = suppress; }
 	bool IsTextSuppressed() const		{ return suppressText; }
 
@@ -179,6 +191,17 @@ public:
 	void Load( const tinyxml2::XMLDocument& doc );
 	void Save( int slot, bool saveGeo, bool saveTac );
 
+	// Plays a battle out without a player or rendering (see BattleScene::SetHeadless),
+	// from a "BattleScene" element, in at most 'maxSteps' SIM_STEPs. If 'source'
+	// is set the battle is a re-run of it, else 'seed' starts the battle.
+	// Returns the turns played, or -1 if the battle didn't end. 'mismatch' is the
+	// first turn that doesn't match the source (-1 if all do) and 'result' the
+	// BattleData::CalcResult(). The units taken down are added to 'kills', by
+	// ItemDef::index of the weapon (EL_MAX_ITEM_DEFS entries).
+	int RunHeadlessBattle(	const tinyxml2::XMLElement* battleElement, 
+							const BattleReplay* source, U32 seed, int maxSteps,
+							int* mismatch, int* result, int* kills );
+
 	bool PopSound( int* database, int* offset, int* size );
 
 	const Research* GetResearch();
@@ -310,6 +333,12 @@ private:
 	U32 previousTime;
 	bool isDragging;
 
+	int simSteps;
+	U32 simTime;			// time of the last simulation step
+	U32 simAccumulator;		// wall time not yet simulated; < SIM_STEP unless a scene change left steps unrun
+	U32 renderTime;			// simTime + simAccumulator of the last frame
+	bool sceneTickNeeded;	// the scene stack changed: tick the top scene before rendering it
+
 	int rotTestStart;
 	int rotTestCount;
 	grinliz::GLString savePath;
@@ -30,7 +30,8 @@
 enum SavePathType {
 	SAVEPATH_NONE,
 	SAVEPATH_GEO,
-	SAVEPATH_TACTICAL
+	SAVEPATH_TACTICAL,
+	SAVEPATH_REPLAY		// binary BattleReplay of the last battle
 };
 enum SavePathMode {
 	SAVEPATH_READ,
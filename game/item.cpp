@@ -97,12 +97,7 @@ void WeaponItemDef::RenderWeapon(	int mode,
 	//		beam
 
 	if ( first == BEAM ) {
-		BoltEffect* bolt = (BoltEffect*) system->EffectFactory( "BoltEffect" );
-		if ( !bolt ) { 
-			bolt = new BoltEffect( system );
-		}
-		
-		bolt->Clear();
+		BoltEffect* bolt = (BoltEffect*) system->AllocEffect( ParticleEffect::BOLT );
 		bolt->SetColor( cid->color );
 		bolt->SetSpeed( cid->speed );
 		bolt->SetLength( cid->length );
@@ -110,15 +105,9 @@ void WeaponItemDef::RenderWeapon(	int mode,
 		bolt->Init( p0, p1, currentTime );
 
 		*duration = bolt->CalcDuration();
-		system->AddEffect( bolt );
 	}
 	else if ( first == TRAIL ) {
-		SmokeTrailEffect* trail = (SmokeTrailEffect*) system->EffectFactory( "SmokeTrailEffect" );
-		if ( !trail ) {
-			trail = new SmokeTrailEffect( system );
-		}
-
-		trail->Clear();
+		SmokeTrailEffect* trail = (SmokeTrailEffect*) system->AllocEffect( ParticleEffect::SMOKE_TRAIL );
 
 		Color4F c = { 1, 1, 1, 1 };
 
@@ -131,7 +120,6 @@ void WeaponItemDef::RenderWeapon(	int mode,
 		trail->SetSpeed( cid->speed*0.4f );
 		trail->Init( p0, p1, currentTime );
 		*duration = trail->CalcDuration();
-		system->AddEffect( trail );
 	}
 	else {
 		GLASSERT( 0 );
@@ -139,14 +127,10 @@ void WeaponItemDef::RenderWeapon(	int mode,
 
 	if ( useImpact ) {
 
-		ImpactEffect* impact = (ImpactEffect*) system->EffectFactory( "ImpactEffect" );
-		if ( !impact ) {
-			impact = new ImpactEffect( system );
-		}
+		ImpactEffect* impact = (ImpactEffect*) system->AllocEffect( ParticleEffect::IMPACT );
 
 		Vector3F n = p0 - p1;
 		n.Normalize();
-		impact->Clear();
 		impact->Init( p1, currentTime + *duration );
 		impact->SetColor( cid->color );
 		impact->SetNormal( n );
@@ -159,19 +143,13 @@ void WeaponItemDef::RenderWeapon(	int mode,
 			impact->SetConfig( ParticleSystem::PARTICLE_SPHERE );
 
 			// 2nd set of particles:
-			ImpactEffect* impact2 = (ImpactEffect*) system->EffectFactory( "ImpactEffect" );
-			if ( !impact2 ) {
-				impact2 = new ImpactEffect( system );
-			}
-			impact2->Clear();
+			ImpactEffect* impact2 = (ImpactEffect*) system->AllocEffect( ParticleEffect::IMPACT );
 			impact2->Init( p1, currentTime + *duration + 250 );
 			impact2->SetColor( cid->color );
 			impact2->SetNormal( n );
 			impact2->SetRadius( 3.5f );
 			impact2->SetConfig( ParticleSystem::PARTICLE_SPHERE );
-			system->AddEffect( impact2 );
 		}
-		system->AddEffect( impact );
 	}
 }
 
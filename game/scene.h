@@ -97,6 +97,8 @@ public:
 
 	virtual void SceneResult( int sceneID, int result )			{}
 	virtual void ChildActivated( int childID, Scene* childScene, SceneData* data )		{}
+	// The GL context was lost. For GL objects the scene owns directly.
+	virtual void DeviceLoss()									{}
 
 	// Rendering
 	enum {
@@ -116,6 +118,13 @@ public:
 
 	// Perspective rendering.
 	virtual void DoTick( U32 currentTime, U32 deltaTime )		{}
+	// Called before rendering with the fraction [0,1) of a simulation step
+	// that has passed since the last DoTick, so moving objects can be drawn
+	// between steps. Called with 1 after rendering to restore the state.
+	virtual void InterpolateRender( float alpha )				{}
+	// Scenes that don't interpolate are ticked once per frame, with the
+	// frame time, unless the game is fast forwarding.
+	virtual bool CanInterpolateRender() const					{ return false; }
 	// 2D overlay rendering.
 	virtual void DrawHUD()										{}
 
@@ -361,7 +361,17 @@ void TacticalIntroScene::SceneResult( int sceneID, int r )
 
 
 /*static*/ void TacticalIntroScene::WriteXML( FILE* fp, const BattleSceneData* data, const ItemDefArr& itemDefArr, const gamedb::Reader* database )
- {
+{
+	XMLPrinter printer( fp );
+
+	Random random;
+	random.SetSeedFromTime();
+	WriteXML( &printer, data, random.Rand(), itemDefArr, database );
+}
+
+
+/*static*/ void TacticalIntroScene::WriteXML( XMLPrinter* printer, const BattleSceneData* data, U32 seed, const ItemDefArr& itemDefArr, const gamedb::Reader* database )
+{
 	//	Game
 	//		BattleScene
 	//		Map
@@ -372,23 +382,20 @@ void TacticalIntroScene::SceneResult( int sceneID, int r )
 	//		Units
 	//			Unit
 
-	XMLPrinter printer( fp );
-
-	printer.OpenElement( "Game" );
-	printer.PushAttribute( "version", VERSION );
-	printer.PushAttribute( "sceneID", Game::BATTLE_SCENE );
+	printer->OpenElement( "Game" );
+	printer->PushAttribute( "version", VERSION );
+	printer->PushAttribute( "sceneID", Game::BATTLE_SCENE );
 
-	printer.OpenElement( "BattleScene" );
-	printer.PushAttribute( "dayTime", data->dayTime ? 1 : 0 );
-	printer.PushAttribute( "scenario", data->scenario );
+	printer->OpenElement( "BattleScene" );
+	printer->PushAttribute( "dayTime", data->dayTime ? 1 : 0 );
+	printer->PushAttribute( "scenario", data->scenario );
 
-	Random random;
-	random.SetSeedFromTime();
+	Random random( seed );
 
 	int nCivs = ( data->scenario == TERRAN_BASE ) ? data->nScientists : CivsInScenario( data->scenario );
 	SceneInfo info( data->scenario, data->crash, nCivs );
 
-	CreateMap( &printer, random.Rand(), info, database );
+	CreateMap( printer, random.Rand(), info, database );
 
 	BattleData battleData( itemDefArr );
 	battleData.SetDayTime( data->dayTime );
@@ -414,9 +421,9 @@ void TacticalIntroScene::SceneResult( int sceneID, int r )
 					 itemDefArr, 
 					 random.Rand() );
 
-	battleData.Save( &printer );
-	printer.CloseElement();
-	printer.CloseElement();
+	battleData.Save( printer );
+	printer->CloseElement();
+	printer->CloseElement();
 }
 
 
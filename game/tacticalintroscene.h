@@ -166,6 +166,8 @@ public:
 							const gamedb::Reader* database );
 
 	static void WriteXML( FILE* fp, const BattleSceneData* data, const ItemDefArr&, const gamedb::Reader* database  );
+	// Writes the "Game" element; the map and the aliens and civs are generated from 'seed'.
+	static void WriteXML( tinyxml2::XMLPrinter* printer, const BattleSceneData* data, U32 seed, const ItemDefArr&, const gamedb::Reader* database );
 
 	
 private:
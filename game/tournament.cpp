@@ -0,0 +1,347 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tournament.h"
+#include "game.h"
+#include "tacticalintroscene.h"
+#include "battlescenedata.h"
+#include "battledata.h"
+#include "../grinliz/glstringutil.h"
+
+#include "SDL.h"
+
+// Worker processes: see the Tournament comment.
+#if defined( XENOENGINE_NULL_GL ) && !defined( _WIN32 )
+#define TOURNAMENT_FORK
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+using namespace grinliz;
+using namespace tinyxml2;
+
+
+Tournament::Tournament( Game* _game ) : game( _game ), nSeeds( 0 ), nBattles( 0 )
+{
+}
+
+
+void Tournament::FindCells()
+{
+	cells.Clear();
+
+	// TERRAN_BASE is a defense with scientists, not a regular battle.
+	for( int scenario=FIRST_SCENARIO; scenario<TERRAN_BASE; ++scenario ) {
+		for( int crash=0; crash<2; ++crash ) {
+			TacticalIntroScene::SceneInfo info( scenario, crash != 0, 0 );
+			if ( crash && !info.crash )
+				continue;
+
+			for( int squadRank=0; squadRank<NUM_RANKS; ++squadRank ) {
+				for( int alienRank=0; alienRank<NUM_RANKS; ++alienRank ) {
+					for( int day=0; day<2; ++day ) {
+						Cell* c = cells.Push();
+						c->scenario = scenario;
+						c->crash = info.crash;
+						c->squadRank = squadRank;
+						c->alienRank = alienRank;
+						c->day = day != 0;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void Tournament::WriteHeader( FILE* fp )
+{
+	fprintf( fp, "scenario,tileset,crash,squadRank,alienRank,day,battles,"
+				 "win,lose,tie,unfinished,turns,soldiersDown,aliensDown,civsDown,msPerBattle,"
+				 "predWin,predLose,predSoldiersDown,predAliensDown" );
+
+	const ItemDefArr& itemDefArr = game->GetItemDefArr();
+	for( int i=0; i<itemDefArr.Size(); ++i ) {
+		const ItemDef* itemDef = itemDefArr.GetIndex( i );
+		if ( itemDef && itemDef->IsWeapon() )
+			fprintf( fp, ",kills_%s", itemDef->name );
+	}
+	fprintf( fp, "\n" );
+}
+
+
+int Tournament::Run( const char* path, U32 seed, int _nSeeds, int _nBattles, int nWorkers )
+{
+	FILE* fp = fopen( path, "w" );
+	if ( !fp )
+		return -1;
+
+	base.SetSeed( seed );
+	nSeeds = _nSeeds;
+	nBattles = _nBattles;
+	FindCells();
+	WriteHeader( fp );
+	Predict();
+
+	int total = 0;
+
+#ifdef TOURNAMENT_FORK
+	if ( nWorkers <= 0 )
+		nWorkers = SDL_GetCPUCount();
+	nWorkers = Clamp( nWorkers, 1, Min( cells.Size(), (int)MAX_WORKERS ) );
+
+	// Nothing buffered may be written twice.
+	fflush( fp );
+	fflush( stdout );
+	fflush( stderr );
+
+	int nStarted = 0;
+	for( int i=0; i<nWorkers; ++i ) {
+		char partPath[260];
+		SNPrintf( partPath, 260, "%s.%d", path, i );
+
+		pid_t pid = fork();
+		if ( pid == 0 ) {
+			// The worker. _exit() so none of the parent's state is torn down twice.
+			FILE* part = fopen( partPath, "w" );
+			if ( !part )
+				_exit( 1 );
+			RunCells( part, i, nWorkers );
+			fclose( part );
+			_exit( 0 );
+		}
+		if ( pid < 0 ) {
+			GLOUTPUT(( "Tournament: worker %d couldn't be started.\n", i ));
+			break;
+		}
+		++nStarted;
+	}
+
+	bool okay = nStarted == nWorkers;
+	for( int i=0; i<nStarted; ++i ) {
+		int status = 0;
+		wait( &status );
+		if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			okay = false;
+	}
+
+	total = okay ? MergeParts( fp, path, nWorkers ) : -1;
+	for( int i=0; i<nStarted; ++i ) {
+		char partPath[260];
+		SNPrintf( partPath, 260, "%s.%d", path, i );
+		remove( partPath );
+	}
+	if ( total < 0 ) {
+		printf( "Tournament: a worker failed; '%s' is incomplete.\n", path );
+	}
+#else
+	(void)nWorkers;
+	total = RunCells( fp, 0, 1 );
+#endif
+
+	fclose( fp );
+	return total;
+}
+
+
+int Tournament::MergeParts( FILE* fp, const char* path, int nParts )
+{
+	bool okay = true;
+	int total = 0;
+	FILE* part[MAX_WORKERS];
+	GLASSERT( nParts <= MAX_WORKERS );
+
+	for( int i=0; i<nParts; ++i ) {
+		char partPath[260];
+		SNPrintf( partPath, 260, "%s.%d", path, i );
+		part[i] = fopen( partPath, "r" );
+		if ( !part[i] )
+			okay = false;
+	}
+
+	// Worker i has the rows of cells i, i+nParts, ...: deal them back out.
+	char row[MAX_ROW];
+	for( int cell=0; okay && cell<cells.Size(); ++cell ) {
+		int nFought = 0;
+		if (    fgets( row, MAX_ROW, part[cell % nParts] )
+			 && sscanf( row, "%*d,%*[^,],%*d,%*d,%*d,%*d,%d", &nFought ) == 1 )
+		{
+			fputs( row, fp );
+			total += nFought;
+		}
+		else {
+			okay = false;
+		}
+	}
+
+	for( int i=0; i<nParts; ++i ) {
+		if ( part[i] )
+			fclose( part[i] );
+	}
+	return okay ? total : -1;
+}
+
+
+const XMLElement* Tournament::CreateBattle( int cellIndex, int s, XMLDocument* doc, Random* random )
+{
+	const Cell& cell = cells[cellIndex];
+
+	// Each seed of a cell has its own stream, so its numbers don't depend on
+	// the sweep order, the other parameters, or which worker plays it.
+	*random = base.Stream( (U32)(cellIndex*nSeeds + s) );
+
+	Unit soldiers[MAX_TERRANS];
+	TacticalIntroScene::GenerateTerranTeam( soldiers, MAX_TERRANS, (float)cell.squadRank, game->GetItemDefArr(), random->Rand() );
+
+	BattleSceneData data;
+	data.seed = 0;
+	data.scenario = cell.scenario;
+	data.crash = cell.crash;
+	data.dayTime = cell.day;
+	data.alienRank = (float)cell.alienRank;
+	data.soldierUnits = soldiers;
+	data.nScientists = 0;
+	data.storage = 0;
+
+	XMLPrinter printer;
+	TacticalIntroScene::WriteXML( &printer, &data, random->Rand(), game->GetItemDefArr(), game->GetDatabase() );
+	doc->Parse( printer.CStr() );
+	const XMLElement* battleElement = doc->RootElement() ? doc->RootElement()->FirstChildElement( "BattleScene" ) : 0;
+	GLASSERT( battleElement );
+	return battleElement;
+}
+
+
+void Tournament::Predict()
+{
+	predictions.Clear();
+	for( int cell=0; cell<cells.Size(); ++cell ) {
+		AutoResolveResult* p = predictions.Push();
+		memset( p, 0, sizeof(*p) );
+
+		int n = 0;
+		for( int s=0; s<nSeeds; ++s ) {
+			XMLDocument doc;
+			Random random;
+			const XMLElement* battleElement = CreateBattle( cell, s, &doc, &random );
+			if ( !battleElement )
+				continue;
+
+			// The same teams the battles are played with.
+			BattleData teams( game->GetItemDefArr() );
+			teams.Load( battleElement );
+			AutoResolve autoResolve( teams.Units( TERRAN_UNITS_START ), teams.Units( ALIEN_UNITS_START ), teams.Units( CIV_UNITS_START ), cells[cell].day );
+
+			AutoResolveResult result;
+			autoResolve.Run( random.Rand(), NUM_PREDICT, 0, &result );
+			p->victory		+= result.victory;
+			p->defeat		+= result.defeat;
+			p->soldiersDown	+= result.soldiersDown;
+			p->aliensDown	+= result.aliensDown;
+			++n;
+		}
+		if ( n ) {
+			p->victory		/= (float)n;
+			p->defeat		/= (float)n;
+			p->soldiersDown	/= (float)n;
+			p->aliensDown	/= (float)n;
+		}
+	}
+}
+
+
+int Tournament::RunCells( FILE* fp, int first, int stride )
+{
+	int total = 0;
+	for( int cell=first; cell<cells.Size(); cell+=stride ) {
+		total += RunCell( fp, cell );
+		if ( cell+stride >= cells.Size() || cells[cell+stride].scenario != cells[cell].scenario ) {
+			GLOUTPUT(( "Tournament: scenario %d done. battles=%d\n", cells[cell].scenario, total ));
+		}
+	}
+	return total;
+}
+
+
+int Tournament::RunCell( FILE* fp, int cellIndex )
+{
+	const Cell& cell = cells[cellIndex];
+	const double freq = (double)SDL_GetPerformanceFrequency();
+	TacticalIntroScene::SceneInfo info( cell.scenario, cell.crash, TacticalIntroScene::CivsInScenario( cell.scenario ) );
+
+	int nFought = 0;
+	int count[4] = { 0 };		// by BattleData::CalcResult(); 0 is unfinished
+	int turns = 0;
+	int down[NUM_TEAMS] = { 0 };
+	int kills[EL_MAX_ITEM_DEFS] = { 0 };
+	U64 ticks = 0;
+
+	for( int s=0; s<nSeeds; ++s ) {
+		XMLDocument doc;
+		Random random;
+		const XMLElement* battleElement = CreateBattle( cellIndex, s, &doc, &random );
+		if ( !battleElement )
+			continue;
+
+		for( int b=0; b<nBattles; ++b ) {
+			int result = 0;
+			U64 start = SDL_GetPerformanceCounter();
+			int t = game->RunHeadlessBattle( battleElement, 0, random.Rand(), MAX_STEPS, 0, &result, kills );
+			ticks += SDL_GetPerformanceCounter() - start;
+
+			++nFought;
+			if ( t >= 0 ) {
+				turns += t;
+				GLASSERT( result >= 0 && result < 4 );
+				count[result]++;
+			}
+			else {
+				count[0]++;
+			}
+
+			// The battle's units are still in the BattleData.
+			const Unit* units = game->battleData.UnitsPtr();
+			for( int i=0; i<MAX_UNITS; ++i ) {
+				if ( units[i].InUse() && !units[i].IsAlive() )
+					down[units[i].Team()]++;
+			}
+		}
+	}
+
+	const float n = nFought ? (float)nFought : 1.0f;
+	const int nFinished = nFought - count[0];
+	const char* tileset = info.Base();
+	const AutoResolveResult& predict = predictions[cellIndex];
+	fprintf( fp, "%d,%s,%d,%d,%d,%d,%d,"
+				 "%.4f,%.4f,%.4f,%.4f,%.2f,%.3f,%.3f,%.3f,%.1f,"
+				 "%.4f,%.4f,%.3f,%.3f",
+			 cell.scenario, *tileset ? tileset : "-", cell.crash ? 1 : 0, cell.squadRank, cell.alienRank, cell.day ? 1 : 0, nFought,
+			 (float)count[BattleData::VICTORY] / n, (float)count[BattleData::DEFEAT] / n, (float)count[BattleData::TIE] / n,
+			 (float)count[0] / n,
+			 nFinished ? (float)turns / (float)nFinished : 0.0f,
+			 (float)down[TERRAN_TEAM] / n, (float)down[ALIEN_TEAM] / n, (float)down[CIV_TEAM] / n,
+			 (double)ticks * 1000.0 / freq / (double)n,
+			 predict.victory, predict.defeat, predict.soldiersDown, predict.aliensDown );
+
+	const ItemDefArr& itemDefArr = game->GetItemDefArr();
+	for( int i=0; i<itemDefArr.Size(); ++i ) {
+		const ItemDef* itemDef = itemDefArr.GetIndex( i );
+		if ( itemDef && itemDef->IsWeapon() )
+			fprintf( fp, ",%.3f", (float)kills[i] / n );
+	}
+	fprintf( fp, "\n" );
+	fflush( fp );
+	return nFought;
+}
@@ -0,0 +1,105 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UFO_TOURNAMENT_INCLUDED
+#define UFO_TOURNAMENT_INCLUDED
+
+#include <stdio.h>
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glrandom.h"
+#include "../engine/ufoutil.h"
+#include "autoresolve.h"
+
+class Game;
+namespace tinyxml2 {
+	class XMLDocument;
+	class XMLElement;
+}
+
+
+/*
+	Balance tournament. Sweeps scenario (which implies the tile set), crash,
+	squad rank, alien rank, and day/night. Every combination (a cell) gets
+	'nSeeds' freshly generated maps and teams, and each of those is played out
+	'nBattles' times on the map, AI against AI, by headless BattleScenes
+	(Game::RunHeadlessBattle).
+
+	Before the battles, each cell's teams are run through AutoResolve (on all
+	the cores, in this process) for the statistical prediction, so the CSV
+	shows how far it is from the played out battles.
+
+	The cells are dealt out to worker processes, one per core. A worker is a
+	fork of this process, so it has its own copy of the Game and plays its
+	cells in its own BattleScene; it writes its rows to a part file next to
+	the CSV, and the parts are merged back in sweep order. A GL context can't
+	be shared with a forked child, so the workers need the null GL build
+	(XENOWAR_NULL_GL); in a GL build, and on Windows, the sweep runs in this
+	process.
+
+	Writes one CSV row per cell: win/lose/tie rates, battles that didn't end,
+	turns, units down, wall time per battle, the AutoResolve prediction, and
+	kills per battle for every weapon.
+*/
+class Tournament
+{
+public:
+	Tournament( Game* game );
+
+	// nWorkers=0 uses all the cores. Returns the number of battles
+	// fought, or -1 if 'path' can't be written.
+	int Run( const char* path, U32 seed, int nSeeds, int nBattles, int nWorkers );
+
+private:
+	enum {
+		NUM_RANKS = 5,				// squad and alien rank 0-4
+		MAX_STEPS = 200*1000,		// ~53 minutes of battle; a battle that long is stuck
+		MAX_WORKERS = 64,
+		NUM_PREDICT = 200,			// AutoResolve battles per seed
+		MAX_ROW = 4096
+	};
+
+	struct Cell {
+		int  scenario;
+		bool crash;
+		int  squadRank;
+		int  alienRank;
+		bool day;
+	};
+
+	void FindCells();
+	void WriteHeader( FILE* fp );
+	// Generates seed 's' of a cell into 'doc'. Returns the BattleScene element,
+	// and leaves 'random' ready to seed its battles.
+	const tinyxml2::XMLElement* CreateBattle( int cell, int s, tinyxml2::XMLDocument* doc, grinliz::Random* random );
+	// Fills in the AutoResolve prediction of every cell.
+	void Predict();
+	// Plays cells 'first', first+stride, ... and writes a row for each.
+	// Returns the number of battles fought.
+	int RunCells( FILE* fp, int first, int stride );
+	int RunCell( FILE* fp, int cell );
+	// Copies the rows of the parts to 'fp', in cell order. Returns the
+	// number of battles in them, or -1 if a part is missing rows.
+	int MergeParts( FILE* fp, const char* path, int nParts );
+
+	Game* game;
+	grinliz::Random base;
+	int nSeeds;
+	int nBattles;
+	CDynArray< Cell > cells;
+	CDynArray< AutoResolveResult > predictions;	// by cell, averaged over the seeds
+};
+
+
+#endif // UFO_TOURNAMENT_INCLUDED
@@ -494,6 +494,29 @@ void Unit::NewTurn()
 
 
 
+U64 Unit::StateHash( U64 h ) const
+{
+	h = Random::Hash64( &status, sizeof(status), h );
+	if ( status == STATUS_NOT_INIT )
+		return h;
+
+	h = Random::Hash64( &team, sizeof(team), h );
+	h = Random::Hash64( &type, sizeof(type), h );
+	h = Random::Hash64( &pos, sizeof(pos), h );
+	h = Random::Hash64( &rot, sizeof(rot), h );
+	h = Random::Hash64( &tu, sizeof(tu), h );
+	h = Random::Hash64( &hp, sizeof(hp), h );
+	h = Random::Hash64( &kills, sizeof(kills), h );
+
+	for( int i=0; i<Inventory::NUM_SLOTS; ++i ) {
+		Item item = inventory.GetItem( i );
+		int id[2] = { item.GetItemDef() ? item.GetItemDef()->index : -1, item.Rounds() };
+		h = Random::Hash64( id, sizeof(id), h );
+	}
+	return h;
+}
+
+
 void Unit::Save( XMLPrinter* printer ) const
 {
 	if ( status != STATUS_NOT_INIT ) {
@@ -910,6 +933,7 @@ void UnitRenderer::Update( SpaceTree* _tree, const Unit* unit )
 	if ( !model && resource ) {
 		GLASSERT( resource );
 		model = tree->AllocModel( resource );
+		model->SetUserData( (void*)unit );
 		if ( !shadow )
 			model->SetFlag( Model::MODEL_NO_SHADOW );
 		if ( texture )
@@ -928,13 +952,20 @@ void UnitRenderer::Update( SpaceTree* _tree, const Unit* unit )
 	}
 	if ( !weapon && weaponResource ) {
 		weapon = tree->AllocModel( weaponResource );
+		weapon->SetUserData( (void*)unit );
 		weapon->SetFlag( Model::MODEL_NO_SHADOW );
 	}
 
+	Place( unit->Pos(), unit->Rotation() );
+}
+
+
+void UnitRenderer::Place( const grinliz::Vector3F& pos, float rotation )
+{
 	// The model checks for redundancy.
 	if ( model ) {
-		model->SetPos( unit->Pos() );
-		model->SetRotation( unit->Rotation() );
+		model->SetPos( pos );
+		model->SetRotation( rotation );
 	}
 
 	if ( weapon && model ) {
@@ -98,6 +98,8 @@ public:
 	const char* AlienShortName() const;
 
 	void SetAI( int value )		{ ai = value; }
+	// The unit's own stream (KIA vs. unconscious rolls.)
+	void SetRandomSeed( U32 seed )	{ random.SetSeed( seed ); }
 
 	const char* FirstName() const;
 	const char* LastName() const;
@@ -189,6 +191,9 @@ public:
 	const U32 Body() const			{ return body; }
 
 	void Save( tinyxml2::XMLPrinter* printer ) const;
+	// Hash of the battle state of the unit (status, position, tu, hp, inventory.)
+	// Pass the previous result as 'h' to hash many units.
+	U64 StateHash( U64 h ) const;
 
 	// Loads the model. Follow with InitModel() if models needed.
 	void Load( const tinyxml2::XMLElement* doc, const ItemDefArr& arr );
@@ -273,6 +278,9 @@ public:
 	~UnitRenderer();
 
 	void Update( SpaceTree* tree, const Unit* unit );
+	// Move the models (and the weapon with them) without touching the unit;
+	// used to draw a unit between simulation steps.
+	void Place( const grinliz::Vector3F& pos, float rotation );
 
 	const Model* GetModel() const		{ return model; }
 	const Model* GetWeapon() const		{ return weapon; }
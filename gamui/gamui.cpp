@@ -89,7 +89,16 @@ void Matrix::SetZRotation( float theta )
 
 
 UIItem::UIItem( int p_level ) 
-	: m_x( 0 ),
+	: m_change( CHANGE_LAYOUT ),
+	  m_needsRender( false ),
+	  m_queued( false ),
+	  m_vertexStart( 0 ),
+	  m_nVertex( 0 ),
+	  m_indexStart( 0 ),
+	  m_nIndex( 0 ),
+	  m_renderState( 0 ),
+	  m_textureHandle( 0 ),
+	  m_x( 0 ),
 	  m_y( 0 ),
 	  m_level( p_level ),
 	  m_visible( true ),
@@ -821,7 +830,8 @@ void Button::SetSize( float width, float height )
 	float size = Min( width, height );
 	m_deco.SetSize( size, size );
 	m_icon.SetSize( size*0.5f, size*0.5f );
-	// Modify(); don't call let sub-functions check
+	// The children are positioned from the face size.
+	Modify();
 }
 
 
@@ -835,6 +845,8 @@ void Button::SetText( const char* text )
 	else {
 		m_label[0].SetText( text );	// calls Modify()
 	}
+	// The label is centered by its width.
+	Modify();
 }
 
 
@@ -1148,11 +1160,16 @@ void DigitalBar::Queue( CDynArray< uint16_t > *indexBuf, CDynArray< Gamui::Verte
 }
 
 
+int Gamui::s_itemsQueued = 0;
+
+
 Gamui::Gamui()
 	:	m_itemTapped( 0 ),
 		m_iText( 0 ),
 		m_orderChanged( true ),
 		m_modified( true ),
+		m_itemModified( true ),
+		m_layoutAll( true ),
 		m_itemArr( 0 ),
 		m_nItems( 0 ),
 		m_nItemsAllocated( 0 ),
@@ -1160,8 +1177,13 @@ Gamui::Gamui()
 		m_dragEnd( 0 ),
 		m_textHeight( 16 ),
 		m_focus( -1 ),
-		m_focusImage( 0 )
+		m_focusImage( 0 ),
+		m_buffers( 0 ),
+		m_buffersChecked( false ),
+		m_hitDirty( true )
 {
+	ClearDirty();
+	m_dirty.resized = true;
 }
 
 
@@ -1173,19 +1195,28 @@ Gamui::Gamui(	IGamuiRenderer* renderer,
 		m_iText( 0 ),
 		m_orderChanged( true ),
 		m_modified( true ),
+		m_itemModified( true ),
+		m_layoutAll( true ),
 		m_itemArr( 0 ),
 		m_nItems( 0 ),
 		m_nItemsAllocated( 0 ),
 		m_textHeight( 16 ),
 		m_focus( -1 ),
-		m_focusImage( 0 )
+		m_focusImage( 0 ),
+		m_buffers( 0 ),
+		m_buffersChecked( false ),
+		m_hitDirty( true )
 {
+	ClearDirty();
 	Init( renderer, textEnabled, textDisabled, iText );
 }
 
 
 Gamui::~Gamui()
 {
+	if ( m_buffers ) {
+		m_iRenderer->DestroyBuffers( m_buffers );
+	}
 	delete m_focusImage;
 	for( int i=0; i<m_nItems; ++i ) {
 		m_itemArr[i]->Clear();
@@ -1199,6 +1230,12 @@ void Gamui::Init(	IGamuiRenderer* renderer,
 					const RenderAtom& textDisabled,
 					IGamuiText* iText )
 {
+	if ( m_buffers ) {
+		m_iRenderer->DestroyBuffers( m_buffers );
+		m_buffers = 0;
+	}
+	m_buffersChecked = false;
+	m_dirty.resized = true;
 	m_iRenderer = renderer;
 	m_textAtomEnabled = textEnabled;
 	m_textAtomDisabled = textDisabled;
@@ -1213,6 +1250,7 @@ void Gamui::Add( UIItem* item )
 		m_itemArr = (UIItem**) realloc( m_itemArr, m_nItemsAllocated*sizeof(UIItem*) );
 	}
 	m_itemArr[m_nItems++] = item;
+	item->m_change = UIItem::CHANGE_LAYOUT;
 	OrderChanged();
 }
 
@@ -1249,13 +1287,107 @@ const UIItem* Gamui::Tap( float x, float y )
 }
 
 
+void Gamui::BuildHitGrid()
+{
+	m_hitDirty = false;
+	m_hitItems.Clear();
+	memset( m_hitStart, 0, sizeof(m_hitStart) );
+	m_hitScaleX = m_hitScaleY = 0;
+
+	// Enabled and visible are checked by the tap; the grid has every item
+	// that could be tapped, so only a move or resize invalidates it.
+	float x0=0, y0=0, x1=0, y1=0;
+	bool any = false;
+	for( int i=0; i<m_nItems; ++i ) {
+		UIItem* item = m_itemArr[i];
+		if ( item->CanHandleTap() ) {
+			float ix1 = item->X() + item->Width();
+			float iy1 = item->Y() + item->Height();
+			if ( !any ) {
+				x0 = item->X(); y0 = item->Y(); x1 = ix1; y1 = iy1;
+				any = true;
+			}
+			else {
+				if ( item->X() < x0 ) x0 = item->X();
+				if ( item->Y() < y0 ) y0 = item->Y();
+				if ( ix1 > x1 ) x1 = ix1;
+				if ( iy1 > y1 ) y1 = iy1;
+			}
+		}
+	}
+	if ( !any )
+		return;
+
+	m_hitX0 = x0;
+	m_hitY0 = y0;
+	m_hitScaleX = ( x1 > x0 ) ? (float)HIT_GRID / ( x1 - x0 ) : 1.0f;
+	m_hitScaleY = ( y1 > y0 ) ? (float)HIT_GRID / ( y1 - y0 ) : 1.0f;
+
+	// Counting sort into the buckets: count, offset, fill. Each bucket
+	// keeps the m_itemArr order, so the first hit is the same as a scan.
+	int count[HIT_GRID*HIT_GRID+1];
+	for( int pass=0; pass<2; ++pass ) {
+		if ( pass == 1 ) {
+			for( int c=0; c<HIT_GRID*HIT_GRID; ++c ) {
+				m_hitStart[c+1] += m_hitStart[c];
+				count[c] = m_hitStart[c];
+			}
+			m_hitItems.PushArr( m_hitStart[HIT_GRID*HIT_GRID] );
+		}
+		for( int i=0; i<m_nItems; ++i ) {
+			UIItem* item = m_itemArr[i];
+			if ( !item->CanHandleTap() )
+				continue;
+
+			int cx0 = HitCell( item->X(), x0, m_hitScaleX );
+			int cy0 = HitCell( item->Y(), y0, m_hitScaleY );
+			int cx1 = HitCell( item->X() + item->Width(), x0, m_hitScaleX );
+			int cy1 = HitCell( item->Y() + item->Height(), y0, m_hitScaleY );
+
+			for( int cy=cy0; cy<=cy1; ++cy ) {
+				for( int cx=cx0; cx<=cx1; ++cx ) {
+					int c = cy*HIT_GRID + cx;
+					if ( pass == 0 )
+						m_hitStart[c+1]++;
+					else
+						m_hitItems[count[c]++] = i;
+				}
+			}
+		}
+	}
+}
+
+
+int Gamui::HitCandidates( float x, float y, const int** items )
+{
+	if ( m_hitDirty ) {
+		BuildHitGrid();
+	}
+	*items = 0;
+	if ( m_hitScaleX == 0 || x < m_hitX0 || y < m_hitY0 )
+		return 0;
+
+	int cx = (int)(( x - m_hitX0 ) * m_hitScaleX );
+	int cy = (int)(( y - m_hitY0 ) * m_hitScaleY );
+	if ( cx >= HIT_GRID || cy >= HIT_GRID )
+		return 0;
+
+	int c = cy*HIT_GRID + cx;
+	*items = m_hitItems.Mem() + m_hitStart[c];
+	return m_hitStart[c+1] - m_hitStart[c];
+}
+
+
 void Gamui::TapDown( float x, float y )
 {
 	GAMUIASSERT( m_itemTapped == 0 );
 	m_itemTapped = 0;
 
-	for( int i=0; i<m_nItems; ++i ) {
-		UIItem* item = m_itemArr[i];
+	const int* candidate = 0;
+	int nCandidates = HitCandidates( x, y, &candidate );
+
+	for( int k=0; k<nCandidates; ++k ) {
+		UIItem* item = m_itemArr[candidate[k]];
 
 		if (	item->CanHandleTap()    
 			 && item->Enabled() 
@@ -1284,8 +1416,11 @@ const UIItem* Gamui::TapUp( float x, float y )
 	m_itemTapped = 0;
 
 	m_dragEnd = 0;
-	for( int i=0; i<m_nItems; ++i ) {
-		UIItem* item = m_itemArr[i];
+	const int* candidate = 0;
+	int nCandidates = HitCandidates( x, y, &candidate );
+
+	for( int k=0; k<nCandidates; ++k ) {
+		UIItem* item = m_itemArr[candidate[k]];
 
 		if (    item->CanHandleTap()
 			 &&	item->Enabled() 
@@ -1369,40 +1504,16 @@ void Gamui::Render()
 	if ( m_orderChanged ) {
 		qsort( m_itemArr, m_nItems, sizeof(UIItem*), SortItems );
 		m_orderChanged = false;
+		m_modified = true;
+		m_hitDirty = true;
 	}
 
-	if ( m_modified ) {
-		State* state = 0;
-
-		m_stateBuffer.Clear();
-		m_indexBuffer.Clear();
-		m_vertexBuffer.Clear();
-
-		for( int i=0; i<m_nItems; ++i ) {
-			UIItem* item = m_itemArr[i];
-			const RenderAtom* atom = item->GetRenderAtom();
-
-			// Requires() does layout / sets child visibility. Can't skip this step:
-			bool needsToRender = item->DoLayout();
-
-			if ( !needsToRender || !item->Visible() || !atom || !atom->textureHandle )
-				continue;
-
-			// Do we need a new state?
-			if (    !state
-				 || atom->renderState   != state->renderState
-				 || atom->textureHandle != state->textureHandle ) 
-			{
-				state = m_stateBuffer.PushArr( 1 );
-				state->vertexStart = m_vertexBuffer.Size();
-				state->indexStart = m_indexBuffer.Size();
-				state->renderState = atom->renderState;
-				state->textureHandle = atom->textureHandle;
-			}
-			item->Queue( &m_indexBuffer, &m_vertexBuffer );
+	if ( m_modified || m_itemModified ) {
+		LayoutItems();
+		m_itemModified = false;
 
-			state->nVertex = (uint16_t)m_vertexBuffer.Size() - state->vertexStart;
-			state->nIndex  = (uint16_t)m_indexBuffer.Size() - state->indexStart;
+		if ( m_modified || !Requeue() ) {
+			Rebuild();
 		}
 		m_modified = false;
 	}
@@ -1412,6 +1523,17 @@ void Gamui::Render()
 		return;
 	}
 
+	if ( !m_buffersChecked ) {
+		m_buffers = m_iRenderer->CreateBuffers();
+		m_buffersChecked = true;
+	}
+	if ( m_buffers ) {
+		m_iRenderer->UploadBuffers( m_buffers, m_dirty, 
+									m_indexBuffer.Mem(), m_indexBuffer.Size(), 
+									m_vertexBuffer.Mem(), m_vertexBuffer.Size() );
+		ClearDirty();
+	}
+
 	const void* renderState = 0;
 	const void* textureHandle = 0;
 
@@ -1428,15 +1550,145 @@ void Gamui::Render()
 			textureHandle = state.textureHandle;
 		}
 
-		m_iRenderer->Render(	renderState, 
-								textureHandle, 
-								state.nIndex, &m_indexBuffer[state.indexStart], 
-								state.nVertex, &m_vertexBuffer[0] );
+		if ( m_buffers ) {
+			m_iRenderer->RenderBuffers( m_buffers, renderState, textureHandle, state.indexStart, state.nIndex );
+		}
+		else {
+			m_iRenderer->Render(	renderState, 
+									textureHandle, 
+									state.nIndex, &m_indexBuffer[state.indexStart], 
+									state.nVertex, &m_vertexBuffer[0] );
+		}
 	}
 	m_iRenderer->EndRender();
 }
 
 
+void Gamui::LayoutItems()
+{
+	// DoLayout() positions (and so modifies) children, which may already
+	// have been passed. Repeat until a pass finds nothing to lay out.
+	bool again = true;
+	while( again ) {
+		again = false;
+		for( int i=0; i<m_nItems; ++i ) {
+			UIItem* item = m_itemArr[i];
+			if ( m_layoutAll || item->m_change == UIItem::CHANGE_LAYOUT ) {
+				item->m_change = UIItem::CHANGE_QUEUE;
+				item->m_needsRender = item->DoLayout();
+				again = true;
+			}
+		}
+		m_layoutAll = false;
+	}
+}
+
+
+bool Gamui::Requeue()
+{
+	// Write the changed items back into the ranges they had in the last
+	// Rebuild(). Anything that changes state, visibility, or outgrows
+	// its range needs a full rebuild.
+	for( int i=0; i<m_nItems; ++i ) {
+		UIItem* item = m_itemArr[i];
+		if ( item->m_change == UIItem::CHANGE_NONE )
+			continue;
+
+		const RenderAtom* atom = item->GetRenderAtom();
+		bool render = item->m_needsRender && item->Visible() && atom && atom->textureHandle;
+		if ( render != item->m_queued )
+			return false;
+
+		if ( render ) {
+			if (    atom->renderState != item->m_renderState
+				 || atom->textureHandle != item->m_textureHandle )
+			{
+				return false;
+			}
+			m_scratchIndex.Clear();
+			m_scratchVertex.Clear();
+			item->Queue( &m_scratchIndex, &m_scratchVertex );
+
+			int nVertex = m_scratchVertex.Size();
+			int nIndex = m_scratchIndex.Size();
+			if ( nVertex > item->m_nVertex || nIndex > item->m_nIndex )
+				return false;
+
+			if ( nVertex ) {
+				memcpy( &m_vertexBuffer[item->m_vertexStart], m_scratchVertex.Mem(), nVertex*sizeof(Vertex) );
+			}
+			uint16_t* index = m_indexBuffer.Mem() + item->m_indexStart;
+			for( int k=0; k<nIndex; ++k ) {
+				index[k] = (uint16_t)(m_scratchIndex[k] + item->m_vertexStart);
+			}
+			// Pad a shrunk item with degenerate triangles.
+			for( int k=nIndex; k<item->m_nIndex; ++k ) {
+				index[k] = (uint16_t)item->m_vertexStart;
+			}
+
+			if ( item->m_vertexStart < m_dirty.vertex0 )				m_dirty.vertex0 = item->m_vertexStart;
+			if ( item->m_vertexStart + nVertex > m_dirty.vertex1 )		m_dirty.vertex1 = item->m_vertexStart + nVertex;
+			if ( item->m_indexStart < m_dirty.index0 )					m_dirty.index0 = item->m_indexStart;
+			if ( item->m_indexStart + item->m_nIndex > m_dirty.index1 )	m_dirty.index1 = item->m_indexStart + item->m_nIndex;
+			++s_itemsQueued;
+		}
+		item->m_change = UIItem::CHANGE_NONE;
+	}
+	return true;
+}
+
+
+void Gamui::Rebuild()
+{
+	State* state = 0;
+
+	m_stateBuffer.Clear();
+	m_indexBuffer.Clear();
+	m_vertexBuffer.Clear();
+	m_dirty.resized = true;
+
+	for( int i=0; i<m_nItems; ++i ) {
+		UIItem* item = m_itemArr[i];
+
+		// Items added by a layout in this frame haven't been laid out.
+		if ( item->m_change == UIItem::CHANGE_LAYOUT ) {
+			item->m_needsRender = item->DoLayout();
+		}
+		item->m_change = UIItem::CHANGE_NONE;
+		item->m_queued = false;
+
+		const RenderAtom* atom = item->GetRenderAtom();
+		if ( !item->m_needsRender || !item->Visible() || !atom || !atom->textureHandle )
+			continue;
+
+		// Do we need a new state?
+		if (    !state
+			 || atom->renderState   != state->renderState
+			 || atom->textureHandle != state->textureHandle ) 
+		{
+			state = m_stateBuffer.PushArr( 1 );
+			state->vertexStart = m_vertexBuffer.Size();
+			state->indexStart = m_indexBuffer.Size();
+			state->renderState = atom->renderState;
+			state->textureHandle = atom->textureHandle;
+		}
+		item->m_queued = true;
+		item->m_renderState = atom->renderState;
+		item->m_textureHandle = atom->textureHandle;
+		item->m_vertexStart = m_vertexBuffer.Size();
+		item->m_indexStart = m_indexBuffer.Size();
+
+		item->Queue( &m_indexBuffer, &m_vertexBuffer );
+		++s_itemsQueued;
+
+		item->m_nVertex = m_vertexBuffer.Size() - item->m_vertexStart;
+		item->m_nIndex = m_indexBuffer.Size() - item->m_indexStart;
+		state->nVertex = (uint16_t)m_vertexBuffer.Size() - state->vertexStart;
+		state->nIndex  = (uint16_t)m_indexBuffer.Size() - state->indexStart;
+	}
+}
+
+
 void Gamui::Layout( UIItem** item, int nItems,
 					int cx, int cy,
 					float originX, float originY,
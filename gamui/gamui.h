@@ -221,6 +221,13 @@ public:
 		void Set( float _x, float _y, float _tx, float _ty ) { x = _x; y = _y; tx = _tx; ty = _ty; }
 	};
 
+	/// What changed in the buffers since the last Render(); see IGamuiRenderer::UploadBuffers().
+	struct Dirty {
+		bool resized;			///< everything changed
+		int index0, index1;		///< changed indices [index0,index1); empty if index1 <= index0
+		int vertex0, vertex1;	///< changed vertices [vertex0,vertex1)
+	};
+
 	/// Construct and Init later.
 	Gamui();
 	/// Constructor
@@ -240,8 +247,11 @@ public:
 	void Add( UIItem* item );
 	// normally not called by user code.
 	void Remove( UIItem* item );
-	void OrderChanged() { m_orderChanged = true; m_modified = true; }
-	void Modify()		{ m_modified = true; }
+	void OrderChanged() { m_orderChanged = true; m_modified = true; m_hitDirty = true; }
+	/// Lay out and re-queue every item on the next Render().
+	void Modify()		{ m_modified = true; m_layoutAll = true; m_hitDirty = true; }
+	// normally not called by user code. An item changed; only it is re-queued.
+	void ItemModified()	{ m_itemModified = true; m_hitDirty = true; }
 
 	/// Call to begin the rendering pass and commit all the UIItems to the display.
 	void Render();
@@ -250,7 +260,7 @@ public:
 	RenderAtom* GetDisabledTextAtom()		{ return &m_textAtomDisabled; }
 
 	IGamuiText* GetTextInterface() const	{ return m_iText; }
-	void SetTextHeight( float h )			{ m_textHeight = h; }
+	void SetTextHeight( float h )			{ if ( h != m_textHeight ) { m_textHeight = h; Modify(); } }
 	float GetTextHeight() const				{ return m_textHeight; }
 
 	/** Feed touch/mouse events to Gamui. You should use TapDown/TapUp as a pair, OR just use Tap. TapDown/Up
@@ -302,8 +312,24 @@ public:
 	float			GetFocusX();
 	float			GetFocusY();
 
+	/// Items re-queued by all Gamui instances since the last ResetItemsQueued().
+	static int		ItemsQueued()			{ return s_itemsQueued; }
+	static void		ResetItemsQueued()		{ s_itemsQueued = 0; }
+
 private:
 	static int SortItems( const void* a, const void* b );
+	void LayoutItems();
+	bool Requeue();
+	void Rebuild();
+	void BuildHitGrid();
+	static int HitCell( float v, float v0, float scale ) {
+		int c = (int)(( v - v0 ) * scale );
+		return c < 0 ? 0 : ( c >= HIT_GRID ? HIT_GRID-1 : c );
+	}
+	int HitCandidates( float x, float y, const int** items );
+	void ClearDirty()	{ m_dirty.resized = false; m_dirty.index0 = m_dirty.vertex0 = 0x10000; m_dirty.index1 = m_dirty.vertex1 = 0; }
+
+	static int						s_itemsQueued;
 
 	UIItem*							m_itemTapped;
 	RenderAtom						m_textAtomEnabled;
@@ -312,7 +338,9 @@ private:
 	IGamuiText*						m_iText;
 
 	bool			m_orderChanged;
-	bool			m_modified;
+	bool			m_modified;		// full rebuild needed
+	bool			m_itemModified;	// some items need layout or re-queue
+	bool			m_layoutAll;
 	UIItem**		m_itemArr;
 	int				m_nItems;
 	int				m_nItemsAllocated;
@@ -321,6 +349,9 @@ private:
 	float			m_textHeight;
 	int				m_focus;
 	Image*			m_focusImage;
+	void*			m_buffers;			// from IGamuiRenderer::CreateBuffers(), or null
+	bool			m_buffersChecked;
+	Dirty			m_dirty;
 
 	struct State {
 		uint16_t	vertexStart;
@@ -340,6 +371,17 @@ private:
 	CDynArray< State >				m_stateBuffer;
 	CDynArray< uint16_t >			m_indexBuffer;
 	CDynArray< Vertex >				m_vertexBuffer;
+	CDynArray< uint16_t >			m_scratchIndex;
+	CDynArray< Vertex >				m_scratchVertex;
+
+	// Hit testing: the items that can handle taps, bucketed by a uniform
+	// grid over their bounds. Rebuilt on the first tap after a change.
+	enum { HIT_GRID = 8 };
+	bool							m_hitDirty;
+	float							m_hitX0, m_hitY0;
+	float							m_hitScaleX, m_hitScaleY;
+	int								m_hitStart[HIT_GRID*HIT_GRID+1];
+	CDynArray< int >				m_hitItems;		// indices into m_itemArr
 };
 
 
@@ -353,6 +395,17 @@ public:
 	virtual void BeginRenderState( const void* renderState ) = 0;
 	virtual void BeginTexture( const void* textureHandle ) = 0;
 	virtual void Render( const void* renderState, const void* textureHandle, int nIndex, const uint16_t* index, int nVertex, const Gamui::Vertex* vertex ) = 0;
+
+	/** Optional buffer mode. If CreateBuffers() returns non-null, the Gamui instance keeps
+		that handle and, instead of Render(), calls UploadBuffers() once per Render() and
+		RenderBuffers() for each state. The default renders from client memory.
+	*/
+	virtual void* CreateBuffers()						{ return 0; }
+	virtual void DestroyBuffers( void* buffers )		{}
+	virtual void UploadBuffers( void* buffers, const Gamui::Dirty& dirty,
+								const uint16_t* index, int nIndex,
+								const Gamui::Vertex* vertex, int nVertex )	{}
+	virtual void RenderBuffers( void* buffers, const void* renderState, const void* textureHandle, int indexStart, int nIndex )	{}
 };
 
 
@@ -444,9 +497,27 @@ public:
 	virtual void Clear()	{ m_gamui = 0; }
 
 private:
+	friend class Gamui;
+
 	UIItem( const UIItem& );			// private, not implemented.
 	void operator=( const UIItem& );	// private, not implemented.
 
+	enum {
+		CHANGE_NONE,
+		CHANGE_LAYOUT,		// needs DoLayout() and Queue()
+		CHANGE_QUEUE		// laid out, needs Queue()
+	};
+	int m_change;
+	bool m_needsRender;		// cached DoLayout() result
+
+	// Where the last Gamui rebuild put this item. Re-queues that fit
+	// are written back in place.
+	bool m_queued;
+	int m_vertexStart, m_nVertex;
+	int m_indexStart, m_nIndex;
+	const void* m_renderState;
+	const void* m_textureHandle;
+
 	float m_x;
 	float m_y;
 	int m_level;
@@ -460,7 +531,7 @@ protected:
 	template <class T> T Max( T a, T b ) const		{ return a>b ? a : b; }
 	float Mean( float a, float b ) const			{ return (a+b)*0.5f; }
 	static Gamui::Vertex* PushQuad( CDynArray< uint16_t > *index, CDynArray< Gamui::Vertex > *vertex );
-	void Modify()		{ if ( m_gamui ) m_gamui->Modify(); }
+	void Modify()		{ m_change = CHANGE_LAYOUT; if ( m_gamui ) m_gamui->ItemModified(); }
 	void OrderChanged()	{ if ( m_gamui ) m_gamui->OrderChanged(); }
 
 	void ApplyRotation( int nVertex, Gamui::Vertex* vertex );
@@ -173,7 +173,7 @@ class BitArray
 	/// Set all the bits.
 	void SetAll()				{ memset( array, 0xff, TOTAL_MEM ); }
 
-	U32 Access32( int x, int y, int z ) { return array[ z*PLANE32 + y*WIDTH32 + (x>>5) ]; }
+	U32 Access32( int x, int y, int z ) const { return array[ z*PLANE32 + y*WIDTH32 + (x>>5) ]; }
 
 	// 0xffffffff
 	enum { STRING_SIZE = TOTAL_MEM32*8 + 1 };
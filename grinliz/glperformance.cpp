@@ -25,6 +25,10 @@ distribution.
 
 #ifdef _WIN32
 	#include <windows.h>
+#elif defined(__APPLE__)
+	#include <mach/mach_time.h>
+#else
+	#include <time.h>
 #endif
 
 #ifdef _MSC_VER
@@ -43,16 +47,50 @@ using namespace std;
 
 PerformanceData* Performance::map[ GL_MAX_PROFILE_ITEM ];
 PerformanceData Performance::sample[ GL_MAX_PROFILE_ITEM ];
-int Performance::numMap = 0;
+std::atomic<int> Performance::numMap( 0 );
+std::atomic<std::thread::id> Performance::frameThread( std::this_thread::get_id() );
 int Performance::callDepth = 0;
 
 
+TimeUnit grinliz::FastTime()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER freq = { 0 };
+	if ( !freq.QuadPart ) {
+		QueryPerformanceFrequency( &freq );
+	}
+	LARGE_INTEGER count;
+	QueryPerformanceCounter( &count );
+	// Split to not overflow the multiply.
+	U64 sec  = (U64)count.QuadPart / (U64)freq.QuadPart;
+	U64 frac = (U64)count.QuadPart % (U64)freq.QuadPart;
+	return sec*1000000000 + frac*1000000000 / (U64)freq.QuadPart;
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if ( !timebase.denom ) {
+		mach_timebase_info( &timebase );
+	}
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+	timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (U64)ts.tv_sec*1000000000 + (U64)ts.tv_nsec;
+#endif
+}
+
+
 PerformanceData::PerformanceData( const char* _name ) : name( _name )
 { 
 	Clear();
-	Performance::map[ Performance::numMap ] = this;
-	id = Performance::numMap;
-	++Performance::numMap;
+	id = Performance::numMap.fetch_add( 1 );
+	if ( id < GL_MAX_PROFILE_ITEM ) {
+		Performance::map[ id ] = this;
+	}
+	else {
+		GLASSERT( 0 );	// increase GL_MAX_PROFILE_ITEM
+		Performance::numMap = GL_MAX_PROFILE_ITEM;
+		id = -1;
+	}
 }
 
 
@@ -71,7 +109,8 @@ void PerformanceData::Clear()
 /* static */ void Performance::Clear()
 {
 	for( int i=0; i<numMap; ++i ) {
-		map[i]->Clear();
+		if ( map[i] )
+			map[i]->Clear();
 		sample[i].Clear();
 	}
 }
@@ -79,12 +118,18 @@ void PerformanceData::Clear()
 
 /*static*/ void Performance::SampleData()
 {
+	// A scope on another thread can be registering right now; its slot in
+	// map[] may not be written yet.
+	const int n = numMap;
 	TimeUnit total = 0;
-	for( int i=0; i<numMap; ++i ) {
-		total += map[i]->functionTopTime;
+	for( int i=0; i<n; ++i ) {
+		if ( map[i] )
+			total += map[i]->functionTopTime;
 	}
 
-	for( int i=0; i<numMap; ++i ) {
+	for( int i=0; i<n; ++i ) {
+		if ( !map[i] )
+			continue;
 		sample[i] = *map[i];
 		map[i]->Clear();
 
@@ -111,3 +156,202 @@ void Performance::Dump( FILE* fp, const char* desc )
 
 }
 
+
+///////////////////////////////////////////////////////
+
+namespace {
+
+struct ProfileEvent
+{
+	const char*	name;
+	TimeUnit	start;
+	TimeUnit	end;
+};
+
+
+/*	One lane per running thread. A thread takes a free lane the first time
+	it records a scope, and gives it back when it exits. A later thread
+	carries on in the same ring, so the older scopes are kept until they are
+	overwritten. Only the owning thread writes a lane; 'count' is published
+	after the event so a reader on another thread sees whole events, apart
+	from the ones being overwritten as it reads.
+*/
+struct ProfileLane
+{
+	std::atomic<bool>	inUse;
+	std::atomic<U32>	count;		// scopes ever recorded
+	const char*			name;
+	ProfileEvent		event[GL_PROFILE_EVENTS];
+};
+
+ProfileLane profileLane[GL_PROFILE_THREADS];
+
+struct ProfileLaneOwner
+{
+	ProfileLaneOwner() : lane( 0 ), full( false )	{}
+	~ProfileLaneOwner()	{ 
+		if ( lane ) 
+			lane->inUse = false; 
+	}
+
+	ProfileLane* Get() {
+		if ( !lane && !full ) {
+			for( int i=0; i<GL_PROFILE_THREADS && !lane; ++i ) {
+				bool expected = false;
+				if ( profileLane[i].inUse.compare_exchange_strong( expected, true ) ) {
+					lane = &profileLane[i];
+					lane->name = 0;
+				}
+			}
+			full = ( lane == 0 );	// too many threads; this one isn't traced
+		}
+		return lane;
+	}
+
+	ProfileLane* lane;
+	bool full;
+};
+
+thread_local ProfileLaneOwner profileLaneOwner;
+
+// Written by the thread calling EndFrame().
+TimeUnit frameEnd[GL_PROFILE_FRAMES];
+U32 frameCount = 0;
+
+
+void WriteJSONString( FILE* fp, const char* str )
+{
+	fputc( '"', fp );
+	for( const char* p = str ? str : ""; *p; ++p ) {
+		if ( *p == '"' || *p == '\\' )
+			fputc( '\\', fp );
+		if ( (unsigned char)(*p) >= ' ' )
+			fputc( *p, fp );
+	}
+	fputc( '"', fp );
+}
+
+}	// namespace
+
+
+/*static*/ void Performance::Record( const char* name, TimeUnit start, TimeUnit end )
+{
+	ProfileLane* lane = profileLaneOwner.Get();
+	if ( lane ) {
+		U32 n = lane->count.load( std::memory_order_relaxed );
+		ProfileEvent* e = &lane->event[n & (GL_PROFILE_EVENTS-1)];
+		e->name = name;
+		e->start = start;
+		e->end = end;
+		lane->count.store( n+1, std::memory_order_release );
+	}
+}
+
+
+/*static*/ void Performance::EndFrame()
+{
+	frameThread.store( std::this_thread::get_id(), std::memory_order_relaxed );
+	TimeUnit now = FastTime();
+	if ( frameCount ) {
+		Record( "Frame", frameEnd[(frameCount-1) & (GL_PROFILE_FRAMES-1)], now );
+	}
+	frameEnd[frameCount & (GL_PROFILE_FRAMES-1)] = now;
+	++frameCount;
+}
+
+
+/*static*/ void Performance::SetThreadName( const char* name )
+{
+	ProfileLane* lane = profileLaneOwner.Get();
+	if ( lane ) {
+		lane->name = name;
+	}
+}
+
+
+/*static*/ int Performance::WriteChromeTrace( FILE* fp, int nFrames, int* framesWritten )
+{
+	U32 count[GL_PROFILE_THREADS];
+	for( int i=0; i<GL_PROFILE_THREADS; ++i ) {
+		count[i] = profileLane[i].count.load( std::memory_order_acquire );
+	}
+
+	// A lane is in the order the scopes ended. Once it has wrapped, every
+	// scope that started after its oldest kept scope ended is still there;
+	// before that, children may be gone while their parents are kept.
+	TimeUnit complete = 0;
+	for( int i=0; i<GL_PROFILE_THREADS; ++i ) {
+		if ( count[i] > (U32)GL_PROFILE_EVENTS ) {
+			const ProfileEvent& oldest = profileLane[i].event[(count[i]-GL_PROFILE_EVENTS) & (GL_PROFILE_EVENTS-1)];
+			complete = Max( complete, oldest.end );
+		}
+	}
+
+	// Everything after the end of the frame before the first one written:
+	// the last 'nFrames' frames (all that are kept for nFrames <= 0), back
+	// to the first one that isn't complete.
+	TimeUnit since = complete;
+	int nWritten = 0;
+	const U32 nKept = Min( frameCount, (U32)GL_PROFILE_FRAMES );
+	for( U32 n=1; n<nKept && ( nFrames <= 0 || (int)n <= nFrames ); ++n ) {
+		TimeUnit frameStart = frameEnd[(frameCount-1-n) & (GL_PROFILE_FRAMES-1)];
+		if ( frameStart < complete ) {
+			break;
+		}
+		since = frameStart;
+		nWritten = (int)n;
+	}
+	if ( framesWritten ) {
+		*framesWritten = nWritten;
+	}
+
+	// Times are written in microseconds from the first scope.
+	TimeUnit origin = 0;
+	bool hasOrigin = false;
+	for( int i=0; i<GL_PROFILE_THREADS; ++i ) {
+		U32 first = count[i] > (U32)GL_PROFILE_EVENTS ? count[i] - GL_PROFILE_EVENTS : 0;
+		for( U32 k=first; k<count[i]; ++k ) {
+			const ProfileEvent& e = profileLane[i].event[k & (GL_PROFILE_EVENTS-1)];
+			if ( e.start >= since && ( !hasOrigin || e.start < origin ) ) {
+				origin = e.start;
+				hasOrigin = true;
+			}
+		}
+	}
+
+	int nScopes = 0;
+	const char* separator = "";
+	fprintf( fp, "{\"traceEvents\":[" );
+	for( int i=0; i<GL_PROFILE_THREADS; ++i ) {
+		if ( count[i] == 0 ) {
+			continue;
+		}
+		const ProfileLane& lane = profileLane[i];
+		fprintf( fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", separator, i );
+		if ( lane.name ) {
+			WriteJSONString( fp, lane.name );
+		}
+		else {
+			fprintf( fp, "\"thread %d\"", i );
+		}
+		fprintf( fp, "}}" );
+		separator = ",";
+
+		U32 first = count[i] > (U32)GL_PROFILE_EVENTS ? count[i] - GL_PROFILE_EVENTS : 0;
+		for( U32 k=first; k<count[i]; ++k ) {
+			const ProfileEvent& e = lane.event[k & (GL_PROFILE_EVENTS-1)];
+			if ( e.start < since || e.end < e.start ) {
+				continue;
+			}
+			fprintf( fp, ",\n{\"name\":" );
+			WriteJSONString( fp, e.name );
+			fprintf( fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					 i,
+					 (double)(e.start - origin) / 1000.0,
+					 (double)(e.end - e.start) / 1000.0 );
+			++nScopes;
+		}
+	}
+	fprintf( fp, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+	return nScopes;
+}
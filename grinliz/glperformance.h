@@ -31,70 +31,19 @@ distribution.
 #pragma warning( disable : 4530 )
 #pragma warning( disable : 4786 )
 #endif
-#if defined(__APPLE__)
-//#include <CoreFoundation/CoreFoundation.h>
-#include <mach/mach_time.h>
-# endif
-
 #include "gldebug.h"
 #include "gltypes.h"
 #include <stdio.h>
+#include <atomic>
+#include <thread>
 
 
-#if defined(_MSC_VER) && defined(_M_IX86)
-namespace grinliz {
-	typedef U64 TimeUnit;
-
-	inline U64 FastTime()
-	{
-		union 
-		{
-			U64 result;
-			struct
-			{
-				U32 lo;
-				U32 hi;
-			} split;
-		} u;
-		u.result = 0;
-
-		_asm {
-			//pushad;	// don't need - aren't using "emit"
-			cpuid;		// force all previous instructions to complete - else out of order execution can confuse things
-			rdtsc;
-			mov u.split.hi, edx;
-			mov u.split.lo, eax;
-			//popad;
-		}				
-		return u.result;
-	}
-}
-
-#elif defined(__GNUC__) && defined(__i386__) 
-namespace grinliz {
-	typedef U64 TimeUnit;
-
-	inline U64 FastTime()
-	{
-		U64 val;
-		 __asm__ __volatile__ ("rdtsc" : "=A" (val));
-		 return val;
-	}
-}
-#elif defined (__APPLE__) && defined(__arm__)
 namespace grinliz {
+	// Nanoseconds from a monotonic, high resolution clock. Only the
+	// difference between two times is meaningful.
 	typedef U64 TimeUnit;
-	inline U64 FastTime() {
-		return mach_absolute_time();
-	}
+	TimeUnit FastTime();
 }
-#else
-#include <time.h>
-namespace grinliz {
-	typedef clock_t TimeUnit;
-	inline TimeUnit FastTime() { return clock(); }
-}
-#endif
 
 namespace grinliz {
 #if 0
@@ -117,6 +66,9 @@ private:
 #endif
 
 const int GL_MAX_PROFILE_ITEM = 60;	// Max functions that can be profiled.
+const int GL_PROFILE_THREADS = 8;		// Threads that can record scopes at the same time.
+const int GL_PROFILE_EVENTS = 8192;		// Scopes kept per thread. Power of 2.
+const int GL_PROFILE_FRAMES = 256;		// Frame boundaries kept. Power of 2.
 
 // Static - there is only one of these for a given function.
 struct PerformanceData
@@ -154,20 +106,28 @@ class Performance
 	Performance( PerformanceData* _data )	{
 		this->data = _data;
 
-		++data->functionCalls;
+		// The counters are only kept on the frame thread, so the table
+		// is that thread's time. Other threads are only traced.
+		counted = IsFrameThread();
+		if ( counted ) {
+			++data->functionCalls;
+			++callDepth;
+		}
 		start = FastTime();
-		++callDepth;
 	}
 
 	~Performance()
 	{
 		TimeUnit end = FastTime();
 		GLASSERT( end >= start );
-		data->functionTime += ( end - start );
-		--callDepth;
-		if ( callDepth == 0 ) {
-			data->functionTopTime += (end - start);
+		if ( counted ) {
+			data->functionTime += ( end - start );
+			--callDepth;
+			if ( callDepth == 0 ) {
+				data->functionTopTime += (end - start);
+			}
 		}
+		Record( data->name, start, end );
 	}
 
 	/// Write the results of performance testing to a file.
@@ -179,15 +139,38 @@ class Performance
 	static int NumData()								{ return numMap; }
 	static const PerformanceData& GetData( int i )		{ GLASSERT( i >= 0 && i < numMap ); return sample[i]; }
 
+	/**
+		Every scope is also recorded, with its start and end, into a ring
+		buffer of the calling thread. EndFrame() marks the frame boundaries
+		so that the last frames can be written out as a trace.
+	*/
+	static void EndFrame();
+	/// The thread that calls EndFrame(); until then, the thread that started the program.
+	static bool IsFrameThread()		{ return std::this_thread::get_id() == frameThread.load( std::memory_order_relaxed ); }
+	/// Name the calling thread in the trace. 'name' must be a static string.
+	static void SetThreadName( const char* name );
+	/** Write the scopes of the last 'nFrames' frames, from all threads, as
+		Chrome trace event JSON (chrome://tracing or ui.perfetto.dev.)
+		Only whole frames are written: if a ring has already overwritten
+		scopes of a frame, that frame and the ones before it are left out.
+		Returns the number of scopes written; 'framesWritten' (if not null)
+		is the number of frames.
+	*/
+	static int WriteChromeTrace( FILE* fp, int nFrames, int* framesWritten=0 );
+
   protected:
+	static void Record( const char* name, TimeUnit start, TimeUnit end );
+
 	static PerformanceData* map[ GL_MAX_PROFILE_ITEM ];
 	static PerformanceData  sample[ GL_MAX_PROFILE_ITEM ];
-	static int numMap;
+	static std::atomic<int> numMap;
+	static std::atomic<std::thread::id> frameThread;
 	static int callDepth;
 	static TimeUnit totalTime;
 
 	PerformanceData* data;
 	TimeUnit start;
+	bool counted;
 };
 
 #ifdef GRINLIZ_PROFILE
@@ -118,10 +118,11 @@ void Random::SetSeed( const char* str )
 }
 
 
-void Random::SetSeedFromTime()
+U32 Random::SetSeedFromTime()
 {
 	U32 seed = (U32)time( 0 ) ^ (U32)clock();
 	SetSeed( seed );
+	return seed;
 }
 
 
@@ -154,6 +155,148 @@ U32 Random::Rand()
 }
 
 
+void Random::Fill( U32* v, int n )
+{
+	// Same as Rand(), but the state stays in registers for the whole batch.
+	const U64 a=698769069;
+	U32 _x=x, _y=y, _z=z, _c=c, _low=lowCount;
+
+	for( int i=0; i<n; ++i ) {
+		_x = 69069*_x + 12345;
+		_y ^= (_y<<13);  
+		_y ^= (_y>>17); 
+		_y ^= (_y<<5);
+
+		U64 t = a*(U64)_z + (U64)_c; 
+		_c = (U32)(t>>32);
+		_z = (U32)t;
+
+		v[i] = (_x+_y+_z) ^ series[(_low++)&0xff];
+	}
+	x = _x; y = _y; z = _z; c = _c; lowCount = _low;
+}
+
+
+void Random::UniformN( float* v, int n )
+{
+	// Generate a block, then convert it. The conversion loop has no 
+	// dependencies between elements.
+	const float INV = 1.0f / 1023.f;	
+	U32 u[64];
+	while( n > 0 ) {
+		int count = n < 64 ? n : 64;
+		Fill( u, count );
+		for( int i=0; i<count; ++i ) {
+			v[i] = (float)( u[i]&0x3ff ) * INV;
+		}
+		v += count;
+		n -= count;
+	}
+}
+
+
+// (a*b) % m without overflow, for m < 2^63
+static U64 MulMod( U64 a, U64 b, U64 m )
+{
+	U64 r = 0;
+	a %= m;
+	while( b ) {
+		if ( b & 1 ) {
+			r += a;
+			if ( r >= m ) r -= m;
+		}
+		a += a;
+		if ( a >= m ) a -= m;
+		b >>= 1;
+	}
+	return r;
+}
+
+
+// The xorshift step as a 32x32 matrix over GF(2). Column i is the
+// image of bit i.
+static void XorShiftMul( const U32* m, U32 v, U32* out )
+{
+	U32 r = 0;
+	for( int i=0; v; ++i, v >>= 1 ) {
+		if ( v & 1 ) r ^= m[i];
+	}
+	*out = r;
+}
+
+
+void Random::Jump( U64 n )
+{
+	// Each part of the generator can be advanced by squaring:
+	//	x: LCG mod 2^32. Compose the affine step x -> A*x + C.
+	//	y: xorshift, linear over GF(2). Raise the step matrix to the power n.
+	//	z,c: multiply-with-carry, which is an LCG on V = a*z + c with modulus
+	//		 m = a*2^32 - 1 and multiplier a.
+	//	lowCount: a counter.
+	
+	// x
+	{
+		U32 mulAcc = 1, addAcc = 0;
+		U32 mul = 69069, add = 12345;
+		for( U64 k=n; k; k >>= 1 ) {
+			if ( k & 1 ) {
+				mulAcc = mulAcc * mul;
+				addAcc = addAcc * mul + add;
+			}
+			add = add * mul + add;
+			mul = mul * mul;
+		}
+		x = mulAcc * x + addAcc;
+	}
+	// y
+	{
+		U32 m[32], sq[32];
+		for( int i=0; i<32; ++i ) {
+			U32 b = 1U << i;
+			b ^= (b<<13);
+			b ^= (b>>17);
+			b ^= (b<<5);
+			m[i] = b;
+		}
+		for( U64 k=n; k; k >>= 1 ) {
+			if ( k & 1 ) {
+				XorShiftMul( m, y, &y );
+			}
+			for( int i=0; i<32; ++i ) {
+				XorShiftMul( m, m[i], &sq[i] );
+			}
+			memcpy( m, sq, sizeof(m) );
+		}
+	}
+	// z, c
+	{
+		const U64 a = 698769069;
+		const U64 mod = (a<<32) - 1;
+		U64 v = a*(U64)z + (U64)c;
+		U64 mul = a, mulAcc = 1;
+		for( U64 k=n; k; k >>= 1 ) {
+			if ( k & 1 ) {
+				mulAcc = MulMod( mulAcc, mul, mod );
+			}
+			mul = MulMod( mul, mul, mod );
+		}
+		v = MulMod( v, mulAcc, mod );
+		z = (U32)(v / a);
+		c = (U32)(v % a);
+	}
+	lowCount += (U32)n;
+}
+
+
+Random Random::Stream( U32 index ) const
+{
+	GLASSERT( index < (1U<<24) );	// 2^24 streams of 2^40
+	Random r = *this;
+	r.Jump( (U64)index << 40 );
+	return r;
+}
+
+
 #if 0
 void Random::NormalVector( float* v, int dim )
 {
@@ -199,6 +342,18 @@ void Random::NormalVector( float* v, int dim )
 }
 
 
+/*static*/ U64 Random::Hash64( const void* data, U32 len, U64 h )
+{
+	const unsigned char *p = (const unsigned char *)(data);
+
+	for( U32 i=0; i<len; ++i, ++p ) {
+		h ^= *p;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+
 const float Random::normal2D[COUNT_2D*2] = {
 	0.000000f, 1.000000f, 0.024541f, 0.999699f, 0.049068f, 0.998795f, 0.073565f, 0.997290f, 
 	0.098017f, 0.995185f, 0.122411f, 0.992480f, 0.146730f, 0.989177f, 0.170962f, 0.985278f, 
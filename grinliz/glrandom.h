@@ -56,11 +56,29 @@ class Random
 								}		
 
 	void SetSeed( const char* str );
-	void SetSeedFromTime();
+	// Returns the seed used, so the sequence can be reproduced.
+	U32 SetSeedFromTime();
 
 	/// Returns a 32 bit random number.
 	U32 Rand();						
 
+	/** Advance the generator as if Rand() had been called 'n' times. The
+		cost is O(log n), not O(n).
+	*/
+	void Jump( U64 n );
+
+	/** Returns a copy of this generator advanced to the start of sub-stream
+		'index'. Sub-streams are 2^40 numbers apart, so they don't overlap in
+		practice, and each depends only on this generator and the index. Worker 
+		threads can each take a stream and never share a generator.
+	*/
+	Random Stream( U32 index ) const;
+
+	/// Fills 'v' with the same 'n' numbers that 'n' calls to Rand() would return.
+	void Fill( U32* v, int n );
+	/// Fills 'v' with the same 'n' numbers that 'n' calls to Uniform() would return.
+	void UniformN( float* v, int n );
+
 	/** Returns a random number greater than or equal to 0, and less 
 		that 'upperBound'.
 	*/	
@@ -127,6 +145,8 @@ class Random
 
 	/// Fast hash
 	static U32 Hash( const void* data, U32 len );
+	/// 64 bit version of Hash. Pass the previous result as 'h' to hash in parts.
+	static U64 Hash64( const void* data, U32 len, U64 h=14695981039346656037ULL );
 
 private:
 	U32 x, y, z, c, lowCount;
@@ -97,6 +97,10 @@ int originalHeight = 0;
 int screenWidth = 0;
 int screenHeight = 0;
 bool cameraIso = true;
+bool fastForward = false;
+const char* profilePath = "profile.json";
+int profileFrames = 120;
+bool profileOnExit = false;
 
 int nModDB = 0;
 grinliz::GLString* databases[GAME_MAX_MOD_DATABASES];	
@@ -199,7 +203,11 @@ int main( int argc, char **argv )
 		SDL_GL_SetAttribute( SDL_GL_MULTISAMPLESAMPLES, multisample );
 	}
 
+#ifdef XENOENGINE_NULL_GL
+	Uint32	videoFlags  = 0;					// GL calls are recorded, not rendered
+#else
 	Uint32	videoFlags  = SDL_WINDOW_OPENGL;     /* Enable OpenGL in SDL */
+#endif
 
 	videoFlags |= SDL_WINDOW_ALLOW_HIGHDPI;
 
@@ -220,7 +228,47 @@ int main( int argc, char **argv )
 	screenHeight = SCREEN_WIDTH;
 #endif
 
-	if ( argc == 3 ) {
+	// xenowar -tournament results.csv [nSeeds] [nBattles] [seed] [nWorkers]
+	const char* tournamentPath = 0;
+	int tournamentSeeds = 1;
+	int tournamentBattles = 2;
+	unsigned tournamentSeed = 0;
+	int tournamentWorkers = 0;		// one per core
+	// xenowar -replay tacreplay.bin
+	// Re-runs the battle and checks every turn. Exits with 1 if they don't match.
+	const char* replayPath = 0;
+	int exitCode = 0;
+	// xenowar -profile trace.json[:nFrames] [other arguments]
+	// The last nFrames are written to the trace on exit, and on F9.
+	// Needs a GRINLIZ_PROFILE build to record anything.
+	if ( argc > 2 && strcmp( argv[1], "-profile" ) == 0 ) {
+		// Only an all digit suffix is a frame count, so "C:\trace.json" is still a path.
+		char* colon = strrchr( argv[2], ':' );
+		if ( colon && colon[1] && strspn( colon+1, "0123456789" ) == strlen( colon+1 ) ) {
+			if ( atoi( colon+1 ) > 0 )
+				profileFrames = atoi( colon+1 );
+			*colon = 0;
+		}
+		profilePath = argv[2];
+		profileOnExit = true;
+		// Drop the profile arguments; the rest is read as usual.
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+
+	if ( argc > 2 && strcmp( argv[1], "-tournament" ) == 0 ) {
+		tournamentPath = argv[2];
+		if ( argc > 3 ) tournamentSeeds = atoi( argv[3] );
+		if ( argc > 4 ) tournamentBattles = atoi( argv[4] );
+		if ( argc > 5 ) tournamentSeed = (unsigned)atol( argv[5] );
+		if ( argc > 6 ) tournamentWorkers = atoi( argv[6] );
+	}
+	if ( argc > 2 && strcmp( argv[1], "-replay" ) == 0 ) {
+		replayPath = argv[2];
+	}
+
+	if ( argc == 3 && !tournamentPath && !replayPath ) {
 		screenWidth = atoi( argv[1] );
 		screenHeight = atoi( argv[2] );
 		if ( screenWidth <= 0 ) screenWidth = IPOD_SCREEN_WIDTH;
@@ -232,7 +280,9 @@ int main( int argc, char **argv )
 	surface = SDL_CreateWindow("", 0, 0, screenWidth, screenHeight, videoFlags);
 	GLASSERT( surface );
 
+#ifndef XENOENGINE_NULL_GL
 	SDL_GL_CreateContext(surface);
+#endif
 
 	SDL_GetWindowSize(surface, &originalWidth, &originalHeight);
 	SDL_GL_GetDrawableSize(surface, &screenWidth, &screenHeight);
@@ -256,7 +306,7 @@ int main( int argc, char **argv )
 		GLOUTPUT(( "Joystick '%s' open.\n", SDL_JoystickName(0) ));
 	}
 
-#if !defined(__MOBILE__)
+#if !defined(__MOBILE__) && !defined(XENOENGINE_NULL_GL)
 	int r = glewInit();
 	GLASSERT( r == GL_NO_ERROR );
 #endif
@@ -301,7 +351,7 @@ int main( int argc, char **argv )
 	}
 #endif
 
-	if ( argc > 3 ) {
+	if ( argc > 3 && !tournamentPath && !replayPath ) {
 		// -- MapMaker -- //
 		Engine::mapMakerMode = true;
 
@@ -365,6 +415,28 @@ int main( int argc, char **argv )
 #endif
 
 
+	if ( tournamentPath ) {
+		// -- Tournament -- //
+		int n = GameTournament( game, tournamentPath, tournamentSeed, tournamentSeeds, tournamentBattles, tournamentWorkers );
+		printf( "Tournament: %d battles written to '%s'\n", n, tournamentPath );
+		done = true;
+	}
+	if ( replayPath ) {
+		// -- Replay -- //
+		int turn = -1;
+		int okay = GameVerifyReplay( game, replayPath, &turn );
+		if ( okay > 0 )
+			printf( "Replay: '%s' matches\n", replayPath );
+		else if ( okay == 0 && turn >= 0 )
+			printf( "Replay: '%s' doesn't match at turn %d\n", replayPath, turn );
+		else if ( okay == 0 )
+			printf( "Replay: '%s' didn't finish\n", replayPath );
+		else
+			printf( "Replay: can't read '%s'\n", replayPath );
+		exitCode = ( okay > 0 ) ? 0 : 1;
+		done = true;
+	}
+
 	bool L2Down = false;
 	bool R2Down = false;
 	grinliz::Vector2F joystickAxis[2] = { 0, 0 };
@@ -598,6 +670,20 @@ int main( int argc, char **argv )
 						GameHotKey( game, GAME_HK_TOGGLE_DEBUG_TEXT );
 						break;
 
+					case SDLK_F9:
+						{
+							int frames = 0;
+							int n = GameWriteProfile( game, profilePath, profileFrames, &frames );
+							printf( "Profile: %d scopes from %d frames written to '%s'\n", n, frames, profilePath );
+						}
+						break;
+
+					case SDLK_f:
+						// Fast forward: 8 simulation steps a frame.
+						fastForward = !fastForward;
+						GameSetSimSteps( game, fastForward ? 8 : 0 );
+						break;
+
 					case SDLK_DELETE:
 						if ( mapMakerMode )
 							((Game*)game)->DeleteAtSelection(); 
@@ -769,7 +855,17 @@ int main( int argc, char **argv )
 		SaveLightMap( lightmap );
 	}
 
-	GameSave( game );
+	if ( profileOnExit ) {
+		int frames = 0;
+		int n = GameWriteProfile( game, profilePath, profileFrames, &frames );
+		printf( "Profile: %d scopes from %d frames written to '%s'\n", n, frames, profilePath );
+	}
+
+	// A batch run plays its battles in the game's scenes; saving now
+	// would write one of them over the player's game.
+	if ( !tournamentPath && !replayPath ) {
+		GameSave( game );
+	}
 	DeleteGame( game );
 	Audio_Close();
 
@@ -789,7 +885,7 @@ int main( int argc, char **argv )
 #endif
 
 	MemLeakCheck();
-	return 0;
+	return exitCode;
 }
 
 